@@ -0,0 +1,77 @@
+/*  Benchmarks the pairwise distance kernel used by EuclideanDistance
+ *  against the naive double loop over distance_l2_squared().
+ *
+ *  Copyleft 2021, Marek Gagolewski
+ *
+ *  Compile and run, e.g.:
+ *
+ *      g++ -std=c++11 -O2 -I../src benchmark_distance.cpp -o benchmark_distance
+ *      ./benchmark_distance 2500
+ *
+ *  Add -march=native to enable the AVX/AVX-512 code paths.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include "distance.h"
+
+
+double elapsed_ms(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now()-t0).count();
+}
+
+
+int main(int argc, char** argv)
+{
+    size_t n = (argc > 1)?(size_t)atoi(argv[1]):2500;
+    size_t ds[] = {2, 5, 10, 20, 50, 100, 200, 500, 1000};
+
+#if defined(__AVX512F__)
+    const char* simd = "AVX-512";
+#elif defined(__AVX__)
+    const char* simd = "AVX";
+#else
+    const char* simd = "portable";
+#endif
+    printf("n=%d, kernel=%s\n", (int)n, simd);
+    printf("%6s %12s %12s %8s %12s %12s\n",
+        "d", "naive [ms]", "tiled [ms]", "speedup", "max_abs_err", "max_rel_err");
+
+    std::mt19937 rng(123);
+    std::normal_distribution<FLOAT_T> rnorm(0.0, 1.0);
+    for (size_t d : ds) {
+        std::vector<FLOAT_T> X(n*d);
+        for (size_t i=0; i<n*d; ++i) X[i] = rnorm(rng);
+
+        std::vector<FLOAT_T> D1(n*(n-1)/2), D2(n*(n-1)/2);
+
+        auto t0 = std::chrono::steady_clock::now();
+        size_t k = 0;
+        for (size_t i=0; i<n-1; ++i) {
+            for (size_t j=i+1; j<n; ++j) {
+                D1[k++] = distance_l2_squared(X.data()+i*d, X.data()+j*d, d);
+            }
+        }
+        double t_naive = elapsed_ms(t0);
+
+        t0 = std::chrono::steady_clock::now();
+        pairwise_distances_l2_squared(X.data(), n, d, D2.data());
+        double t_tiled = elapsed_ms(t0);
+
+        FLOAT_T max_abs = 0.0, max_rel = 0.0;
+        for (k=0; k<D1.size(); ++k) {
+            FLOAT_T e = std::fabs(D1[k]-D2[k]);
+            max_abs = std::max(max_abs, e);
+            if (D1[k] > 0.0) max_rel = std::max(max_rel, e/D1[k]);
+        }
+
+        printf("%6d %12.1f %12.1f %8.2f %12.3g %12.3g\n",
+            (int)d, t_naive, t_tiled, t_naive/t_tiled, max_abs, max_rel);
+    }
+
+    return 0;
+}
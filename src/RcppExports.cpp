@@ -10,17 +10,69 @@ Rcpp::Rostream<true>&  Rcpp::Rcout = Rcpp::Rcpp_cout_get();
 Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
+// _CVI_dataset
+SEXP _CVI_dataset(SEXP X, Rcpp::String distance_file);
+RcppExport SEXP _CVI__CVI_dataset(SEXP XSEXP, SEXP distance_fileSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
+    Rcpp::traits::input_parameter< Rcpp::String >::type distance_file(distance_fileSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_dataset(X, distance_file));
+    return rcpp_result_gen;
+END_RCPP
+}
+// _CVI_distance_bytes
+double _CVI_distance_bytes(SEXP X);
+RcppExport SEXP _CVI__CVI_distance_bytes(SEXP XSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_distance_bytes(X));
+    return rcpp_result_gen;
+END_RCPP
+}
+// _CVI_distance_file
+Rcpp::String _CVI_distance_file(NumericMatrix X, Rcpp::String filename, bool squared, Rcpp::String distance_storage);
+RcppExport SEXP _CVI__CVI_distance_file(SEXP XSEXP, SEXP filenameSEXP, SEXP squaredSEXP, SEXP distance_storageSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericMatrix >::type X(XSEXP);
+    Rcpp::traits::input_parameter< Rcpp::String >::type filename(filenameSEXP);
+    Rcpp::traits::input_parameter< bool >::type squared(squaredSEXP);
+    Rcpp::traits::input_parameter< Rcpp::String >::type distance_storage(distance_storageSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_distance_file(X, filename, squared, distance_storage));
+    return rcpp_result_gen;
+END_RCPP
+}
+// _CVI_pairwise_distances
+NumericVector _CVI_pairwise_distances(NumericMatrix X, bool squared, Rcpp::String distance_storage);
+RcppExport SEXP _CVI__CVI_pairwise_distances(SEXP XSEXP, SEXP squaredSEXP, SEXP distance_storageSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericMatrix >::type X(XSEXP);
+    Rcpp::traits::input_parameter< bool >::type squared(squaredSEXP);
+    Rcpp::traits::input_parameter< Rcpp::String >::type distance_storage(distance_storageSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_pairwise_distances(X, squared, distance_storage));
+    return rcpp_result_gen;
+END_RCPP
+}
 // _CVI_create
-SEXP _CVI_create(Rcpp::String type, NumericMatrix X, int K, bool allow_undo);
-RcppExport SEXP _CVI__CVI_create(SEXP typeSEXP, SEXP XSEXP, SEXP KSEXP, SEXP allow_undoSEXP) {
+SEXP _CVI_create(Rcpp::String type, SEXP X, int K, bool allow_undo, Rcpp::String distance_storage, Rcpp::String metric);
+RcppExport SEXP _CVI__CVI_create(SEXP typeSEXP, SEXP XSEXP, SEXP KSEXP, SEXP allow_undoSEXP, SEXP distance_storageSEXP, SEXP metricSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< Rcpp::String >::type type(typeSEXP);
-    Rcpp::traits::input_parameter< NumericMatrix >::type X(XSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
     Rcpp::traits::input_parameter< int >::type K(KSEXP);
     Rcpp::traits::input_parameter< bool >::type allow_undo(allow_undoSEXP);
-    rcpp_result_gen = Rcpp::wrap(_CVI_create(type, X, K, allow_undo));
+    Rcpp::traits::input_parameter< Rcpp::String >::type distance_storage(distance_storageSEXP);
+    Rcpp::traits::input_parameter< Rcpp::String >::type metric(metricSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_create(type, X, K, allow_undo, distance_storage, metric));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -46,6 +98,34 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// _CVI_compute_many
+NumericVector _CVI_compute_many(SEXP cvi_ptr, NumericMatrix Y);
+RcppExport SEXP _CVI__CVI_compute_many(SEXP cvi_ptrSEXP, SEXP YSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cvi_ptr(cvi_ptrSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type Y(YSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_compute_many(cvi_ptr, Y));
+    return rcpp_result_gen;
+END_RCPP
+}
+// _CVI_evaluate
+NumericVector _CVI_evaluate(CharacterVector types, SEXP X, NumericVector y, int K, Rcpp::String distance_storage, Rcpp::String metric);
+RcppExport SEXP _CVI__CVI_evaluate(SEXP typesSEXP, SEXP XSEXP, SEXP ySEXP, SEXP KSEXP, SEXP distance_storageSEXP, SEXP metricSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< CharacterVector >::type types(typesSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< int >::type K(KSEXP);
+    Rcpp::traits::input_parameter< Rcpp::String >::type distance_storage(distance_storageSEXP);
+    Rcpp::traits::input_parameter< Rcpp::String >::type metric(metricSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_evaluate(types, X, y, K, distance_storage, metric));
+    return rcpp_result_gen;
+END_RCPP
+}
 // _CVI_undo
 void _CVI_undo(SEXP cvi_ptr);
 RcppExport SEXP _CVI__CVI_undo(SEXP cvi_ptrSEXP) {
@@ -56,6 +136,36 @@ BEGIN_RCPP
     return R_NilValue;
 END_RCPP
 }
+// _CVI_begin
+void _CVI_begin(SEXP cvi_ptr);
+RcppExport SEXP _CVI__CVI_begin(SEXP cvi_ptrSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cvi_ptr(cvi_ptrSEXP);
+    _CVI_begin(cvi_ptr);
+    return R_NilValue;
+END_RCPP
+}
+// _CVI_commit
+void _CVI_commit(SEXP cvi_ptr);
+RcppExport SEXP _CVI__CVI_commit(SEXP cvi_ptrSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cvi_ptr(cvi_ptrSEXP);
+    _CVI_commit(cvi_ptr);
+    return R_NilValue;
+END_RCPP
+}
+// _CVI_rollback
+void _CVI_rollback(SEXP cvi_ptr);
+RcppExport SEXP _CVI__CVI_rollback(SEXP cvi_ptrSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cvi_ptr(cvi_ptrSEXP);
+    _CVI_rollback(cvi_ptr);
+    return R_NilValue;
+END_RCPP
+}
 // _CVI_modify
 void _CVI_modify(SEXP cvi_ptr, int i, int j);
 RcppExport SEXP _CVI__CVI_modify(SEXP cvi_ptrSEXP, SEXP iSEXP, SEXP jSEXP) {
@@ -68,6 +178,133 @@ BEGIN_RCPP
     return R_NilValue;
 END_RCPP
 }
+// _CVI_swap
+void _CVI_swap(SEXP cvi_ptr, int i, int k);
+RcppExport SEXP _CVI__CVI_swap(SEXP cvi_ptrSEXP, SEXP iSEXP, SEXP kSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cvi_ptr(cvi_ptrSEXP);
+    Rcpp::traits::input_parameter< int >::type i(iSEXP);
+    Rcpp::traits::input_parameter< int >::type k(kSEXP);
+    _CVI_swap(cvi_ptr, i, k);
+    return R_NilValue;
+END_RCPP
+}
+// _CVI_modify_many
+void _CVI_modify_many(SEXP cvi_ptr, NumericVector idx, NumericVector labels);
+RcppExport SEXP _CVI__CVI_modify_many(SEXP cvi_ptrSEXP, SEXP idxSEXP, SEXP labelsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cvi_ptr(cvi_ptrSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type idx(idxSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type labels(labelsSEXP);
+    _CVI_modify_many(cvi_ptr, idx, labels);
+    return R_NilValue;
+END_RCPP
+}
+// _CVI_clone
+SEXP _CVI_clone(SEXP cvi_ptr);
+RcppExport SEXP _CVI__CVI_clone(SEXP cvi_ptrSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cvi_ptr(cvi_ptrSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_clone(cvi_ptr));
+    return rcpp_result_gen;
+END_RCPP
+}
+// _CVI_confint
+NumericVector _CVI_confint(SEXP cvi_ptr);
+RcppExport SEXP _CVI__CVI_confint(SEXP cvi_ptrSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cvi_ptr(cvi_ptrSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_confint(cvi_ptr));
+    return rcpp_result_gen;
+END_RCPP
+}
+// _CVI_num_rescans
+double _CVI_num_rescans(SEXP cvi_ptr);
+RcppExport SEXP _CVI__CVI_num_rescans(SEXP cvi_ptrSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cvi_ptr(cvi_ptrSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_num_rescans(cvi_ptr));
+    return rcpp_result_gen;
+END_RCPP
+}
+// _CVI_score_point_moves
+NumericVector _CVI_score_point_moves(SEXP cvi_ptr, int i);
+RcppExport SEXP _CVI__CVI_score_point_moves(SEXP cvi_ptrSEXP, SEXP iSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cvi_ptr(cvi_ptrSEXP);
+    Rcpp::traits::input_parameter< int >::type i(iSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_score_point_moves(cvi_ptr, i));
+    return rcpp_result_gen;
+END_RCPP
+}
+// _CVI_score_all_moves
+NumericMatrix _CVI_score_all_moves(SEXP cvi_ptr);
+RcppExport SEXP _CVI__CVI_score_all_moves(SEXP cvi_ptrSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cvi_ptr(cvi_ptrSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_score_all_moves(cvi_ptr));
+    return rcpp_result_gen;
+END_RCPP
+}
+// _CVI_set_num_threads
+int _CVI_set_num_threads(int num_threads);
+RcppExport SEXP _CVI__CVI_set_num_threads(SEXP num_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type num_threads(num_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_set_num_threads(num_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// _CVI_distance_policy
+List _CVI_distance_policy(double max_bytes, double access_cost, double row_block, double full_matrix);
+RcppExport SEXP _CVI__CVI_distance_policy(SEXP max_bytesSEXP, SEXP access_costSEXP, SEXP row_blockSEXP, SEXP full_matrixSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< double >::type max_bytes(max_bytesSEXP);
+    Rcpp::traits::input_parameter< double >::type access_cost(access_costSEXP);
+    Rcpp::traits::input_parameter< double >::type row_block(row_blockSEXP);
+    Rcpp::traits::input_parameter< double >::type full_matrix(full_matrixSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_distance_policy(max_bytes, access_cost, row_block, full_matrix));
+    return rcpp_result_gen;
+END_RCPP
+}
+// _CVI_distance_mode
+std::string _CVI_distance_mode(SEXP cvi_ptr);
+RcppExport SEXP _CVI__CVI_distance_mode(SEXP cvi_ptrSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cvi_ptr(cvi_ptrSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_distance_mode(cvi_ptr));
+    return rcpp_result_gen;
+END_RCPP
+}
+// _CVI_distance_cache_stats
+List _CVI_distance_cache_stats(SEXP cvi_ptr);
+RcppExport SEXP _CVI__CVI_distance_cache_stats(SEXP cvi_ptrSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cvi_ptr(cvi_ptrSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_distance_cache_stats(cvi_ptr));
+    return rcpp_result_gen;
+END_RCPP
+}
 // CVI_CalinskiHarabasz
 double CVI_CalinskiHarabasz(NumericMatrix X, NumericVector y, int K);
 RcppExport SEXP _CVI_CVI_CalinskiHarabasz(SEXP XSEXP, SEXP ySEXP, SEXP KSEXP) {
@@ -81,6 +318,19 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// CVI_CalinskiHarabasz_many
+NumericVector CVI_CalinskiHarabasz_many(NumericMatrix X, NumericMatrix Y, int K);
+RcppExport SEXP _CVI_CVI_CalinskiHarabasz_many(SEXP XSEXP, SEXP YSEXP, SEXP KSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericMatrix >::type X(XSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type Y(YSEXP);
+    Rcpp::traits::input_parameter< int >::type K(KSEXP);
+    rcpp_result_gen = Rcpp::wrap(CVI_CalinskiHarabasz_many(X, Y, K));
+    return rcpp_result_gen;
+END_RCPP
+}
 // CVI_WCSS
 double CVI_WCSS(NumericMatrix X, NumericVector y, int K);
 RcppExport SEXP _CVI_CVI_WCSS(SEXP XSEXP, SEXP ySEXP, SEXP KSEXP) {
@@ -94,6 +344,19 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// CVI_WCSS_many
+NumericVector CVI_WCSS_many(NumericMatrix X, NumericMatrix Y, int K);
+RcppExport SEXP _CVI_CVI_WCSS_many(SEXP XSEXP, SEXP YSEXP, SEXP KSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericMatrix >::type X(XSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type Y(YSEXP);
+    Rcpp::traits::input_parameter< int >::type K(KSEXP);
+    rcpp_result_gen = Rcpp::wrap(CVI_WCSS_many(X, Y, K));
+    return rcpp_result_gen;
+END_RCPP
+}
 // CVI_BallHall
 double CVI_BallHall(NumericMatrix X, NumericVector y, int K);
 RcppExport SEXP _CVI_CVI_BallHall(SEXP XSEXP, SEXP ySEXP, SEXP KSEXP) {
@@ -107,19 +370,45 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// CVI_BallHall_many
+NumericVector CVI_BallHall_many(NumericMatrix X, NumericMatrix Y, int K);
+RcppExport SEXP _CVI_CVI_BallHall_many(SEXP XSEXP, SEXP YSEXP, SEXP KSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericMatrix >::type X(XSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type Y(YSEXP);
+    Rcpp::traits::input_parameter< int >::type K(KSEXP);
+    rcpp_result_gen = Rcpp::wrap(CVI_BallHall_many(X, Y, K));
+    return rcpp_result_gen;
+END_RCPP
+}
 // CVI_Gamma
-double CVI_Gamma(NumericMatrix X, NumericVector y, int K);
+double CVI_Gamma(SEXP X, NumericVector y, int K);
 RcppExport SEXP _CVI_CVI_Gamma(SEXP XSEXP, SEXP ySEXP, SEXP KSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< NumericMatrix >::type X(XSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
     Rcpp::traits::input_parameter< int >::type K(KSEXP);
     rcpp_result_gen = Rcpp::wrap(CVI_Gamma(X, y, K));
     return rcpp_result_gen;
 END_RCPP
 }
+// CVI_Gamma_many
+NumericVector CVI_Gamma_many(SEXP X, NumericMatrix Y, int K);
+RcppExport SEXP _CVI_CVI_Gamma_many(SEXP XSEXP, SEXP YSEXP, SEXP KSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type Y(YSEXP);
+    Rcpp::traits::input_parameter< int >::type K(KSEXP);
+    rcpp_result_gen = Rcpp::wrap(CVI_Gamma_many(X, Y, K));
+    return rcpp_result_gen;
+END_RCPP
+}
 // CVI_DaviesBouldin
 double CVI_DaviesBouldin(NumericMatrix X, NumericVector y, int K);
 RcppExport SEXP _CVI_CVI_DaviesBouldin(SEXP XSEXP, SEXP ySEXP, SEXP KSEXP) {
@@ -133,52 +422,104 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// CVI_DaviesBouldin_many
+NumericVector CVI_DaviesBouldin_many(NumericMatrix X, NumericMatrix Y, int K);
+RcppExport SEXP _CVI_CVI_DaviesBouldin_many(SEXP XSEXP, SEXP YSEXP, SEXP KSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericMatrix >::type X(XSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type Y(YSEXP);
+    Rcpp::traits::input_parameter< int >::type K(KSEXP);
+    rcpp_result_gen = Rcpp::wrap(CVI_DaviesBouldin_many(X, Y, K));
+    return rcpp_result_gen;
+END_RCPP
+}
 // CVI_Silhouette
-double CVI_Silhouette(NumericMatrix X, NumericVector y, int K);
+double CVI_Silhouette(SEXP X, NumericVector y, int K);
 RcppExport SEXP _CVI_CVI_Silhouette(SEXP XSEXP, SEXP ySEXP, SEXP KSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< NumericMatrix >::type X(XSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
     Rcpp::traits::input_parameter< int >::type K(KSEXP);
     rcpp_result_gen = Rcpp::wrap(CVI_Silhouette(X, y, K));
     return rcpp_result_gen;
 END_RCPP
 }
+// CVI_Silhouette_many
+NumericVector CVI_Silhouette_many(SEXP X, NumericMatrix Y, int K);
+RcppExport SEXP _CVI_CVI_Silhouette_many(SEXP XSEXP, SEXP YSEXP, SEXP KSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type Y(YSEXP);
+    Rcpp::traits::input_parameter< int >::type K(KSEXP);
+    rcpp_result_gen = Rcpp::wrap(CVI_Silhouette_many(X, Y, K));
+    return rcpp_result_gen;
+END_RCPP
+}
 // CVI_SilhouetteW
-double CVI_SilhouetteW(NumericMatrix X, NumericVector y, int K);
+double CVI_SilhouetteW(SEXP X, NumericVector y, int K);
 RcppExport SEXP _CVI_CVI_SilhouetteW(SEXP XSEXP, SEXP ySEXP, SEXP KSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< NumericMatrix >::type X(XSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
     Rcpp::traits::input_parameter< int >::type K(KSEXP);
     rcpp_result_gen = Rcpp::wrap(CVI_SilhouetteW(X, y, K));
     return rcpp_result_gen;
 END_RCPP
 }
+// CVI_SilhouetteW_many
+NumericVector CVI_SilhouetteW_many(SEXP X, NumericMatrix Y, int K);
+RcppExport SEXP _CVI_CVI_SilhouetteW_many(SEXP XSEXP, SEXP YSEXP, SEXP KSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type Y(YSEXP);
+    Rcpp::traits::input_parameter< int >::type K(KSEXP);
+    rcpp_result_gen = Rcpp::wrap(CVI_SilhouetteW_many(X, Y, K));
+    return rcpp_result_gen;
+END_RCPP
+}
 // CVI_Dunn
-double CVI_Dunn(NumericMatrix X, NumericVector y, int K);
+double CVI_Dunn(SEXP X, NumericVector y, int K);
 RcppExport SEXP _CVI_CVI_Dunn(SEXP XSEXP, SEXP ySEXP, SEXP KSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< NumericMatrix >::type X(XSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
     Rcpp::traits::input_parameter< int >::type K(KSEXP);
     rcpp_result_gen = Rcpp::wrap(CVI_Dunn(X, y, K));
     return rcpp_result_gen;
 END_RCPP
 }
+// CVI_Dunn_many
+NumericVector CVI_Dunn_many(SEXP X, NumericMatrix Y, int K);
+RcppExport SEXP _CVI_CVI_Dunn_many(SEXP XSEXP, SEXP YSEXP, SEXP KSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type Y(YSEXP);
+    Rcpp::traits::input_parameter< int >::type K(KSEXP);
+    rcpp_result_gen = Rcpp::wrap(CVI_Dunn_many(X, Y, K));
+    return rcpp_result_gen;
+END_RCPP
+}
 // CVI_GDunn
-double CVI_GDunn(NumericMatrix X, NumericVector y, int K, int lowercaseDelta, int uppercaseDelta);
+double CVI_GDunn(SEXP X, NumericVector y, int K, int lowercaseDelta, int uppercaseDelta);
 RcppExport SEXP _CVI_CVI_GDunn(SEXP XSEXP, SEXP ySEXP, SEXP KSEXP, SEXP lowercaseDeltaSEXP, SEXP uppercaseDeltaSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< NumericMatrix >::type X(XSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
     Rcpp::traits::input_parameter< int >::type K(KSEXP);
     Rcpp::traits::input_parameter< int >::type lowercaseDelta(lowercaseDeltaSEXP);
@@ -187,13 +528,28 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// CVI_GDunn_many
+NumericVector CVI_GDunn_many(SEXP X, NumericMatrix Y, int K, int lowercaseDelta, int uppercaseDelta);
+RcppExport SEXP _CVI_CVI_GDunn_many(SEXP XSEXP, SEXP YSEXP, SEXP KSEXP, SEXP lowercaseDeltaSEXP, SEXP uppercaseDeltaSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type Y(YSEXP);
+    Rcpp::traits::input_parameter< int >::type K(KSEXP);
+    Rcpp::traits::input_parameter< int >::type lowercaseDelta(lowercaseDeltaSEXP);
+    Rcpp::traits::input_parameter< int >::type uppercaseDelta(uppercaseDeltaSEXP);
+    rcpp_result_gen = Rcpp::wrap(CVI_GDunn_many(X, Y, K, lowercaseDelta, uppercaseDelta));
+    return rcpp_result_gen;
+END_RCPP
+}
 // CVI_WCNN
-double CVI_WCNN(NumericMatrix X, NumericVector y, int K, int M);
+double CVI_WCNN(SEXP X, NumericVector y, int K, int M);
 RcppExport SEXP _CVI_CVI_WCNN(SEXP XSEXP, SEXP ySEXP, SEXP KSEXP, SEXP MSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< NumericMatrix >::type X(XSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
     Rcpp::traits::input_parameter< int >::type K(KSEXP);
     Rcpp::traits::input_parameter< int >::type M(MSEXP);
@@ -201,13 +557,27 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// CVI_WCNN_many
+NumericVector CVI_WCNN_many(SEXP X, NumericMatrix Y, int K, int M);
+RcppExport SEXP _CVI_CVI_WCNN_many(SEXP XSEXP, SEXP YSEXP, SEXP KSEXP, SEXP MSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type Y(YSEXP);
+    Rcpp::traits::input_parameter< int >::type K(KSEXP);
+    Rcpp::traits::input_parameter< int >::type M(MSEXP);
+    rcpp_result_gen = Rcpp::wrap(CVI_WCNN_many(X, Y, K, M));
+    return rcpp_result_gen;
+END_RCPP
+}
 // CVI_DuNNOWA
-double CVI_DuNNOWA(NumericMatrix X, NumericVector y, int K, int M, Rcpp::String owa_numerator, Rcpp::String owa_denominator);
+double CVI_DuNNOWA(SEXP X, NumericVector y, int K, int M, Rcpp::String owa_numerator, Rcpp::String owa_denominator);
 RcppExport SEXP _CVI_CVI_DuNNOWA(SEXP XSEXP, SEXP ySEXP, SEXP KSEXP, SEXP MSEXP, SEXP owa_numeratorSEXP, SEXP owa_denominatorSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< NumericMatrix >::type X(XSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
     Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
     Rcpp::traits::input_parameter< int >::type K(KSEXP);
     Rcpp::traits::input_parameter< int >::type M(MSEXP);
@@ -217,9 +587,25 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// CVI_DuNNOWA_many
+NumericVector CVI_DuNNOWA_many(SEXP X, NumericMatrix Y, int K, int M, Rcpp::String owa_numerator, Rcpp::String owa_denominator);
+RcppExport SEXP _CVI_CVI_DuNNOWA_many(SEXP XSEXP, SEXP YSEXP, SEXP KSEXP, SEXP MSEXP, SEXP owa_numeratorSEXP, SEXP owa_denominatorSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type X(XSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type Y(YSEXP);
+    Rcpp::traits::input_parameter< int >::type K(KSEXP);
+    Rcpp::traits::input_parameter< int >::type M(MSEXP);
+    Rcpp::traits::input_parameter< Rcpp::String >::type owa_numerator(owa_numeratorSEXP);
+    Rcpp::traits::input_parameter< Rcpp::String >::type owa_denominator(owa_denominatorSEXP);
+    rcpp_result_gen = Rcpp::wrap(CVI_DuNNOWA_many(X, Y, K, M, owa_numerator, owa_denominator));
+    return rcpp_result_gen;
+END_RCPP
+}
 // _CVI_improve
-List _CVI_improve(SEXP cvi_ptr, NumericVector y0, bool allow_revisit, int max_iter_with_no_improvement, int max_iter, int max_samples, bool verbose);
-RcppExport SEXP _CVI__CVI_improve(SEXP cvi_ptrSEXP, SEXP y0SEXP, SEXP allow_revisitSEXP, SEXP max_iter_with_no_improvementSEXP, SEXP max_iterSEXP, SEXP max_samplesSEXP, SEXP verboseSEXP) {
+List _CVI_improve(SEXP cvi_ptr, NumericVector y0, bool allow_revisit, int max_iter_with_no_improvement, int max_iter, int max_samples, bool verbose, bool swaps);
+RcppExport SEXP _CVI__CVI_improve(SEXP cvi_ptrSEXP, SEXP y0SEXP, SEXP allow_revisitSEXP, SEXP max_iter_with_no_improvementSEXP, SEXP max_iterSEXP, SEXP max_samplesSEXP, SEXP verboseSEXP, SEXP swapsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -230,7 +616,8 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< int >::type max_iter(max_iterSEXP);
     Rcpp::traits::input_parameter< int >::type max_samples(max_samplesSEXP);
     Rcpp::traits::input_parameter< bool >::type verbose(verboseSEXP);
-    rcpp_result_gen = Rcpp::wrap(_CVI_improve(cvi_ptr, y0, allow_revisit, max_iter_with_no_improvement, max_iter, max_samples, verbose));
+    Rcpp::traits::input_parameter< bool >::type swaps(swapsSEXP);
+    rcpp_result_gen = Rcpp::wrap(_CVI_improve(cvi_ptr, y0, allow_revisit, max_iter_with_no_improvement, max_iter, max_samples, verbose, swaps));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -251,23 +638,54 @@ END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_CVI__CVI_create", (DL_FUNC) &_CVI__CVI_create, 4},
+    {"_CVI__CVI_dataset", (DL_FUNC) &_CVI__CVI_dataset, 2},
+    {"_CVI__CVI_distance_bytes", (DL_FUNC) &_CVI__CVI_distance_bytes, 1},
+    {"_CVI__CVI_distance_file", (DL_FUNC) &_CVI__CVI_distance_file, 4},
+    {"_CVI__CVI_pairwise_distances", (DL_FUNC) &_CVI__CVI_pairwise_distances, 3},
+    {"_CVI__CVI_create", (DL_FUNC) &_CVI__CVI_create, 6},
     {"_CVI__CVI_set_labels", (DL_FUNC) &_CVI__CVI_set_labels, 2},
     {"_CVI__CVI_compute", (DL_FUNC) &_CVI__CVI_compute, 1},
+    {"_CVI__CVI_compute_many", (DL_FUNC) &_CVI__CVI_compute_many, 2},
+    {"_CVI__CVI_evaluate", (DL_FUNC) &_CVI__CVI_evaluate, 6},
     {"_CVI__CVI_undo", (DL_FUNC) &_CVI__CVI_undo, 1},
+    {"_CVI__CVI_begin", (DL_FUNC) &_CVI__CVI_begin, 1},
+    {"_CVI__CVI_commit", (DL_FUNC) &_CVI__CVI_commit, 1},
+    {"_CVI__CVI_rollback", (DL_FUNC) &_CVI__CVI_rollback, 1},
     {"_CVI__CVI_modify", (DL_FUNC) &_CVI__CVI_modify, 3},
+    {"_CVI__CVI_swap", (DL_FUNC) &_CVI__CVI_swap, 3},
+    {"_CVI__CVI_modify_many", (DL_FUNC) &_CVI__CVI_modify_many, 3},
+    {"_CVI__CVI_clone", (DL_FUNC) &_CVI__CVI_clone, 1},
+    {"_CVI__CVI_confint", (DL_FUNC) &_CVI__CVI_confint, 1},
+    {"_CVI__CVI_num_rescans", (DL_FUNC) &_CVI__CVI_num_rescans, 1},
+    {"_CVI__CVI_score_point_moves", (DL_FUNC) &_CVI__CVI_score_point_moves, 2},
+    {"_CVI__CVI_score_all_moves", (DL_FUNC) &_CVI__CVI_score_all_moves, 1},
+    {"_CVI__CVI_set_num_threads", (DL_FUNC) &_CVI__CVI_set_num_threads, 1},
+    {"_CVI__CVI_distance_policy", (DL_FUNC) &_CVI__CVI_distance_policy, 4},
+    {"_CVI__CVI_distance_mode", (DL_FUNC) &_CVI__CVI_distance_mode, 1},
+    {"_CVI__CVI_distance_cache_stats", (DL_FUNC) &_CVI__CVI_distance_cache_stats, 1},
     {"_CVI_CVI_CalinskiHarabasz", (DL_FUNC) &_CVI_CVI_CalinskiHarabasz, 3},
+    {"_CVI_CVI_CalinskiHarabasz_many", (DL_FUNC) &_CVI_CVI_CalinskiHarabasz_many, 3},
     {"_CVI_CVI_WCSS", (DL_FUNC) &_CVI_CVI_WCSS, 3},
+    {"_CVI_CVI_WCSS_many", (DL_FUNC) &_CVI_CVI_WCSS_many, 3},
     {"_CVI_CVI_BallHall", (DL_FUNC) &_CVI_CVI_BallHall, 3},
+    {"_CVI_CVI_BallHall_many", (DL_FUNC) &_CVI_CVI_BallHall_many, 3},
     {"_CVI_CVI_Gamma", (DL_FUNC) &_CVI_CVI_Gamma, 3},
+    {"_CVI_CVI_Gamma_many", (DL_FUNC) &_CVI_CVI_Gamma_many, 3},
     {"_CVI_CVI_DaviesBouldin", (DL_FUNC) &_CVI_CVI_DaviesBouldin, 3},
+    {"_CVI_CVI_DaviesBouldin_many", (DL_FUNC) &_CVI_CVI_DaviesBouldin_many, 3},
     {"_CVI_CVI_Silhouette", (DL_FUNC) &_CVI_CVI_Silhouette, 3},
+    {"_CVI_CVI_Silhouette_many", (DL_FUNC) &_CVI_CVI_Silhouette_many, 3},
     {"_CVI_CVI_SilhouetteW", (DL_FUNC) &_CVI_CVI_SilhouetteW, 3},
+    {"_CVI_CVI_SilhouetteW_many", (DL_FUNC) &_CVI_CVI_SilhouetteW_many, 3},
     {"_CVI_CVI_Dunn", (DL_FUNC) &_CVI_CVI_Dunn, 3},
+    {"_CVI_CVI_Dunn_many", (DL_FUNC) &_CVI_CVI_Dunn_many, 3},
     {"_CVI_CVI_GDunn", (DL_FUNC) &_CVI_CVI_GDunn, 5},
+    {"_CVI_CVI_GDunn_many", (DL_FUNC) &_CVI_CVI_GDunn_many, 5},
     {"_CVI_CVI_WCNN", (DL_FUNC) &_CVI_CVI_WCNN, 4},
+    {"_CVI_CVI_WCNN_many", (DL_FUNC) &_CVI_CVI_WCNN_many, 4},
     {"_CVI_CVI_DuNNOWA", (DL_FUNC) &_CVI_CVI_DuNNOWA, 6},
-    {"_CVI__CVI_improve", (DL_FUNC) &_CVI__CVI_improve, 7},
+    {"_CVI_CVI_DuNNOWA_many", (DL_FUNC) &_CVI_CVI_DuNNOWA_many, 6},
+    {"_CVI__CVI_improve", (DL_FUNC) &_CVI__CVI_improve, 8},
     {"_CVI__CVI_improve_turbo", (DL_FUNC) &_CVI__CVI_improve_turbo, 5},
     {NULL, NULL, 0}
 };
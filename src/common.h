@@ -21,6 +21,11 @@
 #include <string>
 #include <limits>
 #include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 typedef double FLOAT_T; ///< float type we are working internally with
 
@@ -41,7 +46,8 @@ struct Hash {
      * @param x
      * @return
      */
-    size_t operator() (const std::vector<uint8_t>& x) const {
+    template<class Label>
+    size_t operator() (const std::vector<Label>& x) const {
         size_t seed = x[0];
         size_t n = x.size();
         for (size_t i=0; i<n; ++i) {
@@ -54,7 +60,7 @@ struct Hash {
 
 
 
-#define CVI_MAX_N_PRECOMPUTE_DISTANCE 10000
+
 
 #ifndef CVI_ASSERT
 #define __CVI_STR(x) #x
@@ -77,4 +83,50 @@ struct Hash {
 #define IS_PLUS_INFTY(x)  ((x) > 0.0 && !std::isfinite(x))
 #define IS_MINUS_INFTY(x) ((x) < 0.0 && !std::isfinite(x))
 
+
+
+/** Number of threads used by the OpenMP-parallelised parts of the code
+ *  (for internal use; see cvi_get_num_threads() and cvi_set_num_threads()).
+ *
+ *  Defaults to omp_get_max_threads(), i.e., the OMP_NUM_THREADS
+ *  environment variable is respected. Always 1 if OpenMP is not available.
+ */
+inline int& __cvi_num_threads()
+{
+#ifdef _OPENMP
+    static int num_threads = std::max(1, omp_get_max_threads());
+#else
+    static int num_threads = 1;
+#endif
+    return num_threads;
+}
+
+
+/** Returns the number of threads used by the OpenMP-parallelised parts
+ *  of the code.
+ */
+inline int cvi_get_num_threads()
+{
+    return __cvi_num_threads();
+}
+
+
+/** Sets the number of threads to be used by the OpenMP-parallelised parts
+ *  of the code. The results do not depend on this setting.
+ *
+ * @param num_threads positive integer; ignored if OpenMP is not available
+ * @return the previous setting
+ */
+inline int cvi_set_num_threads(int num_threads)
+{
+    CVI_ASSERT(num_threads >= 1);
+    int old = __cvi_num_threads();
+#ifdef _OPENMP
+    __cvi_num_threads() = num_threads;
+#endif
+    return old;
+}
+
+
+
 #endif
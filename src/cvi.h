@@ -21,27 +21,13 @@
 #include <algorithm>
 #include <vector>
 #include <string>
+#include <memory>
+#include <set>
+#include <exception>
 #include "common.h"
 #include "matrix.h"
-
-
-
-/** Computes the squared Euclidean distance between two vectors.
- *
- * @param x c_contiguous vector of length d
- * @param y c_contiguous vector of length d
- * @param d length of both x and y
- * @return sum((x-y)^2)
- */
-FLOAT_T distance_l2_squared(const FLOAT_T* x, const FLOAT_T* y, size_t d)
-{
-    FLOAT_T ret = 0.0;
-    for (size_t i=0; i<d; i++) {
-        ret += (x[i]-y[i])*(x[i]-y[i]);
-    }
-    return ret;
-}
-
+#include "distance.h"
+#include "dataset.h"
 
 
 
@@ -68,8 +54,13 @@ struct DistTriple {
         }
     }
 
-    bool operator<(const DistTriple& other) {
-        return this->d < other.d;
+    /** Lexicographic order w.r.t. (d, i1, i2), so that sorting
+     *  gives the same result regardless of the algorithm used.
+     */
+    bool operator<(const DistTriple& other) const {
+        return this->d < other.d || (this->d == other.d && (
+            this->i1 < other.i1 || (this->i1 == other.i1 &&
+            this->i2 < other.i2)));
     }
 
 };
@@ -78,107 +69,550 @@ struct DistTriple {
 
 
 
-
-/** Computes Euclidean distances between pairs of points in the same dataset.
- *  Results might be precomputed for smaller datasets.
+/** A journal of the changes made to an array (a vector or a matrix)
+ *  by consecutive calls to modify(), so that they can be reverted
+ *  one by one, in the reverse order, by undo().
+ *
+ *  Each modify() opens a new frame, in which the previous values of
+ *  the elements about to be changed are logged.  Outside of a transaction
+ *  (see ClusterValidityIndex::begin()), only the most recent frame
+ *  needs to be kept.  Logging when no frame is open is a no-op.
  */
-class EuclideanDistance
+template<class T>
+class UndoJournal
 {
-private:
-    const matrix<FLOAT_T>* X;
-    std::vector<FLOAT_T> D;
-    bool precomputed;
-    bool squared;
-    size_t n;
-    size_t d;
+protected:
+    std::vector<size_t> frames;  ///< the beginning of each frame in entries
+    std::vector< std::pair<size_t, T> > entries; ///< (element index, old value)
 
 public:
-    EuclideanDistance(const matrix<FLOAT_T>* _X, bool _precompute=false, bool _square=false)
-        : X(_X),
-          D(_precompute?(_X->nrow()*(_X->nrow()-1)/2):0),
-          precomputed(_precompute),
-          squared(_square),
-          n(_X->nrow()),
-          d(_X->ncol())
-    {
-        if (!_precompute) return;
-
-        size_t k = 0;
-        for (size_t i=0; i<n-1; ++i) {
-            for (size_t j=i+1; j<n; ++j) {
-                D[k++] = distance_l2_squared(_X->row(i), _X->row(j), d);
+    /** Opens a new frame
+     *
+     * @param keep shall the previous frames be kept (or discarded)?
+     */
+    void open(bool keep)
+    {
+        if (!keep) clear();
+        frames.push_back(entries.size());
+    }
+
+    /** Discards all the frames
+     */
+    void clear()
+    {
+        frames.clear();
+        entries.clear();
+    }
+
+    /** Returns the number of frames
+     */
+    size_t depth() const { return frames.size(); }
+
+    /** Logs the previous value of the k-th element
+     */
+    void log(size_t k, const T& old)
+    {
+        if (frames.empty()) return;
+        entries.push_back(std::pair<size_t, T>(k, old));
+    }
+
+    void log(const std::vector<T>& v, size_t k) { log(k, v[k]); }
+
+    void log(const matrix<T>& m, size_t i, size_t j) { log(i*m.ncol()+j, m(i, j)); }
+
+    /** Logs all the elements of a matrix
+     */
+    void log_all(const matrix<T>& m)
+    {
+        for (size_t k=0; k<m.nrow()*m.ncol(); ++k)
+            log(k, m.data()[k]);
+    }
+
+    /** Logs the elements in the a-th row and column of a square matrix
+     */
+    void log_row_col(const matrix<T>& m, size_t a)
+    {
+        for (size_t u=0; u<m.nrow(); ++u) {
+            log(m, a, u);
+            if (u != a) log(m, u, a);
+        }
+    }
+
+    /** Logs the elements in the a-th and the b-th row and column
+     *  of a square matrix (e.g., the distances between the clusters
+     *  affected by a move)
+     */
+    void log_rows_cols(const matrix<T>& m, size_t a, size_t b)
+    {
+        for (size_t u=0; u<m.nrow(); ++u) {
+            log(m, a, u);
+            log(m, b, u);
+            if (u != a && u != b) {
+                log(m, u, a);
+                log(m, u, b);
             }
         }
+    }
+
+    /** Restores the elements logged in the most recent frame
+     *  and closes it
+     *
+     * @param data the array whose changes are logged
+     */
+    void revert(T* data)
+    {
+        CVI_ASSERT(!frames.empty());
+        for (size_t k=entries.size(); k>frames.back(); --k)
+            data[entries[k-1].first] = entries[k-1].second;
+        entries.resize(frames.back());
+        frames.pop_back();
+    }
+
+    void revert(std::vector<T>& v) { revert(v.data()); }
+
+    void revert(matrix<T>& m) { revert(m.data()); }
+};
+
+
+
+/** A label change recorded for undo(): either a move of the i-th point
+ *  (k == i), see ClusterValidityIndex::modify(), a swap of the labels
+ *  of the i-th and the k-th point, see ClusterValidityIndex::swap(),
+ *  or a block of moves, see ClusterValidityIndex::modify_many()
+ */
+template<class Label>
+struct LabelChange
+{
+    size_t i;   ///< the point whose label has changed
+    Label j;    ///< its previous label
+    size_t k;   ///< the other point swapped or i
+
+    bool many;  ///< modify_many()?
+    std::vector<size_t> many_idx;     ///< the points moved by modify_many()
+    std::vector<Label> many_labels;   ///< their previous labels
+
+    LabelChange(size_t _i, Label _j, size_t _k)
+        : i(_i), j(_j), k(_k), many(false) { }
+
+    LabelChange(const std::vector<size_t>& idx, const std::vector<Label>& labels)
+        : i(0), j(0), k(0), many(true), many_idx(idx), many_labels(labels) { }
+
+    bool is_swap() const { return !many && k != i; }
+    bool is_many() const { return many; }
+};
+
+
+
+/** Read-only view of the current partition, i.e., the label vector
+ *  and the cluster sizes; see also MovedPartitionView.
+ *
+ *  The indices implement compute() and score_move() by means of
+ *  the same function template parametrised by the view type.
+ */
+template<class Label>
+struct PartitionView
+{
+    const std::vector<Label>& L;        ///< label vector of size n
+    const std::vector<size_t>& count;   ///< size of each of the K clusters
+
+    PartitionView(
+            const std::vector<Label>& _L,
+            const std::vector<size_t>& _count)
+        : L(_L), count(_count)
+    { }
+
+    inline Label label(size_t u) const { return L[u]; }
+    inline size_t size(size_t k) const { return count[k]; }
+};
+
+
+
+/** Read-only view of the partition that would be obtained by moving
+ *  the i-th point to the j-th cluster; the underlying label vector
+ *  and cluster sizes are not modified.
+ */
+template<class Label>
+struct MovedPartitionView
+{
+    const std::vector<Label>& L;        ///< label vector of size n
+    const std::vector<size_t>& count;   ///< size of each of the K clusters
+    const size_t i;                     ///< the point being moved
+    const Label from;                   ///< its current label, L[i]
+    const Label to;                     ///< its new label
+
+    MovedPartitionView(
+            const std::vector<Label>& _L,
+            const std::vector<size_t>& _count,
+            size_t _i,
+            size_t _j)
+        : L(_L), count(_count), i(_i), from(_L[_i]), to((Label)_j)
+    {
+        CVI_ASSERT(i >= 0 && i < L.size());
+        CVI_ASSERT(to >= 0 && to < count.size());
+        CVI_ASSERT(from != to);
+        CVI_ASSERT(count[from] > 1);
+    }
+
+    inline Label label(size_t u) const { return (u == i)?to:L[u]; }
+
+    inline size_t size(size_t k) const {
+        if (k == from) return count[k]-1;
+        else if (k == to) return count[k]+1;
+        else return count[k];
+    }
+};
+
+
+
+/** A PartitionView together with the clusters' centroids
+ */
+template<class Label>
+struct CentroidsView : public PartitionView<Label>
+{
+    const matrix<FLOAT_T>& centroids;   ///< size K*d
+
+    CentroidsView(
+            const std::vector<Label>& _L,
+            const std::vector<size_t>& _count,
+            const matrix<FLOAT_T>& _centroids)
+        : PartitionView<Label>(_L, _count), centroids(_centroids)
+    { }
+
+    inline const FLOAT_T* centroid(size_t k) const { return centroids.row(k); }
+};
+
 
-        if (!_square) {
-            for (k=0; k<D.size(); ++k)
-                D[k] = sqrt(D[k]);
+
+/** A MovedPartitionView together with the clusters' centroids;
+ *  only the centroids of the two affected clusters are stored
+ *  (they are updated in the same way as in CentroidsBasedIndex::modify()).
+ */
+template<class Label>
+struct MovedCentroidsView : public MovedPartitionView<Label>
+{
+    using MovedPartitionView<Label>::count;
+    using MovedPartitionView<Label>::i;
+    using MovedPartitionView<Label>::from;
+    using MovedPartitionView<Label>::to;
+
+    const matrix<FLOAT_T>& centroids;   ///< the current centroids, size K*d
+    std::vector<FLOAT_T> c_from;        ///< the new centroid of the from-th cluster
+    std::vector<FLOAT_T> c_to;          ///< the new centroid of the to-th cluster
+
+    MovedCentroidsView(
+            const matrix_view<FLOAT_T>& X,
+            const std::vector<Label>& _L,
+            const std::vector<size_t>& _count,
+            const matrix<FLOAT_T>& _centroids,
+            size_t _i,
+            size_t _j)
+        : MovedPartitionView<Label>(_L, _count, _i, _j), centroids(_centroids),
+          c_from(_centroids.ncol()), c_to(_centroids.ncol())
+    {
+        for (size_t k=0; k<centroids.ncol(); ++k) {
+            c_from[k]  = centroids(from, k);
+            c_from[k] *= (FLOAT_T) count[from];
+            c_from[k] -= X(i,k);
+            c_from[k] /= (FLOAT_T) (count[from]-1.0);
+
+            c_to[k]    = centroids(to, k);
+            c_to[k]   *= (FLOAT_T) count[to];
+            c_to[k]   += X(i,k);
+            c_to[k]   /= (FLOAT_T) (count[to]+1.0);
         }
     }
 
+    inline const FLOAT_T* centroid(size_t k) const {
+        if (k == from) return c_from.data();
+        else if (k == to) return c_to.data();
+        else return centroids.row(k);
+    }
+};
+
+
+
+/** Keeps track of the edges of a minimum spanning tree
+ *  (see Dataset::get_mst()) that join points with different labels,
+ *  so that the minimum of the distances between such points,
+ *  i.e., the smallest distance between two clusters, is available
+ *  in O(1) time.  A label change requires O(log n) time per
+ *  MST edge incident to the point concerned.
+ *
+ *  The changes can be reverted, see open() and revert().
+ */
+template<class Label>
+class CrossLabelEdges
+{
+protected:
+    std::shared_ptr<const MinimumSpanningTree> mst;  ///< NULL if not set
+    std::vector<bool> is_cross;  ///< does the e-th edge join different labels?
+    std::set<size_t> cross;      ///< the edges joining different labels
+    std::vector<size_t> frames;  ///< the beginning of each frame in toggled
+    std::vector<size_t> toggled; ///< the edges whose state has changed
+
+    void toggle(size_t e)
+    {
+        is_cross[e] = !is_cross[e];
+        if (is_cross[e]) cross.insert(e);
+        else cross.erase(e);
+    }
+
+public:
+    CrossLabelEdges() { }
+
+    CrossLabelEdges(const std::shared_ptr<const MinimumSpanningTree>& _mst)
+        : mst(_mst), is_cross(_mst->d.size(), false)
+    { }
+
+    /** Is the MST given? */
+    bool is_set() const { return (bool)mst; }
 
-    const FLOAT_T operator()(size_t i, size_t j) const
+    /** Opens a new frame of changes, see UndoJournal::open()
+     */
+    void open(bool keep)
     {
-        if (i == j) return 0.0;
-        if (precomputed) {
-            if (i > j) std::swap(i, j);
-            //CVI_ASSERT(i*n - i*(i+1)/2+(j-i-1) >= 0);
-            //CVI_ASSERT(i*n - i*(i+1)/2+(j-i-1) < D.size());
-            return D[i*n - i*(i+1)/2 + (j-i-1)];
+        if (!keep) {
+            frames.clear();
+            toggled.clear();
         }
-        else {
-            if (squared)
-                return distance_l2_squared(X->row(i), X->row(j), X->ncol());
-            else
-                return sqrt(distance_l2_squared(X->row(i), X->row(j), X->ncol()));
+        frames.push_back(toggled.size());
+    }
+
+    /** Reverts the changes made in the most recent frame and closes it
+     */
+    void revert()
+    {
+        CVI_ASSERT(!frames.empty());
+        for (size_t k=toggled.size(); k>frames.back(); --k)
+            toggle(toggled[k-1]);
+        toggled.resize(frames.back());
+        frames.pop_back();
+    }
+
+    /** Determines the state of all the edges; discards all the frames
+     */
+    void recompute(const std::vector<Label>& L)
+    {
+        frames.clear();
+        toggled.clear();
+        cross.clear();
+        for (size_t e=0; e<is_cross.size(); ++e) {
+            is_cross[e] = (L[mst->i1[e]] != L[mst->i2[e]]);
+            if (is_cross[e]) cross.insert(cross.end(), e);
+        }
+    }
+
+    /** Updates the state of the edges incident to the i-th point
+     *  whose label has changed (logged if a frame is open)
+     */
+    void update(size_t i, const std::vector<Label>& L)
+    {
+        const std::vector<size_t>& inc = mst->incident[i];
+        for (size_t t=0; t<inc.size(); ++t) {
+            size_t e = inc[t];
+            if ((L[mst->i1[e]] != L[mst->i2[e]]) != is_cross[e]) {
+                toggle(e);
+                if (!frames.empty()) toggled.push_back(e);
+            }
+        }
+    }
+
+    /** Returns the smallest distance between two points with
+     *  different labels (INFTY if there are none)
+     */
+    FLOAT_T get_min() const
+    {
+        return (cross.empty())?INFTY:mst->d[*cross.begin()];
+    }
+
+    /** Determines get_min() as if the P.i-th point was moved to the P.to-th
+     *  cluster; only the edges incident to it may change their state
+     */
+    FLOAT_T get_min_moved(const MovedPartitionView<Label>& P) const
+    {
+        FLOAT_T res = INFTY;
+        for (std::set<size_t>::const_iterator it=cross.begin(); it!=cross.end(); ++it) {
+            size_t e = *it;
+            if ((mst->i1[e] == P.i || mst->i2[e] == P.i) &&
+                    P.label(mst->i1[e]) == P.label(mst->i2[e]))
+                continue;  // no longer joins different labels
+            res = mst->d[e];
+            break;
+        }
+
+        const std::vector<size_t>& inc = mst->incident[P.i];
+        for (size_t t=0; t<inc.size(); ++t) {
+            size_t e = inc[t];
+            if (P.label(mst->i1[e]) != P.label(mst->i2[e]) && mst->d[e] < res)
+                res = mst->d[e];
         }
+        return res;
     }
 };
 
 
 
+/** The interface to all the internal cluster validity indices implemented,
+ *  regardless of the type used to store the labels;
+ *  see LabelledIndex for the description of the methods.
+ *
+ *  The label vectors can only be accessed through LabelledIndex<Label>,
+ *  where Label is determined by get_label_size().
+ */
+class ClusterValidityIndex
+{
+public:
+    virtual ~ClusterValidityIndex() { }
+
+    virtual ClusterValidityIndex* clone() const = 0;
+
+    /** Returns sizeof(Label), see LabelledIndex
+     */
+    virtual size_t get_label_size() const = 0;
+
+    virtual size_t get_count(size_t j) const = 0;
+    virtual size_t get_label(size_t i) const = 0;
+    virtual size_t get_K() const = 0;
+    virtual size_t get_n() const = 0;
+
+    virtual void modify(size_t i, size_t j) = 0;
+    virtual void swap(size_t i, size_t k) = 0;
+    virtual FLOAT_T compute() = 0;
+    virtual FLOAT_T score_move(size_t i, size_t j) const = 0;
+    virtual void score_point_moves(size_t i, FLOAT_T* res) const = 0;
+    virtual void score_all_moves(matrix<FLOAT_T>& res) const = 0;
+    virtual const EuclideanDistance* get_distance() const { return NULL; }
+
+    virtual void undo() = 0;
+    virtual bool can_undo() const = 0;
+    virtual void begin() = 0;
+    virtual void commit() = 0;
+    virtual void rollback() = 0;
+};
+
+
 
 /** Base class for all the internal cluster validity indices implemented.
+ *
+ *  The labels are stored as Label: uint8_t (for K <= 256), uint16_t
+ *  or uint32_t, see __CVI_create(), so that in the most common case
+ *  of few clusters the label vector stays compact.
  */
-class ClusterValidityIndex
+template<class Label>
+class LabelledIndex : public ClusterValidityIndex
 {
 protected:
-    matrix<FLOAT_T> X;         ///< data matrix of size n*d
-    std::vector<uint8_t> L;    ///< current label vector of size n
+    DatasetPtr data;           ///< dataset (shared)
+    const matrix_view<FLOAT_T> X;  ///< data matrix of size n*d, data->get_X()
+    std::vector<Label> L;      ///< current label vector of size n
     std::vector<size_t> count; ///< size of each of the K clusters
-    const uint8_t K;           ///< number of clusters, max(L)
+    const size_t K;            ///< number of clusters, max(L)
     const size_t n;            ///< number of points (for brevity of notation)
     const size_t d;            ///< dataset dimensionality (for brevity)
     const bool allow_undo;     ///< is the object's state preserved on modify()?
+    const int metric;          ///< w.r.t. which the distances and NNs are determined
+    const int distance_storage; ///< how the precomputed distances are stored
+
+    std::vector< LabelChange<Label> > journal; ///< each modify() and swap(), for undo()
+    std::vector<size_t> transactions; ///< journal sizes at the corresponding begin() calls
 
-    size_t last_i;             ///< for undo()
-    uint8_t last_j;            ///< for undo()
+
+    /** Checks if modify_many(idx, labels) can be called;
+     *  the inheriting classes call it before modifying their state
+     */
+    void check_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) const
+    {
+        CVI_ASSERT(idx.size() == labels.size());
+        for (size_t t=0; t<idx.size(); ++t) {
+            CVI_ASSERT(idx[t] >= 0 && idx[t] < n);
+            CVI_ASSERT(labels[t] >= 0 && labels[t] < K);
+        }
+
+        std::vector<size_t> sorted_idx(idx);
+        std::sort(sorted_idx.begin(), sorted_idx.end());
+        CVI_ASSERT(std::adjacent_find(sorted_idx.begin(), sorted_idx.end()) == sorted_idx.end());
+
+        std::vector<size_t> new_count(count);
+        for (size_t t=0; t<idx.size(); ++t) {
+            new_count[L[idx[t]]]--;
+            new_count[labels[t]]++;
+        }
+        for (size_t j=0; j<K; ++j)
+            CVI_ASSERT(new_count[j] > 0);
+    }
+
+
+    /** Sets L[idx[t]] = labels[t] for all t and updates count
+     */
+    void set_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels)
+    {
+        for (size_t t=0; t<idx.size(); ++t) {
+            count[L[idx[t]]]--;
+            L[idx[t]] = labels[t];
+            count[L[idx[t]]]++;
+        }
+    }
+
+
+    /** Are we in a transaction?  If not, the state needed to undo()
+     *  the previous modify() call may be discarded on the next one.
+     */
+    bool in_transaction() const { return !transactions.empty(); }
 
 public:
 
     /** Constructor
      *
-     * @param _X dataset
+     * @param _data dataset; its auxiliary data structures
+     *      (e.g., the pairwise distances) may be shared with other objects
      * @param _K number of clusters
      * @param _allow_undo shall the object's state be preserved on a call to
      *      modify()?
+     * @param _metric w.r.t. which the pairwise distances and nearest
+     *      neighbours are requested from the dataset, one of CVI_METRIC_*
+     * @param _distance_storage how the precomputed pairwise distances
+     *      are to be stored, one of CVI_DISTANCE_*
      */
-    ClusterValidityIndex(
-            const matrix<FLOAT_T>& _X,
-            const uint8_t _K,
-            const bool _allow_undo
+    LabelledIndex(
+            const DatasetPtr& _data,
+            const size_t _K,
+            const bool _allow_undo,
+            const int _metric=CVI_METRIC_EUCLIDEAN,
+            const int _distance_storage=CVI_DISTANCE_DOUBLE
     )
-        : X(_X), L(_X.nrow()), count(_K),
-          K(_K), n(_X.nrow()), d(_X.ncol()), allow_undo(_allow_undo)
+        : data(_data), X(_data->get_X()), L(X.nrow()), count(_K),
+          K(_K), n(X.nrow()), d(X.ncol()), allow_undo(_allow_undo),
+          metric(_metric), distance_storage(_distance_storage)
     {
-
+        CVI_ASSERT(K >= 1 && K-1 <= (size_t)std::numeric_limits<Label>::max());
     }
 
 
 
     /** Destructor
      */
-    virtual ~ClusterValidityIndex() { }
+    virtual ~LabelledIndex() { }
+
+
+
+    /** Returns a replica of this object (to be deleted by the caller)
+     *
+     *  Only the mutable state (the labels, the cluster sizes, centroids
+     *  and other auxiliary data depending on the labels) is copied.
+     *  The immutable parts (the dataset, the pairwise distances,
+     *  the nearest neighbours etc.) are shared, therefore, e.g.,
+     *  one replica per thread can be used at a low memory cost.
+     *  In the row cache mode, each replica gets its own cache
+     *  (see EuclideanDistance::clone()).
+     */
+    virtual ClusterValidityIndex* clone() const = 0;
+
+
+    /** Returns sizeof(Label), i.e., 1, 2 or 4
+     */
+    virtual size_t get_label_size() const { return sizeof(Label); }
 
 
     /** Returns the number of elements in the j-th cluster
@@ -186,7 +620,7 @@ public:
      * @param j
      * @return
      */
-    size_t get_count(const uint8_t j) const
+    virtual size_t get_count(size_t j) const
     {
         CVI_ASSERT(j >= 0 && j < K);
         return count[j];
@@ -197,7 +631,7 @@ public:
      * @param i
      * @return
      */
-    uint8_t get_label(const size_t i) const
+    virtual size_t get_label(size_t i) const
     {
         CVI_ASSERT(i >= 0 && i < n);
         return L[i];
@@ -207,30 +641,33 @@ public:
      *
      * @return
      */
-    const std::vector<uint8_t>& get_labels() const { return L; }
+    const std::vector<Label>& get_labels() const { return L; }
 
 
     /** Returns the number of clusters
      *
      * @return
      */
-    const size_t get_K() const { return K; }
+    virtual size_t get_K() const { return K; }
 
 
     /** Returns the number of data points
      *
      * @return
      */
-    const size_t get_n() const { return n; }
+    virtual size_t get_n() const { return n; }
 
 
     /** Assigns a new label vector
      *
      * @param _L
      */
-    virtual void set_labels(const std::vector<uint8_t>& _L)
+    virtual void set_labels(const std::vector<Label>& _L)
     {
         CVI_ASSERT(X.nrow() == _L.size());
+        CVI_ASSERT(!in_transaction());
+        journal.clear();
+
         for (size_t j=0; j<K; ++j) {
             count[j] = 0;
         }
@@ -255,7 +692,7 @@ public:
      * @param i
      * @param j
      */
-    virtual void modify(size_t i, uint8_t j)
+    virtual void modify(size_t i, size_t j)
     {
         CVI_ASSERT(i >= 0 && i < n);
         CVI_ASSERT(j >= 0 && j < K);
@@ -265,62 +702,445 @@ public:
 
 
         if (allow_undo) {
-            last_i = i;
-            last_j = L[i];
+            if (!in_transaction()) journal.clear();
+            journal.push_back(LabelChange<Label>(i, L[i], i));
         }
 
         count[L[i]]--;
-        L[i] = j;
+        L[i] = (Label)j;
         count[L[i]]++;
     }
 
+
+    /** Exchanges the labels of the i-th and the k-th point
+     *
+     *  The cluster sizes do not change, hence, unlike with two modify()
+     *  calls, singletons can be swapped too.  The inheriting classes
+     *  overload this method and update their state in a single pass;
+     *  undo() cancels the whole swap.
+     *
+     * @param i
+     * @param k a point from a different cluster than i
+     */
+    virtual void swap(size_t i, size_t k)
+    {
+        CVI_ASSERT(i >= 0 && i < n);
+        CVI_ASSERT(k >= 0 && k < n);
+        CVI_ASSERT(L[i] != L[k]);
+
+        if (allow_undo) {
+            if (!in_transaction()) journal.clear();
+            journal.push_back(LabelChange<Label>(i, L[i], k));
+        }
+
+        std::swap(L[i], L[k]);
+    }
+
+    /** Sets L[idx[t]] = labels[t] for all t
+     *
+     *  The result is the same as with a series of modify() calls,
+     *  but the inheriting classes update their state once for
+     *  the whole block, at a cost proportional to (at most) the number
+     *  of the points moved times n; moreover, the clusters may
+     *  become empty in-between.  A single undo() cancels all the changes.
+     *
+     * @param idx indexes of the points to move, without duplicates
+     * @param labels new labels, of the same size as idx
+     */
+    virtual void modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels)
+    {
+        check_many(idx, labels);
+
+        if (allow_undo) {
+            if (!in_transaction()) journal.clear();
+            std::vector<Label> old(idx.size());
+            for (size_t t=0; t<idx.size(); ++t)
+                old[t] = L[idx[t]];
+            journal.push_back(LabelChange<Label>(idx, old));
+        }
+
+        set_many(idx, labels);
+    }
+
+
     /** Computes the cluster validity index for the current label vector, L
      */
     virtual FLOAT_T compute() = 0;
 
 
+    /** Returns the value of the cluster validity index that would be
+     *  obtained if the i-th point was moved to the j-th cluster,
+     *  without modifying the object's state (L, count, the auxiliary
+     *  data structures).
+     *
+     *  The inheriting classes override this method; such specialised
+     *  implementations may be called by many threads simultaneously
+     *  provided that get_distance() is NULL or is_thread_safe().
+     *  The default one is a generic fallback based on modify() and compute()
+     *  run within a transaction that is then rolled back, so that
+     *  the journal (a pending undo() included) is preserved;
+     *  it requires allow_undo and is not thread-safe.
+     *
+     *  The i-th point's cluster must have at least 2 members.
+     *
+     * @param i
+     * @param j
+     * @return
+     */
+    virtual FLOAT_T score_move(size_t i, size_t j) const
+    {
+        CVI_ASSERT(allow_undo);
+        CVI_ASSERT(count[L[i]] > 1);
+
+        LabelledIndex* self = const_cast<LabelledIndex*>(this);
+        FLOAT_T ret;
+        self->begin();
+        try {
+            self->modify(i, j);
+            ret = self->compute();
+        }
+        catch (...) {
+            self->rollback();
+            throw;
+        }
+        self->rollback();
+        return ret;
+    }
 
 
-    /** Cancels the most recent modify() operation.
+    /** Determines score_move(i, j) for a fixed i and all j at once
+     *
+     *  The inheriting classes may override this method and share
+     *  the work between the K candidate moves of the i-th point.
+     *  The default one calls score_move() for each move.
+     *
+     *  res[j] is set to NaN if the move is not allowed, i.e.,
+     *  if j == L[i] or the i-th point is a singleton.
+     *
+     * @param i
+     * @param res [out] array of size K
+     */
+    virtual void score_point_moves(size_t i, FLOAT_T* res) const
+    {
+        for (size_t j=0; j<K; ++j) {
+            if (L[i] == j || count[L[i]] <= 1)
+                res[j] = std::numeric_limits<FLOAT_T>::quiet_NaN();
+            else
+                res[j] = score_move(i, j);
+        }
+    }
+
+
+    /** Determines score_move(i, j) for all i and j at once
+     *
+     *  The inheriting classes may override this method and share
+     *  the work between the candidate moves.  The default one calls
+     *  score_point_moves() for each point.
+     *
+     *  res(i, j) is set to NaN if the move is not allowed, i.e.,
+     *  if j == L[i] or the i-th point is a singleton.
+     *
+     * @param res [out] matrix of size n*K
+     */
+    virtual void score_all_moves(matrix<FLOAT_T>& res) const
+    {
+        CVI_ASSERT(res.nrow() == n && res.ncol() == K);
+        for (size_t i=0; i<n; ++i)
+            score_point_moves(i, res.row(i));
+    }
+
+
+    /** Returns the object that provides the pairwise distances
+     *  or NULL if the index does not rely on them
+     */
+    virtual const EuclideanDistance* get_distance() const { return NULL; }
+
+
+    /** Computes the cluster validity index for each of the given
+     *  label vectors, without modifying the object's state
+     *
+     *  The label vectors are processed in parallel
+     *  (see cvi_get_num_threads()), each thread using its own replica
+     *  of this object, see clone().  Hence, the results are the same
+     *  as those of set_labels() followed by compute().
+     *
+     * @param Ls label vectors, each of size n, with no empty clusters
+     * @param res [out] vector of size Ls.size()
+     */
+    void compute_many(const std::vector< std::vector<Label> >& Ls,
+        std::vector<FLOAT_T>& res) const
+    {
+        CVI_ASSERT(res.size() == Ls.size());
+        CVI_ASSERT(!in_transaction());
+
+        // validate all the inputs first, so that the common errors
+        // are reported before any work is done
+        std::vector<size_t> _count(K);
+        for (size_t c=0; c<Ls.size(); ++c) {
+            CVI_ASSERT(Ls[c].size() == n);
+            std::fill(_count.begin(), _count.end(), 0);
+            for (size_t i=0; i<n; ++i) {
+                CVI_ASSERT(Ls[c][i] >= 0 && Ls[c][i] < K);
+                _count[Ls[c][i]]++;
+            }
+            for (size_t j=0; j<K; ++j)
+                CVI_ASSERT(_count[j] > 0);
+        }
+
+        size_t nthreads = std::max((size_t)1,
+            std::min((size_t)cvi_get_num_threads(), Ls.size()));
+        std::vector< std::unique_ptr<LabelledIndex> > replicas(nthreads);
+        for (size_t t=0; t<nthreads; ++t)
+            replicas[t].reset(static_cast<LabelledIndex*>(clone()));
+
+        // compute() may still throw (e.g., for degenerate partitions);
+        // an exception escaping the parallel region would terminate
+        // the program, hence the first one is caught and rethrown later
+        std::exception_ptr err;
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+        #endif
+        for (size_t c=0; c<Ls.size(); ++c) {
+            #ifdef _OPENMP
+            LabelledIndex* r = replicas[omp_get_thread_num()].get();
+            #else
+            LabelledIndex* r = replicas[0].get();
+            #endif
+            try {
+                r->set_labels(Ls[c]);
+                res[c] = r->compute();
+            }
+            catch (...) {
+                #ifdef _OPENMP
+                #pragma omp critical(cvi_compute_many)
+                #endif
+                if (!err) err = std::current_exception();
+            }
+        }
+
+        if (err) std::rethrow_exception(err);
+    }
+
+
+
+    /** Cancels the most recent modify(), swap() or modify_many() operation.
+     *
+     *  Within a transaction, it can be called repeatedly, but only
+     *  for the modifications made since the corresponding begin().
+     *  Outside of a transaction, only one step back is possible.
      */
     virtual void undo()
+    {
+        CVI_ASSERT(can_undo());
+
+        const LabelChange<Label>& last = journal.back();
+
+        if (last.is_many())
+            set_many(last.many_idx, last.many_labels);
+        else if (last.is_swap())
+            std::swap(L[last.i], L[last.k]);
+        else {
+            count[L[last.i]]--;
+            L[last.i] = last.j;
+            count[L[last.i]]++;
+        }
+
+        journal.pop_back();
+    }
+
+
+    /** Can undo() be called now?
+     *
+     *  The inheriting classes check this before reverting their own state.
+     */
+    virtual bool can_undo() const
+    {
+        return allow_undo && !journal.empty() &&
+            (!in_transaction() || journal.size() > transactions.back());
+    }
+
+
+    /** Starts a transaction: a sequence of modify() and swap() calls which can be
+     *  cancelled altogether by calling rollback() or accepted by commit().
+     *
+     *  Transactions can be nested.  Each index keeps a journal of
+     *  the (compact) changes made to its auxiliary data structures,
+     *  therefore compound moves and look-ahead searches do not require
+     *  set_labels() to restore the previous state.
+     */
+    virtual void begin()
     {
         CVI_ASSERT(allow_undo);
+        transactions.push_back(journal.size());
+    }
 
-        count[L[last_i]]--;
-        L[last_i] = last_j;
-        count[L[last_i]]++;
+
+    /** Accepts all the modifications made since the most recent begin()
+     *
+     *  In a nested transaction, they can still be rolled back
+     *  by the enclosing one.
+     */
+    virtual void commit()
+    {
+        CVI_ASSERT(in_transaction());
+        transactions.pop_back();
+    }
+
+
+    /** Cancels all the modifications made since the most recent begin()
+     *  by calling undo() repeatedly, and ends the transaction
+     */
+    virtual void rollback()
+    {
+        CVI_ASSERT(in_transaction());
+        while (journal.size() > transactions.back())
+            undo();
+        transactions.pop_back();
     }
 };
 
 
 
+/** Casts a CVI object to the LabelledIndex<Label> it is an instance of;
+ *  Label must agree with ClusterValidityIndex::get_label_size()
+ */
+template<class Label>
+LabelledIndex<Label>* as_labelled(ClusterValidityIndex* cvi)
+{
+    CVI_ASSERT(cvi->get_label_size() == sizeof(Label));
+    return static_cast< LabelledIndex<Label>* >(cvi);
+}
+
+
+
+/** Brings the protected members of LabelledIndex<Label> into the scope
+ *  of an inheriting class template (they are not looked up in
+ *  a dependent base class otherwise); Base is a LabelledIndex<Label>
+ *  or a class derived from it
+ */
+#define CVI_LABELLED_INDEX_MEMBERS(Base) \
+    using Base::data; \
+    using Base::X; \
+    using Base::L; \
+    using Base::count; \
+    using Base::K; \
+    using Base::n; \
+    using Base::d; \
+    using Base::allow_undo; \
+    using Base::metric; \
+    using Base::distance_storage; \
+    using Base::journal; \
+    using Base::check_many; \
+    using Base::in_transaction; \
+    using Base::can_undo;
+
+
+
 /** Represents a cluster validity index that is based
  * on the notion of the clusters' centroid.
+ *
+ * Only the Euclidean metric is supported; the data matrix
+ * must be available (see Dataset::has_coordinates()).
  */
-class CentroidsBasedIndex : public ClusterValidityIndex
+template<class Label>
+class CentroidsBasedIndex : public LabelledIndex<Label>
 {
 protected:
+    CVI_LABELLED_INDEX_MEMBERS(LabelledIndex<Label>)
+
     matrix<FLOAT_T> centroids;     ///< centroids of all the clusters, size K*d
+    const matrix<FLOAT_T>* given_centroids; ///< see set_labels_and_centroids()
+
+
+    /** Updates the centroids as if L[idx[t]] was set to labels[t]
+     *  for all t (no duplicates); L and count are not modified.
+     *
+     *  Only the affected clusters are updated: their centroids are
+     *  converted to sums, which are then adjusted for the moved points.
+     */
+    void move_centroids(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels)
+    {
+        std::vector<size_t> new_count(count);
+        std::vector<bool> affected(K, false);
+        for (size_t t=0; t<idx.size(); ++t) {
+            Label a = L[idx[t]], b = labels[t];
+            if (a == b) continue;
+            if (!affected[a]) centroids_to_sums(a);
+            if (!affected[b]) centroids_to_sums(b);
+            affected[a] = affected[b] = true;
+            new_count[a]--;
+            new_count[b]++;
+            for (size_t u=0; u<d; ++u) {
+                centroids(a, u) -= X(idx[t], u);
+                centroids(b, u) += X(idx[t], u);
+            }
+        }
+
+        for (size_t j=0; j<K; ++j) {
+            if (!affected[j]) continue;
+            CVI_ASSERT(new_count[j] > 0);
+            for (size_t u=0; u<d; ++u)
+                centroids(j, u) /= (FLOAT_T)new_count[j];
+        }
+    }
+
+
+    /** Multiplies the j-th centroid by the size of the j-th cluster
+     */
+    void centroids_to_sums(size_t j)
+    {
+        for (size_t u=0; u<d; ++u)
+            centroids(j, u) *= (FLOAT_T)count[j];
+    }
+
+
+    /** Updates the centroids of the clusters of the i-th and the k-th point
+     *  as if their labels were exchanged; the labels are not modified.
+     *
+     *  Applied once again after the labels have been exchanged,
+     *  reverts the update.
+     */
+    void swap_centroids(size_t i, size_t k)
+    {
+        Label a = L[i], b = L[k];
+        for (size_t u=0; u<d; ++u) {
+            FLOAT_T diff = X(k,u)-X(i,u);
+            centroids(a, u) += diff/(FLOAT_T)count[a];
+            centroids(b, u) -= diff/(FLOAT_T)count[b];
+        }
+    }
 
 
 public:
     // Described in the base class
     CentroidsBasedIndex(
-            const matrix<FLOAT_T>& _X,
-            const uint8_t _K,
-            const bool _allow_undo)
-        : ClusterValidityIndex(_X, _K, _allow_undo),
-          centroids(K, d)
+            const DatasetPtr& _data,
+            const size_t _K,
+            const bool _allow_undo,
+            const int _metric=CVI_METRIC_EUCLIDEAN,
+            const int _distance_storage=CVI_DISTANCE_DOUBLE)
+        : LabelledIndex<Label>(_data, _K, _allow_undo,
+            _metric, _distance_storage),
+          centroids(K, d), given_centroids(NULL)
     {
-        ;
+        if (!data->has_coordinates())
+            throw std::runtime_error("CVI: centroid-based indices require the data matrix, not only the pairwise distances");
+        if (metric != CVI_METRIC_EUCLIDEAN)
+            throw std::runtime_error("CVI: centroid-based indices support only the Euclidean metric");
     }
 
 
     // Described in the base class
-    virtual void set_labels(const std::vector<uint8_t>& _L)
+    virtual void set_labels(const std::vector<Label>& _L)
     {
-        ClusterValidityIndex::set_labels(_L); // sets L and count
+        LabelledIndex<Label>::set_labels(_L); // sets L and count
+
+        if (given_centroids) {
+            centroids = *given_centroids;
+            return;
+        }
 
         for (size_t i=0; i<K; ++i) {
             for (size_t j=0; j<d; ++j) {
@@ -340,10 +1160,38 @@ public:
     }
 
 
+    /** Returns the current centroids, size K*d
+     */
+    const matrix<FLOAT_T>& get_centroids() const { return centroids; }
+
+
+    /** The same as set_labels(_L), but the centroids are copied from
+     *  _centroids (e.g., another object's get_centroids() for the same _L)
+     *  instead of being computed
+     *
+     * @param _L
+     * @param _centroids centroids of the clusters defined by _L, size K*d
+     */
+    void set_labels_and_centroids(const std::vector<Label>& _L,
+        const matrix<FLOAT_T>& _centroids)
+    {
+        CVI_ASSERT(_centroids.nrow() == K && _centroids.ncol() == d);
+        given_centroids = &_centroids;
+        try {
+            set_labels(_L);
+        }
+        catch (...) {
+            given_centroids = NULL;
+            throw;
+        }
+        given_centroids = NULL;
+    }
+
+
     // Described in the base class
-    virtual void modify(size_t i, uint8_t j)
+    virtual void modify(size_t i, size_t j)
     {
-        uint8_t tmp = L[i];
+        Label tmp = L[i];
         // tmp = old label for the i-th point
         // j   = new label for the i-th point
 
@@ -360,15 +1208,49 @@ public:
             centroids(j, k)   /= (FLOAT_T) (count[j]+1.0);
         }
 
-        ClusterValidityIndex::modify(i, j); // sets L[i]=j and updates count
+        LabelledIndex<Label>::modify(i, j); // sets L[i]=j and updates count
 
         // -----------------------------
     }
 
 
+    // Described in the base class
+    virtual void swap(size_t i, size_t k)
+    {
+        CVI_ASSERT(L[i] != L[k]);
+        swap_centroids(i, k);
+        LabelledIndex<Label>::swap(i, k); // exchanges L[i] and L[k]
+    }
+
+
+    // Described in the base class
+    virtual void modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels)
+    {
+        check_many(idx, labels);
+        move_centroids(idx, labels);
+        LabelledIndex<Label>::modify_many(idx, labels); // sets L and count
+    }
+
+
     // Described in the base class
     virtual void undo()
     {
+        CVI_ASSERT(can_undo());
+        if (journal.back().is_many()) {
+            move_centroids(journal.back().many_idx, journal.back().many_labels);
+            LabelledIndex<Label>::undo();
+            return;
+        }
+        else if (journal.back().is_swap()) {
+            swap_centroids(journal.back().i, journal.back().k);
+            LabelledIndex<Label>::undo();
+            return;
+        }
+
+        size_t last_i = journal.back().i;
+        Label last_j = journal.back().j;
+
         size_t tmp = L[last_i];
         for (size_t k=0; k<d; ++k) {
             centroids(tmp, k) *= (FLOAT_T) count[tmp];
@@ -380,7 +1262,7 @@ public:
             centroids(last_j, k)   /= (FLOAT_T) (count[last_j]+1.0);
         }
 
-        ClusterValidityIndex::undo();
+        LabelledIndex<Label>::undo();
     }
 
 };
@@ -391,56 +1273,34 @@ public:
  * on the notion of M-nearest neighbours between the input points,
  * for some M>=1.
  */
-class NNBasedIndex : public ClusterValidityIndex
+template<class Label>
+class NNBasedIndex : public LabelledIndex<Label>
 {
 protected:
+    CVI_LABELLED_INDEX_MEMBERS(LabelledIndex<Label>)
+
     const size_t M;       ///< number of nearest neighbours
-    matrix<FLOAT_T> dist; ///< dist(i, j) is the L2 distance between i and its j-th NN
-    matrix<size_t> ind;   ///< ind(i, j) is the index of the j-th NN of i
+    std::shared_ptr<const NNGraph> nn; ///< shared with other objects
+    const matrix<FLOAT_T>& dist; ///< dist(i, j) is the L2 distance between i and its j-th NN
+    const matrix<size_t>& ind;   ///< ind(i, j) is the index of the j-th NN of i
 
 public:
     // Described in the base class
     NNBasedIndex(
-            const matrix<FLOAT_T>& _X,
-            const uint8_t _K,
+            const DatasetPtr& _data,
+            const size_t _K,
             const bool _allow_undo,
-            const size_t _M)
-        : ClusterValidityIndex(_X, _K, _allow_undo),
+            const size_t _M,
+            const int _metric=CVI_METRIC_EUCLIDEAN,
+            const int _distance_storage=CVI_DISTANCE_DOUBLE)
+        : LabelledIndex<Label>(_data, _K, _allow_undo,
+            _metric, _distance_storage),
           M((_M<=n-1)?_M:(n-1)),
-          dist(n, M, INFTY),
-          ind(n, M, n)
+          nn(data->get_nn(M, metric)),
+          dist(nn->dist),
+          ind(nn->ind)
     {
         CVI_ASSERT(M>0 && M<n);
-
-        for (size_t i=0; i<n-1; ++i) {
-            for (size_t j=i+1; j<n; ++j) {
-                FLOAT_T dij = sqrt(distance_l2_squared(X.row(i), X.row(j), d));
-
-                if (dij < dist(i, M-1)) {
-                    // j may be amongst M NNs of i
-                    size_t l = M-1;
-                    while (l > 0 && dij < dist(i, l-1)) {
-                        dist(i, l) = dist(i, l-1);
-                        ind(i, l)  = ind(i, l-1);
-                        l--;
-                    }
-                    dist(i, l) = dij;
-                    ind(i, l)  = j;
-                }
-
-                if (dij < dist(j, M-1)) {
-                    // i may be amongst M NNs of j
-                    size_t l = M-1;
-                    while (l > 0 && dij < dist(j, l-1)) {
-                        dist(j, l) = dist(j, l-1);
-                        ind(j, l)  = ind(j, l-1);
-                        l--;
-                    }
-                    dist(j, l) = dij;
-                    ind(j, l)  = i;
-                }
-            }
-        }
     }
 
 };
@@ -32,72 +32,99 @@
  *  Communications in Statistics, 3(1), 1974, pp. 1-27,
  *  doi:10.1080/03610927408827101.
  */
-class CalinskiHarabaszIndex : public CentroidsBasedIndex
+template<class Label>
+class CalinskiHarabaszIndex : public CentroidsBasedIndex<Label>
 {
 protected:
-    std::vector<FLOAT_T> centroid; ///< the centroid of the whole X, size d
+    CVI_LABELLED_INDEX_MEMBERS(CentroidsBasedIndex<Label>)
+    using CentroidsBasedIndex<Label>::centroids;
+    using CentroidsBasedIndex<Label>::move_centroids;
+    using CentroidsBasedIndex<Label>::swap_centroids;
+
+    const std::vector<FLOAT_T>& centroid; ///< the centroid of the whole X, size d
     FLOAT_T numerator;             ///< sum of intra-cluster squared L2 distances
     FLOAT_T denominator;           ///< sum of within-cluster squared L2 distances
 
-    FLOAT_T last_numerator;        ///< for undo()
-    FLOAT_T last_denominator;      ///< for undo()
+    std::vector< std::pair<FLOAT_T, FLOAT_T> > last_sums; ///< (numerator, denominator) for undo()
 
-public:
-    // Described in the base class
-    CalinskiHarabaszIndex(
-           const matrix<FLOAT_T>& _X,
-           const uint8_t _K,
-           const bool _allow_undo=false)
-        : CentroidsBasedIndex(_X, _K, _allow_undo),
-          centroid(d, 0.0)
+
+    /** Computes the sum of intra-cluster squared L2 distances
+     *  based on the current centroids
+     */
+    FLOAT_T compute_numerator() const
     {
-        // centroid[i,j] == 0.0 already
+        FLOAT_T ret = 0.0;
+        for (size_t i=0; i<K; ++i) {
+            for (size_t j=0; j<d; ++j) {
+                ret += square(centroid[j]-centroids(i,j))*count[i];
+            }
+        }
+        return ret;
+    }
 
-        // compute the centroid of the whole dataset
+
+    /** Computes the sum of within-cluster squared L2 distances
+     *  for a given partition (CentroidsView<Label> or MovedCentroidsView)
+     */
+    template<class Partition>
+    FLOAT_T compute_denominator(const Partition& P) const
+    {
+        FLOAT_T ret = 0.0;
         for (size_t i=0; i<n; ++i) {
+            const FLOAT_T* c = P.centroid(P.label(i));
             for (size_t j=0; j<d; ++j) {
-                centroid[j] += X(i, j);
+                ret += square(c[j]-X(i,j));
             }
         }
-        for (size_t j=0; j<d; ++j) {
-            centroid[j] /= (FLOAT_T)n;
-        }
+        return ret;
+    }
+
+public:
+    // Described in the base class
+    CalinskiHarabaszIndex(
+           const DatasetPtr& _data,
+           const size_t _K,
+           const bool _allow_undo=false,
+           const int _metric=CVI_METRIC_EUCLIDEAN,
+           const int _distance_storage=CVI_DISTANCE_DOUBLE)
+        : CentroidsBasedIndex<Label>(_data, _K, _allow_undo,
+            _metric, _distance_storage),
+          centroid(data->get_column_means())
+    {
+        ;
+    }
+
+
+    // Described in the base class
+    virtual ClusterValidityIndex* clone() const
+    {
+        return new CalinskiHarabaszIndex(*this);
     }
 
 
     // Described in the base class
-    virtual void set_labels(const std::vector<uint8_t>& _L)
+    virtual void set_labels(const std::vector<Label>& _L)
     {
-        CentroidsBasedIndex::set_labels(_L); // sets L, count and centroids
+        CentroidsBasedIndex<Label>::set_labels(_L); // sets L, count and centroids
 
         // sum of intra-cluster squared L2 distances
-        numerator = 0.0;
-        for (size_t i=0; i<K; ++i) {
-            for (size_t j=0; j<d; ++j) {
-                numerator += square(centroid[j]-centroids(i,j))*count[i];
-            }
-        }
+        numerator = compute_numerator();
 
         // sum of within-cluster squared L2 distances
-        denominator = 0.0;
-        for (size_t i=0; i<n; ++i) {
-            for (size_t j=0; j<d; ++j) {
-                denominator += square(centroids(L[i],j)-X(i,j));
-            }
-        }
+        denominator = compute_denominator(CentroidsView<Label>(L, count, centroids));
     }
 
 
     // Described in the base class
-    virtual void modify(size_t i, uint8_t j)
+    virtual void modify(size_t i, size_t j)
     {
-        uint8_t tmp = L[i];
+        Label tmp = L[i];
         // tmp = old label for the i-th point
         // j   = new label for the i-th point
 
         if (allow_undo) {
-            last_numerator = numerator;
-            last_denominator = denominator;
+            if (!in_transaction()) last_sums.clear();
+            last_sums.push_back(std::pair<FLOAT_T, FLOAT_T>(numerator, denominator));
         }
 
         for (size_t k=0; k<d; ++k) {
@@ -107,7 +134,7 @@ public:
 
 
         // sets L[i]=j and updates count as well as centroids
-        CentroidsBasedIndex::modify(i, j);
+        CentroidsBasedIndex<Label>::modify(i, j);
 
 
         for (size_t k=0; k<d; ++k) {
@@ -122,11 +149,115 @@ public:
         // of those two clusters -- for small K (which we assume here)
         // it'll be more efficient to actually compute the denominator from
         // scratch
-        denominator = 0.0;
+        denominator = compute_denominator(CentroidsView<Label>(L, count, centroids));
+    }
+
+
+    // Described in the base class
+    virtual void swap(size_t i, size_t k)
+    {
+        Label a = L[i], b = L[k];
+
+        if (allow_undo) {
+            if (!in_transaction()) last_sums.clear();
+            last_sums.push_back(std::pair<FLOAT_T, FLOAT_T>(numerator, denominator));
+        }
+
+        // the cluster sizes do not change, only the two centroids do
+        for (size_t u=0; u<d; ++u) {
+            numerator -= square(centroid[u]-centroids(a,u))*count[a];
+            numerator -= square(centroid[u]-centroids(b,u))*count[b];
+        }
+
+        // exchanges L[i] and L[k] and updates the centroids
+        CentroidsBasedIndex<Label>::swap(i, k);
+
+        for (size_t u=0; u<d; ++u) {
+            numerator += square(centroid[u]-centroids(a,u))*count[a];
+            numerator += square(centroid[u]-centroids(b,u))*count[b];
+        }
+
+        denominator = compute_denominator(CentroidsView<Label>(L, count, centroids));
+    }
+
+
+    // Described in the base class
+    virtual void modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels)
+    {
+        check_many(idx, labels);
+
+        if (allow_undo) {
+            if (!in_transaction()) last_sums.clear();
+            last_sums.push_back(std::pair<FLOAT_T, FLOAT_T>(numerator, denominator));
+        }
+
+        // sets L and count, updates the affected centroids
+        CentroidsBasedIndex<Label>::modify_many(idx, labels);
+
+        numerator = compute_numerator();
+        denominator = compute_denominator(CentroidsView<Label>(L, count, centroids));
+    }
+
+
+    // Described in the base class
+    virtual FLOAT_T score_move(size_t i, size_t j) const
+    {
+        MovedCentroidsView<Label> P(X, L, count, centroids, i, j);
+
+        // the same as in modify()
+        FLOAT_T num = numerator;
+        for (size_t k=0; k<d; ++k) {
+            num -= square(centroid[k]-centroids(P.to,k))*count[P.to];
+            num -= square(centroid[k]-centroids(P.from,k))*count[P.from];
+        }
+
+        for (size_t k=0; k<d; ++k) {
+            num += square(centroid[k]-P.c_to[k])*P.size(P.to);
+            num += square(centroid[k]-P.c_from[k])*P.size(P.from);
+        }
+
+        return num*FLOAT_T(n-K)/(compute_denominator(P)*FLOAT_T(K-1.0));
+    }
+
+
+    // Described in the base class
+    virtual void score_all_moves(matrix<FLOAT_T>& res) const
+    {
+        CVI_ASSERT(res.nrow() == n && res.ncol() == K);
+
+        // moving the i-th point from the a-th to the j-th cluster changes
+        // the within-cluster sum of squares by
+        // count[j]/(count[j]+1)*||X(i,:)-centroids(j,:)||^2 -
+        // count[a]/(count[a]-1)*||X(i,:)-centroids(a,:)||^2;
+        // the total sum of squares, numerator+denominator, stays the same
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(static) num_threads(cvi_get_num_threads())
+        #endif
         for (size_t i=0; i<n; ++i) {
-            for (size_t j=0; j<d; ++j) {
-                denominator += square(centroids(L[i],j)-X(i,j));
+            Label a = L[i];
+            for (size_t j=0; j<K; ++j) {
+                FLOAT_T e = 0.0;
+                for (size_t u=0; u<d; ++u)
+                    e += square(centroids(j,u)-X(i,u));
+                res(i, j) = e;  // temporarily
+            }
+
+            if (count[a] <= 1) {
+                for (size_t j=0; j<K; ++j)
+                    res(i, j) = std::numeric_limits<FLOAT_T>::quiet_NaN();
+                continue;
+            }
+
+            FLOAT_T gain_a = res(i, a)*count[a]/(count[a]-1.0);
+            for (size_t j=0; j<K; ++j) {
+                if (j == a) continue;
+                FLOAT_T delta = res(i, j)*count[j]/(count[j]+1.0)-gain_a;
+                FLOAT_T num = numerator-delta;
+                FLOAT_T den = denominator+delta;
+                res(i, j) = num*FLOAT_T(n-K)/(den*FLOAT_T(K-1.0));
             }
+            res(i, a) = std::numeric_limits<FLOAT_T>::quiet_NaN();
         }
     }
 
@@ -141,9 +272,12 @@ public:
     // Described in the base class
     virtual void undo()
     {
-        numerator = last_numerator;
-        denominator = last_denominator;
-        CentroidsBasedIndex::undo();
+        CVI_ASSERT(can_undo());
+        CVI_ASSERT(!last_sums.empty());
+        numerator = last_sums.back().first;
+        denominator = last_sums.back().second;
+        last_sums.pop_back();
+        CentroidsBasedIndex<Label>::undo();
     }
 
 };
@@ -35,75 +35,100 @@
  *  IEEE Transactions on Pattern Analysis and Machine Intelligence. PAMI-1 (2),
  *  1979, pp. 224-227, doi:10.1109/TPAMI.1979.4766909
  */
-class DaviesBouldinIndex : public CentroidsBasedIndex
+template<class Label>
+class DaviesBouldinIndex : public CentroidsBasedIndex<Label>
 {
 protected:
+    CVI_LABELLED_INDEX_MEMBERS(CentroidsBasedIndex<Label>)
+    using CentroidsBasedIndex<Label>::centroids;
+    using CentroidsBasedIndex<Label>::move_centroids;
+    using CentroidsBasedIndex<Label>::swap_centroids;
+
     std::vector<FLOAT_T> R; ///< average distance between
                             ///< cluster centroids and their members
 
 public:
     // Described in the base class
     DaviesBouldinIndex(
-           const matrix<FLOAT_T>& _X,
-           const uint8_t _K,
-           const bool _allow_undo=false)
-        : CentroidsBasedIndex(_X, _K, _allow_undo),
+           const DatasetPtr& _data,
+           const size_t _K,
+           const bool _allow_undo=false,
+           const int _metric=CVI_METRIC_EUCLIDEAN,
+           const int _distance_storage=CVI_DISTANCE_DOUBLE)
+        : CentroidsBasedIndex<Label>(_data, _K, _allow_undo,
+            _metric, _distance_storage),
           R(_K)
     {
 
     }
 
+
+    // Described in the base class
+    virtual ClusterValidityIndex* clone() const
+    {
+        return new DaviesBouldinIndex(*this);
+    }
+
 //     // Described in the base class
-//     virtual void set_labels(const std::vector<uint8_t>& _L)
+//     virtual void set_labels(const std::vector<Label>& _L)
 //     {
-//         CentroidsBasedIndex::set_labels(_L); // sets L, count and centroids
+//         CentroidsBasedIndex<Label>::set_labels(_L); // sets L, count and centroids
 //     }
 
 
 //     // Described in the base class
-//     virtual void modify(size_t i, uint8_t j)
+//     virtual void modify(size_t i, size_t j)
 //     {
 //         // sets L[i]=j and updates count as well as centroids
-//         CentroidsBasedIndex::modify(i, j);
+//         CentroidsBasedIndex<Label>::modify(i, j);
 //     }
 
 
 //     // Described in the base class
 //     virtual void undo() {
-//         CentroidsBasedIndex::undo();
+//         CentroidsBasedIndex<Label>::undo();
 //     }
 
 
-    // Described in the base class
-    virtual FLOAT_T compute()
+    /** Computes the index for a given partition
+     *  (CentroidsView<Label> or MovedCentroidsView)
+     *
+     * @param P partition
+     * @param R [out] auxiliary buffer of size K
+     */
+    template<class Partition>
+    FLOAT_T compute_for(const Partition& P, FLOAT_T* R) const
     {
         // Compute the average distances between the cluster centroids
         // and their members.
-        // The centroids are up-to-date.
         for (size_t i=0; i<K; ++i) {
-            if (count[i] <= 1)  // singletons not permitted
+            if (P.size(i) <= 1)  // singletons not permitted
                 return -INFTY;  // negative!!
             R[i] = 0.0;
         }
         for (size_t i=0; i<n; ++i) {
+            Label k = P.label(i);
+            const FLOAT_T* c = P.centroid(k);
             FLOAT_T dist = 0.0;
             for (size_t u=0; u<d; ++u) {
-                dist += square(centroids(L[i],u)-X(i,u));
+                dist += square(c[u]-X(i,u));
             }
-            R[L[i]] += sqrt(dist);
+            R[k] += sqrt(dist);
         }
-        for (size_t i=0; i<K; ++i) R[i] /= (FLOAT_T)count[i];
+        for (size_t i=0; i<K; ++i) R[i] /= (FLOAT_T)P.size(i);
 
         FLOAT_T ret = 0.0;
         for (size_t i=0; i<K; ++i) {
+            const FLOAT_T* c_i = P.centroid(i);
             FLOAT_T max_r = 0.0;
             for (size_t j=0; j<K; ++j) {
                 if (j == i) continue;
 
                 // compute the distance between the i-th and the j-th centroid:
+                const FLOAT_T* c_j = P.centroid(j);
                 FLOAT_T cur_d = 0.0;
                 for (size_t u=0; u<d; ++u)
-                    cur_d += square(centroids(i,u)-centroids(j,u));
+                    cur_d += square(c_i[u]-c_j[u]);
                 cur_d = sqrt(cur_d);
 
                 FLOAT_T cur_r = (R[i]+R[j])/cur_d;
@@ -117,6 +142,153 @@ public:
         return ret;
     }
 
+
+    // Described in the base class
+    virtual FLOAT_T compute()
+    {
+        // The centroids are up-to-date.
+        return compute_for(CentroidsView<Label>(L, count, centroids), R.data());
+    }
+
+
+    // Described in the base class
+    virtual FLOAT_T score_move(size_t i, size_t j) const
+    {
+        std::vector<FLOAT_T> R_moved(K);
+        return compute_for(MovedCentroidsView<Label>(X, L, count, centroids, i, j),
+            R_moved.data());
+    }
+
+
+    // Described in the base class
+    virtual void score_all_moves(matrix<FLOAT_T>& res) const
+    {
+        CVI_ASSERT(res.nrow() == n && res.ncol() == K);
+
+        // only the centroids, the average distances and the distances between
+        // the centroids related to the two clusters involved change;
+        // those of the cluster the point is moved from are shared
+        // by all the moves of that point
+        std::vector< std::vector<size_t> > members(K);
+        for (size_t i=0; i<n; ++i)
+            members[L[i]].push_back(i);
+
+        size_t num_singletons = 0;
+        for (size_t k=0; k<K; ++k)
+            if (count[k] <= 1) num_singletons++;
+
+        std::vector<FLOAT_T> R0(K, 0.0);
+        for (size_t i=0; i<n; ++i) {
+            FLOAT_T dist = 0.0;
+            for (size_t u=0; u<d; ++u)
+                dist += square(centroids(L[i],u)-X(i,u));
+            R0[L[i]] += sqrt(dist);
+        }
+        for (size_t k=0; k<K; ++k) R0[k] /= (FLOAT_T)count[k];
+
+        matrix<FLOAT_T> M0(K, K);  // distances between the centroids
+        for (size_t k=0; k<K; ++k) {
+            for (size_t l=k+1; l<K; ++l) {
+                FLOAT_T cur_d = 0.0;
+                for (size_t u=0; u<d; ++u)
+                    cur_d += square(centroids(k,u)-centroids(l,u));
+                M0(k, l) = M0(l, k) = sqrt(cur_d);
+            }
+        }
+
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic, 16) num_threads(cvi_get_num_threads())
+        #endif
+        for (size_t i=0; i<n; ++i) {
+            Label a = L[i];
+            for (size_t j=0; j<K; ++j)
+                res(i, j) = std::numeric_limits<FLOAT_T>::quiet_NaN();
+            if (count[a] <= 1) continue;
+
+            if (count[a] <= 2) {  // a singleton would be created
+                for (size_t j=0; j<K; ++j)
+                    if (j != a) res(i, j) = -INFTY;
+                continue;
+            }
+
+            std::vector<FLOAT_T> c_a(d), c_j(d), R_moved(K), M_a(K), M_j(K);
+            for (size_t u=0; u<d; ++u)
+                c_a[u] = (centroids(a,u)*count[a]-X(i,u))/(count[a]-1.0);
+
+            FLOAT_T R_a = 0.0;
+            for (size_t v : members[a]) {
+                if (v == i) continue;
+                FLOAT_T dist = 0.0;
+                for (size_t u=0; u<d; ++u)
+                    dist += square(c_a[u]-X(v,u));
+                R_a += sqrt(dist);
+            }
+            R_a /= (FLOAT_T)(count[a]-1);
+
+            for (size_t l=0; l<K; ++l) {
+                FLOAT_T cur_d = 0.0;
+                for (size_t u=0; u<d; ++u)
+                    cur_d += square(c_a[u]-centroids(l,u));
+                M_a[l] = sqrt(cur_d);
+            }
+
+            for (size_t j=0; j<K; ++j) {
+                if (j == a) continue;
+
+                if (num_singletons-(count[j] <= 1) > 0) {
+                    res(i, j) = -INFTY;
+                    continue;
+                }
+
+                for (size_t u=0; u<d; ++u)
+                    c_j[u] = (centroids(j,u)*count[j]+X(i,u))/(count[j]+1.0);
+
+                FLOAT_T R_j = 0.0;
+                for (size_t v : members[j]) {
+                    FLOAT_T dist = 0.0;
+                    for (size_t u=0; u<d; ++u)
+                        dist += square(c_j[u]-X(v,u));
+                    R_j += sqrt(dist);
+                }
+                FLOAT_T dist = 0.0;
+                for (size_t u=0; u<d; ++u)
+                    dist += square(c_j[u]-X(i,u));
+                R_j = (R_j+sqrt(dist))/(FLOAT_T)(count[j]+1);
+
+                for (size_t l=0; l<K; ++l) {
+                    FLOAT_T cur_d = 0.0;
+                    for (size_t u=0; u<d; ++u)
+                        cur_d += square(c_j[u]-((l == a)?c_a[u]:centroids(l,u)));
+                    M_j[l] = sqrt(cur_d);
+                }
+
+                for (size_t k=0; k<K; ++k)
+                    R_moved[k] = (k == a)?R_a:((k == j)?R_j:R0[k]);
+
+                FLOAT_T ret = 0.0;
+                for (size_t k=0; k<K; ++k) {
+                    FLOAT_T max_r = 0.0;
+                    for (size_t l=0; l<K; ++l) {
+                        if (l == k) continue;
+
+                        FLOAT_T cur_d;
+                        if (k == j)      cur_d = M_j[l];
+                        else if (l == j) cur_d = M_j[k];
+                        else if (k == a) cur_d = M_a[l];
+                        else if (l == a) cur_d = M_a[k];
+                        else             cur_d = M0(k, l);
+
+                        FLOAT_T cur_r = (R_moved[k]+R_moved[l])/cur_d;
+                        if (cur_r > max_r)
+                            max_r = cur_r;
+                    }
+                    ret += max_r;
+                }
+                res(i, j) = -ret/(FLOAT_T)K; // negative!!
+            }
+        }
+    }
+
 };
 
 
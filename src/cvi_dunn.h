@@ -21,6 +21,114 @@
 
 
 
+/** Maximal number of pairs stored by ExtremalPairs
+ */
+#define CVI_DUNN_EXTREMAL_PAIRS 8
+
+
+/** Keeps track of (at most) CVI_DUNN_EXTREMAL_PAIRS pairs of points
+ *  with the smallest (Largest=false) or the largest (Largest=true)
+ *  distances amongst the pairs in some set (e.g., the pairs of points
+ *  in the same cluster), ordered from the best one.
+ *
+ *  Unless all the pairs in the set are stored (complete), the ones not
+ *  stored are no better than the stored ones.  Hence, the best pair
+ *  remains known after the pairs involving some points are removed,
+ *  unless all the stored ones are; only then the set must be rescanned.
+ */
+template<bool Largest>
+struct ExtremalPairs
+{
+    DistTriple top[CVI_DUNN_EXTREMAL_PAIRS];
+    size_t size;
+    bool complete;  ///< are all the pairs in the set stored?
+
+    ExtremalPairs() : size(0), complete(true) { }
+
+    static bool better(const DistTriple& p, const DistTriple& q)
+    {
+        return (Largest)?(q < p):(p < q);
+    }
+
+    /** The value reported for an empty set */
+    static FLOAT_T empty() { return (Largest)?0.0:INFTY; }
+
+    /** The set is empty */
+    void reset()
+    {
+        size = 0;
+        complete = true;
+    }
+
+    /** Is the best pair known (i.e., there is no need for a rescan)? */
+    bool is_valid() const { return size > 0 || complete; }
+
+    /** Gives the best distance (the empty set's one if there are no pairs) */
+    FLOAT_T best() const
+    {
+        CVI_ASSERT(is_valid());
+        return (size > 0)?top[0].d:empty();
+    }
+
+    /** Determines the best distance amongst the pairs not involving
+     *  the i-th point
+     *
+     * @param i
+     * @param d [out]
+     * @return false if it is not known
+     */
+    bool best_except(size_t i, FLOAT_T& d) const
+    {
+        for (size_t t=0; t<size; ++t) {
+            if (top[t].i1 != i && top[t].i2 != i) {
+                d = top[t].d;
+                return true;
+            }
+        }
+        d = empty();
+        return complete;
+    }
+
+    /** Takes into account a pair added to the set
+     */
+    void add(const DistTriple& p)
+    {
+        if (!complete && (size == 0 || !better(p, top[size-1])))
+            return;  // not amongst the best ones (or to be rescanned)
+
+        if (size == CVI_DUNN_EXTREMAL_PAIRS) {
+            complete = false;
+            if (!better(p, top[size-1])) return;
+            --size;  // drop the worst one
+        }
+
+        size_t t = size++;
+        while (t > 0 && better(p, top[t-1])) {
+            top[t] = top[t-1];
+            --t;
+        }
+        top[t] = p;
+    }
+
+    /** Removes the pairs involving the marked points from the set
+     *
+     * @param moved
+     * @return is_valid()
+     */
+    bool remove(const std::vector<bool>& moved)
+    {
+        size_t k = 0;
+        for (size_t t=0; t<size; ++t) {
+            if (!moved[top[t].i1] && !moved[top[t].i2])
+                top[k++] = top[t];
+        }
+        size = k;
+        return is_valid();
+    }
+};
+
+
+
 /** Dunn's index for measuring the degree to which clusters are
  *  compact and well-separated
  *
@@ -28,166 +136,314 @@
  *
  *  TODO: formula
  *
- *  TODO: time, memory complexity as a function of n, K
+ *  The smallest distance between two clusters is attained at an edge
+ *  of the dataset's minimum spanning tree (see Dataset::get_mst()),
+ *  hence only the MST edges joining different clusters need to be kept
+ *  track of (see CrossLabelEdges).
+ *
+ *  For each cluster, the pairs of points with the largest distances
+ *  are kept track of (see ExtremalPairs).  Moving a point requires
+ *  inspecting its distances to the members of its new cluster
+ *  and O(K) operations on the lists.  Only when all the stored pairs
+ *  of some cluster are removed, its diameter is determined anew;
+ *  see get_num_rescans().
  *
  *  J.C. Dunn, A fuzzy relative of the ISODATA process and its use in detecting
  *  Compact Well-Separated Clusters, Journal of Cybernetics 3(3), 1974,
  *  pp. 32-57, doi:10.1080/01969727308546046.
  */
-class DunnIndex : public ClusterValidityIndex
+template<class Label>
+class DunnIndex : public LabelledIndex<Label>
 {
 protected:
-    matrix<DistTriple> dist; /**< intra-cluster distances:
-        dist(i,j) = min( d(X(u,), X(v,)) ), X(u,) in C_i, X(v,) in C_j  (i!=j)
+    CVI_LABELLED_INDEX_MEMBERS(LabelledIndex<Label>)
+
+    CrossLabelEdges<Label> cross; /**< intra-cluster distances:
+        cross.get_min() = min( d(X(u,), X(v,)) ), X(u,) in C_i, X(v,) in C_j,
+        over all i!=j
         */
-    std::vector<DistTriple> diam; /**< cluster diameters:
-        diam[i] = max( d(X(u,), X(v,)) ), X(u,), X(v,) in C_i
+    std::vector< ExtremalPairs<true> > diam; /**< cluster diameters:
+        diam[i] gives the pairs with the largest d(X(u,), X(v,)),
+        X(u,), X(v,) in C_i
         */
     EuclideanDistance D; ///< squared Euclidean
 
+    mutable size_t num_rescans; ///< see get_num_rescans()
+
 
-    matrix<DistTriple> last_dist;      ///< for undo()
-    std::vector<DistTriple> last_diam; ///< for undo()
-    bool last_chg; ///< for undo() (were dist&diam changed at all?)
+    UndoJournal< ExtremalPairs<true> > last_diam;  ///< changes to diam, for undo()
 
 
-    void recompute_dist_diam()
+    /** Removes the pairs involving the marked points from the a-th
+     *  cluster's list; marks it in rebuild if it is no longer valid
+     */
+    void remove_pairs(size_t a, const std::vector<bool>& moved,
+        std::vector<bool>& rebuild)
     {
-        for (size_t i=0; i<K; ++i) {
-            diam[i] = DistTriple(0, 0, 0.0);
-            //dist(i, i) = 0.0;
-            for (size_t j=i+1; j<K; ++j) {
-                dist(i,j) = dist(j,i) = DistTriple(0, 0, INFTY);
-            }
+        if (!diam[a].remove(moved))
+            rebuild[a] = true;
+    }
+
+
+    /** Takes into account the distances between the i-th point
+     *  (which has just changed its label) and the other members of its cluster
+     *  (except for the marked ones with indexes smaller than i)
+     */
+    void add_pairs(size_t i, const std::vector<bool>& moved)
+    {
+        Label l_i = L[i];
+        for (size_t u=0; u<n; ++u) {
+            if (u == i || L[u] != l_i || (moved[u] && u < i))
+                continue;  // each pair is considered only once
+            diam[l_i].add(DistTriple(i, u, D(i, u)));
         }
+    }
 
-        for (size_t i=0; i<n-1; ++i) {
-            for (size_t j=i+1; j<n; ++j) {
-                double d = D(i, j);
-                if (L[i] == L[j]) {
-                    if (d > diam[L[i]].d)
-                        diam[L[i]] = DistTriple(i, j, d);
-                }
-                else {
-                    if (d < dist(L[i], L[j]).d)
-                        dist(L[i], L[j]) = dist(L[j], L[i]) = DistTriple(i, j, d);
-                }
+
+    /** Rebuilds the lists of the clusters marked in rebuild
+     *  based on the distances between their members
+     *
+     * @return whether any list has been rebuilt
+     */
+    bool rebuild_pairs(const std::vector<bool>& rebuild)
+    {
+        std::vector< std::vector<size_t> > members(K);
+        bool any = false;
+        for (size_t i=0; i<n; ++i) {
+            if (rebuild[L[i]]) members[L[i]].push_back(i);
+        }
+
+        for (size_t a=0; a<K; ++a) {
+            if (!rebuild[a]) continue;
+            diam[a].reset();
+            any = true;
+
+            const std::vector<size_t>& m = members[a];
+            for (size_t u=0; u+1<m.size(); ++u) {
+                for (size_t v=u+1; v<m.size(); ++v)
+                    diam[a].add(DistTriple(m[u], m[v], D(m[u], m[v])));
             }
         }
+        return any;
+    }
+
+
+    /** Computes the index based on the given smallest intra-cluster
+     *  distance and the cluster diameters
+     */
+    FLOAT_T compute_for(FLOAT_T min_dist, const std::vector<FLOAT_T>& diam) const
+    {
+        FLOAT_T max_diam = 0.0;
+        for (size_t i=0; i<K; ++i) {
+            if (diam[i] > max_diam)
+                max_diam = diam[i];
+        }
+
+        return sqrt(min_dist/max_diam);
     }
 
 
 public:
     // Described in the base class
     DunnIndex(
-           const matrix<FLOAT_T>& _X,
-           const uint8_t _K,
-           const bool _allow_undo=false)
-        : ClusterValidityIndex(_X, _K, _allow_undo),
-          dist(K, K),
+           const DatasetPtr& _data,
+           const size_t _K,
+           const bool _allow_undo=false,
+           const int _metric=CVI_METRIC_EUCLIDEAN,
+           const int _distance_storage=CVI_DISTANCE_DOUBLE)
+        : LabelledIndex<Label>(_data, _K, _allow_undo,
+            _metric, _distance_storage),
+          cross(data->get_mst(metric, distance_storage)),
           diam(K),
-          D(&X, n<=CVI_MAX_N_PRECOMPUTE_DISTANCE, true/*squared*/),
-          last_dist(K, K),
-          last_diam(K)
+          D(data->get_distance(true/*squared*/, metric, distance_storage)),
+          num_rescans(0)
     {
 
     }
 
 
+    // Described in the base class
+    virtual ClusterValidityIndex* clone() const
+    {
+        DunnIndex* ret = new DunnIndex(*this);
+        ret->D = D.clone();  // own row cache (if used)
+        return ret;
+    }
 
 
     // Described in the base class
-    virtual void set_labels(const std::vector<uint8_t>& _L)
+    virtual const EuclideanDistance* get_distance() const { return &D; }
+
+
+    /** Returns the number of times some cluster's diameter had to be
+     *  determined anew because all its stored extremal pairs
+     *  were invalidated by modify(), swap(), modify_many() or score_move();
+     *  set_labels() does not count
+     */
+    size_t get_num_rescans() const { return num_rescans; }
+
+
+    // Described in the base class
+    virtual void set_labels(const std::vector<Label>& _L)
     {
-        ClusterValidityIndex::set_labels(_L); // sets L, count and centroids
+        LabelledIndex<Label>::set_labels(_L); // sets L, count and centroids
 
-        recompute_dist_diam();
+        cross.recompute(L);
+        rebuild_pairs(std::vector<bool>(K, true));
     }
 
 
     // Described in the base class
-    virtual void modify(size_t i, uint8_t j)
+    virtual void modify(size_t i, size_t j)
     {
-//         uint8_t tmp = j;
+        Label a = L[i];
 
-        bool needs_recompute = false;
-        for (size_t u=0; u<K; ++u) {
-            last_diam[u] = diam[u];
+        if (allow_undo) {
+            cross.open(in_transaction());
+            last_diam.open(in_transaction());
+        }
+        last_diam.log(diam, a);
+        last_diam.log(diam, j);
 
-            // if the point being modified determines its cluster's diameter:
-            if (diam[u].i1 == i || diam[u].i2 == i)
-                needs_recompute = true;
+        std::vector<bool> moved(n, false);
+        moved[i] = true;
+        std::vector<bool> rebuild(K, false);
+        remove_pairs(a, moved, rebuild);
 
-            for (size_t v=u+1; v<K; ++v) {
-                // if the point being modified determines intra-cluster distance:
-                if (dist(u,v).i1 == i || dist(u,v).i2 == i)
-                    needs_recompute = true;
+        // sets L[i]=j and updates count
+        LabelledIndex<Label>::modify(i, j);
 
-                last_dist(u,v) = last_dist(v,u) = dist(u,v);
-            }
+        cross.update(i, L);
+        add_pairs(i, moved);
+        if (rebuild_pairs(rebuild)) ++num_rescans;
+    }
+
+
+    // Described in the base class
+    virtual void swap(size_t i, size_t k)
+    {
+        Label a = L[i], b = L[k];
+
+        if (allow_undo) {
+            cross.open(in_transaction());
+            last_diam.open(in_transaction());
         }
+        last_diam.log(diam, a);
+        last_diam.log(diam, b);
+
+        std::vector<bool> moved(n, false);
+        moved[i] = moved[k] = true;
+        std::vector<bool> rebuild(K, false);
+        remove_pairs(a, moved, rebuild);
+        remove_pairs(b, moved, rebuild);
+
+        // exchanges L[i] and L[k]
+        LabelledIndex<Label>::swap(i, k);
+
+        cross.update(i, L);
+        cross.update(k, L);
+        add_pairs(i, moved);
+        add_pairs(k, moved);
+        if (rebuild_pairs(rebuild)) ++num_rescans;
+    }
 
-        // sets L[i]=j and updates count
-        ClusterValidityIndex::modify(i, j);
-
-        if (needs_recompute) {
-            last_chg = true;
-            recompute_dist_diam();
-        }
-        else {
-            last_chg = false;
-            for (size_t u=0; u<n; ++u) {
-                if (i == u) continue;
-
-                double d = D(i, u);
-                if (L[i] == L[u]) {
-                    if (d > diam[L[i]].d) {
-                        diam[L[i]] = DistTriple(i, u, d);
-                        last_chg = true;
-                    }
-                }
-                else {
-                    if (d < dist(L[i], L[u]).d) {
-                        dist(L[i], L[u]) = dist(L[u], L[i]) = DistTriple(i, u, d);
-                        last_chg = true;
-                    }
-                }
-            }
+
+    // Described in the base class
+    virtual void modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels)
+    {
+        check_many(idx, labels);
+
+        std::vector<bool> moved(n, false);
+        std::vector<bool> affected(K, false);
+        std::vector<bool> losing(K, false);  // clusters that lose points
+        for (size_t t=0; t<idx.size(); ++t) {
+            moved[idx[t]] = true;
+            affected[L[idx[t]]] = affected[labels[t]] = true;
+            losing[L[idx[t]]] = true;
+        }
+
+        if (allow_undo) {
+            cross.open(in_transaction());
+            last_diam.open(in_transaction());
+        }
+        std::vector<bool> rebuild(K, false);
+        for (size_t a=0; a<K; ++a) {
+            if (affected[a]) last_diam.log(diam, a);
+            if (losing[a]) remove_pairs(a, moved, rebuild);
         }
+
+        // sets L and count
+        LabelledIndex<Label>::modify_many(idx, labels);
+
+        for (size_t t=0; t<idx.size(); ++t) {
+            cross.update(idx[t], L);
+            add_pairs(idx[t], moved);
+        }
+        if (rebuild_pairs(rebuild)) ++num_rescans;
     }
 
 
     // Described in the base class
     virtual void undo()
     {
-        if (last_chg) {
-            for (size_t i=0; i<K; ++i) {
-                diam[i] = last_diam[i];
-                for (size_t j=i+1; j<K; ++j) {
-                    dist(i,j) = dist(j,i) = last_dist(i,j);
-                }
-            }
-        }
+        CVI_ASSERT(can_undo());
+        cross.revert();
+        last_diam.revert(diam);
 
-        ClusterValidityIndex::undo();
+        LabelledIndex<Label>::undo();
     }
 
 
     // Described in the base class
     virtual FLOAT_T compute()
     {
-        FLOAT_T max_diam = 0.0;
-        FLOAT_T min_dist = INFTY;
-        for (size_t i=0; i<K; ++i) {
-            if (diam[i].d > max_diam)
-                max_diam = diam[i].d;
-            for (size_t j=i+1; j<K; ++j) {
-                if (dist(i, j).d < min_dist)
-                    min_dist = dist(i, j).d;
+        std::vector<FLOAT_T> cur_diam(K);
+        for (size_t u=0; u<K; ++u)
+            cur_diam[u] = diam[u].best();
+
+        return compute_for(cross.get_min(), cur_diam);
+    }
+
+
+    // Described in the base class
+    virtual FLOAT_T score_move(size_t i, size_t j) const
+    {
+        MovedPartitionView<Label> P(L, count, i, j);
+
+        // the best pairs not involving the point being moved, if known;
+        // only the list of the cluster it leaves, a = L[i], may contain it
+        std::vector<FLOAT_T> new_diam(K);
+        for (size_t u=0; u<K; ++u) {
+            if (diam[u].best_except(i, new_diam[u]))
+                continue;
+
+            // the same as in rebuild_pairs() (here, u == a)
+            std::vector<size_t> m;
+            for (size_t v=0; v<n; ++v) {
+                if (P.label(v) == u) m.push_back(v);
+            }
+            for (size_t v=0; v+1<m.size(); ++v) {
+                for (size_t w=v+1; w<m.size(); ++w) {
+                    FLOAT_T d = D(m[v], m[w]);
+                    if (d > new_diam[u]) new_diam[u] = d;
+                }
             }
+
+            #ifdef _OPENMP
+            #pragma omp atomic
+            #endif
+            ++num_rescans;
         }
 
-        return sqrt(min_dist/max_diam);
+        // the same as in modify()
+        for (size_t u=0; u<n; ++u) {
+            if (u == i || P.label(u) != j) continue;
+            FLOAT_T d = D(i, u);
+            if (d > new_diam[j]) new_diam[j] = d;
+        }
+
+        return compute_for(cross.get_min_moved(P), new_diam);
     }
 };
 
@@ -75,22 +75,39 @@ FLOAT_T dnorm(FLOAT_T x, FLOAT_T m, FLOAT_T s) {
  *  Compact Well-Separated Clusters, Journal of Cybernetics 3(3), 1974,
  *  pp. 32-57, doi:10.1080/01969727308546046.
  */
-class DuNNOWAIndex : public NNBasedIndex
+template<class Label>
+class DuNNOWAIndex : public NNBasedIndex<Label>
 {
 protected:
+    CVI_LABELLED_INDEX_MEMBERS(NNBasedIndex<Label>)
+    using NNBasedIndex<Label>::M;
+    using NNBasedIndex<Label>::nn;
+    using NNBasedIndex<Label>::dist;
+    using NNBasedIndex<Label>::ind;
+
     const int owa_numerator;
     const int owa_denominator;
-    std::vector<ssize_t> order;
+    std::shared_ptr< const std::vector<ssize_t> > order; ///< shared by the replicas
     std::vector<FLOAT_T> pq;  ///< for SMin and SMax - aux storage of size 3*delta
 
-    FLOAT_T aggregate(int owa, bool same_cluster)
+    /** Aggregates the distances to the near neighbours from the same
+     *  (same_cluster=true) or other clusters for a given partition
+     *  (PartitionView<Label> or MovedPartitionView)
+     *
+     * @param P partition
+     * @param owa OWA operator
+     * @param same_cluster
+     * @param pq auxiliary buffer of size 3*delta (for SMin and SMax)
+     */
+    template<class Partition>
+    FLOAT_T aggregate(const Partition& P, int owa, bool same_cluster, FLOAT_T* pq) const
     {
         if (owa == OWA_MEAN) {
             FLOAT_T ret = 0.0;
             size_t count = 0;
             for (ssize_t i=0; i<n; ++i) {
                 for (ssize_t j=0; j<M; ++j) {
-                    if ((bool)same_cluster == (bool)(L[i] == L[ind(i, j)])) {
+                    if ((bool)same_cluster == (bool)(P.label(i) == P.label(ind(i, j)))) {
                         ++count;
                         ret += dist(i, j);
                     }
@@ -112,9 +129,9 @@ protected:
 //             }
 //             return ret;
             for (ssize_t u=0; u<n*M; ++u) {
-                ssize_t i = order[u]/M;
-                ssize_t j = order[u]%M;
-                if ((bool)same_cluster == (bool)(L[i] == L[ind(i, j)])) {
+                ssize_t i = (*order)[u]/M;
+                ssize_t j = (*order)[u]%M;
+                if ((bool)same_cluster == (bool)(P.label(i) == P.label(ind(i, j)))) {
                     return dist(i, j);
                 }
             }
@@ -133,9 +150,9 @@ protected:
 //             }
 //            return ret;
             for (ssize_t u=n*M-1; u>=0; --u) { /* yep, a signed type */
-                ssize_t i = order[u]/M;
-                ssize_t j = order[u]%M;
-                if ((bool)same_cluster == (bool)(L[i] == L[ind(i, j)])) {
+                ssize_t i = (*order)[u]/M;
+                ssize_t j = (*order)[u]%M;
+                if ((bool)same_cluster == (bool)(P.label(i) == P.label(ind(i, j)))) {
                     return dist(i, j);
                 }
             }
@@ -148,9 +165,9 @@ protected:
             ssize_t delta = owa-OWA_SMIN_START;
             ssize_t pq_cur = 0;
             for (ssize_t u=0; u<n*M; ++u) {
-                ssize_t i = order[u]/M;
-                ssize_t j = order[u]%M;
-                if ((bool)same_cluster == (bool)(L[i] == L[ind(i, j)])) {
+                ssize_t i = (*order)[u]/M;
+                ssize_t j = (*order)[u]%M;
+                if ((bool)same_cluster == (bool)(P.label(i) == P.label(ind(i, j)))) {
                     pq[pq_cur++] = dist(i, j);
                     if (pq_cur == 3*delta) break;
                 }
@@ -168,9 +185,9 @@ protected:
             ssize_t delta = owa-OWA_SMAX_START;
             ssize_t pq_cur = 0;
              for (ssize_t u=n*M-1; u>=0; --u) { /* yep, a signed type */
-                ssize_t i = order[u]/M;
-                ssize_t j = order[u]%M;
-                if ((bool)same_cluster == (bool)(L[i] == L[ind(i, j)])) {
+                ssize_t i = (*order)[u]/M;
+                ssize_t j = (*order)[u]%M;
+                if ((bool)same_cluster == (bool)(P.label(i) == P.label(ind(i, j)))) {
                     pq[pq_cur++] = dist(i, j);
                     if (pq_cur == 3*delta) break;
                 }
@@ -194,17 +211,19 @@ protected:
 public:
     // Described in the base class
     DuNNOWAIndex(
-           const matrix<FLOAT_T>& _X,
-           const uint8_t _K,
+           const DatasetPtr& _data,
+           const size_t _K,
            const bool _allow_undo=false,
            const size_t _M=10,
            const int _owa_numerator=OWA_MIN,
-           const int _owa_denominator=OWA_MAX
+           const int _owa_denominator=OWA_MAX,
+           const int _metric=CVI_METRIC_EUCLIDEAN,
+           const int _distance_storage=CVI_DISTANCE_DOUBLE
              )
-        : NNBasedIndex(_X, _K, _allow_undo, _M),
+        : NNBasedIndex<Label>(_data, _K, _allow_undo, _M,
+            _metric, _distance_storage),
         owa_numerator(_owa_numerator),
-        owa_denominator(_owa_denominator),
-        order(n*M)
+        owa_denominator(_owa_denominator)
     {
 //         Rprintf("%d_%d_%d\n", M, owa_numerator, owa_denominator);
 
@@ -225,25 +244,52 @@ public:
 
 
 
-        Cargsort(order.data(), dist.data(), n*M);
+        std::shared_ptr< std::vector<ssize_t> > ord(new std::vector<ssize_t>(n*M));
+        Cargsort(ord->data(), dist.data(), n*M);
+        order = ord;
     }
 
 
-    virtual FLOAT_T compute()
+    // Described in the base class
+    virtual ClusterValidityIndex* clone() const
+    {
+        return new DuNNOWAIndex(*this);
+    }
+
+
+    /** Computes the index for a given partition
+     *  (PartitionView<Label> or MovedPartitionView)
+     */
+    template<class Partition>
+    FLOAT_T compute_for(const Partition& P, FLOAT_T* pq) const
     {
         for (size_t i=0; i<K; ++i)
-            if (count[i] <= M)
+            if (P.size(i) <= M)
                 return -INFTY;
 
-        FLOAT_T numerator = aggregate(owa_numerator, /*same_cluster*/false);
+        FLOAT_T numerator = aggregate(P, owa_numerator, /*same_cluster*/false, pq);
         if (!std::isfinite(numerator)) return INFTY;
 
-        FLOAT_T denominator = aggregate(owa_denominator, /*same_cluster*/true);
+        FLOAT_T denominator = aggregate(P, owa_denominator, /*same_cluster*/true, pq);
         if (!std::isfinite(denominator)) return -INFTY;
 
         return numerator/denominator;
     }
 
+
+    virtual FLOAT_T compute()
+    {
+        return compute_for(PartitionView<Label>(L, count), pq.data());
+    }
+
+
+    // Described in the base class
+    virtual FLOAT_T score_move(size_t i, size_t j) const
+    {
+        std::vector<FLOAT_T> pq_moved(pq.size());
+        return compute_for(MovedPartitionView<Label>(L, count, i, j), pq_moved.data());
+    }
+
 };
 
 
@@ -21,6 +21,58 @@
 
 
 
+/** Sorts a vector using cvi_get_num_threads() threads:
+ *  each thread sorts a contiguous chunk, and then the chunks
+ *  are merged pairwise.
+ *
+ *  T::operator< must define a strict total order so that the result
+ *  does not depend on the number of threads.
+ *
+ * @param x [in/out] vector to sort
+ */
+template<class T>
+void parallel_sort(std::vector<T>& x)
+{
+    size_t n = x.size();
+    size_t nchunks = (size_t)cvi_get_num_threads();
+    if (nchunks <= 1 || n < 2*nchunks) {
+        std::sort(x.begin(), x.end());
+        return;
+    }
+
+    std::vector<size_t> bounds(nchunks+1);
+    for (size_t c=0; c<=nchunks; ++c)
+        bounds[c] = (n*c)/nchunks;
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static, 1) num_threads(cvi_get_num_threads())
+    #endif
+    for (size_t c=0; c<nchunks; ++c)
+        std::sort(x.begin()+bounds[c], x.begin()+bounds[c+1]);
+
+    std::vector<T> buf(n);
+    T* src = x.data();
+    T* dst = buf.data();
+    for (size_t step=1; step<nchunks; step*=2) {
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(static, 1) num_threads(cvi_get_num_threads())
+        #endif
+        for (size_t c=0; c<nchunks; c+=2*step) {
+            size_t b0 = bounds[c];
+            size_t b1 = bounds[std::min(c+step, nchunks)];
+            size_t b2 = bounds[std::min(c+2*step, nchunks)];
+            std::merge(src+b0, src+b1, src+b1, src+b2, dst+b0);
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != x.data())
+        std::copy(src, src+n, x.data());
+}
+
+
+
+
 
 /** The Baker-Hubert Gamma Coefficient
  *
@@ -42,36 +94,80 @@
  *  pp. 31-38.
  *
  */
-class GammaIndex : public ClusterValidityIndex
+template<class Label>
+class GammaIndex : public LabelledIndex<Label>
 {
 protected:
+    CVI_LABELLED_INDEX_MEMBERS(LabelledIndex<Label>)
+
     size_t n_pairs; ///< n*(n-1)/2
-    std::vector<DistTriple> D;
+    std::shared_ptr< const std::vector<DistTriple> > D; ///< sorted pairs, shared by the replicas
 
-public:
-    // Described in the base class
-    GammaIndex(
-           const matrix<FLOAT_T>& _X,
-           const uint8_t _K,
-           const bool _allow_undo=false)
-        : ClusterValidityIndex(_X, _K, _allow_undo),
-            n_pairs(n*(n-1)/2),
-            D(n_pairs)
 
+    /** Fills a vector of size n_pairs with all the pairs
+     *  and their dissimilarities, dis(i, j) (a thread-safe function object)
+     */
+    template<class Dissimilarity>
+    void compute_pairs(const Dissimilarity& dis, std::vector<DistTriple>& pairs)
     {
-        size_t k=0;
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic, 16) num_threads(cvi_get_num_threads())
+        #endif
         for (size_t i=0; i<n-1; ++i) {
+            size_t k = i*n - i*(i+1)/2;  // index of (i, i+1)
             for (size_t j=i+1; j<n; ++j) {
-                D[k++] = DistTriple(i, j,
-                    distance_l2_squared(X.row(i), X.row(j), X.ncol()));
+                pairs[k++] = DistTriple(i, j, dis(i, j));
             }
         }
-        std::sort(D.begin(), D.end());
+    }
+
+public:
+    // Described in the base class
+    GammaIndex(
+           const DatasetPtr& _data,
+           const size_t _K,
+           const bool _allow_undo=false,
+           const int _metric=CVI_METRIC_EUCLIDEAN,
+           const int _distance_storage=CVI_DISTANCE_DOUBLE)
+        : LabelledIndex<Label>(_data, _K, _allow_undo,
+            _metric, _distance_storage),
+            n_pairs(n*(n-1)/2)
+    {
+        std::shared_ptr< std::vector<DistTriple> > pairs(
+            new std::vector<DistTriple>(n_pairs));
+
+        // only the ordering of the distances matters, hence the raw
+        // dissimilarities (e.g., squared Euclidean distances) can be used
+        if (!data->has_coordinates()) {  // given pairwise distances
+            compute_pairs(data->get_distance(false, metric, distance_storage), *pairs);
+        }
+        else {
+            matrix_view<FLOAT_T> Xm = data->get_metric_X(metric);
+            switch (metric) {
+                case CVI_METRIC_MANHATTAN:   compute_pairs(__MetricDistance<MetricManhattan, true>(Xm), *pairs); break;
+                case CVI_METRIC_CHEBYSHEV:   compute_pairs(__MetricDistance<MetricChebyshev, true>(Xm), *pairs); break;
+                case CVI_METRIC_COSINE:      compute_pairs(__MetricDistance<MetricCosine, true>(Xm), *pairs); break;
+                case CVI_METRIC_MAHALANOBIS: compute_pairs(__MetricDistance<MetricMahalanobis, true>(Xm), *pairs); break;
+                default:                     compute_pairs(__MetricDistance<MetricEuclidean, true>(Xm), *pairs);
+            }
+        }
+        parallel_sort(*pairs);  // ties resolved by (i1, i2), see DistTriple
+        D = pairs;
     }
 
 
     // Described in the base class
-    virtual FLOAT_T compute()
+    virtual ClusterValidityIndex* clone() const
+    {
+        return new GammaIndex(*this);
+    }
+
+
+    /** Computes the index for a given partition
+     *  (PartitionView<Label> or MovedPartitionView)
+     */
+    template<class Partition>
+    FLOAT_T compute_for(const Partition& P) const
     {
         // let I1, I2 - an auxiliary vector of size n_pairs=n*(n-1)/2
         // with (I1[i], I2[i]) - indexes of the i-th nearest pair of points,
@@ -81,10 +177,11 @@ public:
         size_t nc = 0; ///< number of concordant pairs
         size_t nd = 0; ///< number of discordant pairs
 
+        const std::vector<DistTriple>& pairs = *D;
         size_t number_of_0_so_far = 0;
         size_t number_of_1_so_far = 0;
         for (size_t j=0; j<n_pairs; ++j) {
-            if (L[D[j].i1] == L[D[j].i2]) { // 0 - a pair of objects in the same cluster
+            if (P.label(pairs[j].i1) == P.label(pairs[j].i2)) { // 0 - a pair of objects in the same cluster
                 nd += number_of_1_so_far;
                 number_of_0_so_far++;
             }
@@ -98,6 +195,20 @@ public:
         CVI_ASSERT(std::fabs(ret) < 1.0+1e-9);
         return ret;
     }
+
+
+    // Described in the base class
+    virtual FLOAT_T compute()
+    {
+        return compute_for(PartitionView<Label>(L, count));
+    }
+
+
+    // Described in the base class
+    virtual FLOAT_T score_move(size_t i, size_t j) const
+    {
+        return compute_for(MovedPartitionView<Label>(L, count, i, j));
+    }
 };
 
 
@@ -32,27 +32,57 @@
  *  Compact Well-Separated Clusters, Journal of Cybernetics 3(3), 1974,
  *  pp. 32-57, doi:10.1080/01969727308546046.
  */
-class GeneralizedDunnIndex : public ClusterValidityIndex
+template<class Label>
+class GeneralizedDunnIndex : public LabelledIndex<Label>
 {
 protected:
+    CVI_LABELLED_INDEX_MEMBERS(LabelledIndex<Label>)
+
     EuclideanDistance D; ///< squared Euclidean
-    LowercaseDelta* numeratorDelta;
-    UppercaseDelta* denominatorDelta;
+    LowercaseDelta<Label>* numeratorDelta;
+    UppercaseDelta<Label>* denominatorDelta;
 
 public:
     // Described in the base class
     GeneralizedDunnIndex(
-           const matrix<FLOAT_T>& _X,
-           const uint8_t _K,
-           LowercaseDeltaFactory* numeratorDeltaFactory,
-           UppercaseDeltaFactory* denominatorDeltaFactory,
-           const bool _allow_undo=false)
-        : ClusterValidityIndex(_X, _K, _allow_undo),
-          D(&X, n<=CVI_MAX_N_PRECOMPUTE_DISTANCE, true/*squared*/),
+           const DatasetPtr& _data,
+           const size_t _K,
+           LowercaseDeltaFactory<Label>* numeratorDeltaFactory,
+           UppercaseDeltaFactory<Label>* denominatorDeltaFactory,
+           const bool _allow_undo=false,
+           const int _metric=CVI_METRIC_EUCLIDEAN,
+           const int _distance_storage=CVI_DISTANCE_DOUBLE)
+        : LabelledIndex<Label>(_data, _K, _allow_undo,
+            _metric, _distance_storage),
+          D(data->get_distance(true/*squared*/, metric, distance_storage)),
           numeratorDelta(numeratorDeltaFactory->create(D, X, L, count, K, n, d)),
           denominatorDelta(denominatorDeltaFactory->create(D, X, L, count, K, n, d))
+    {
+        if (numeratorDelta->needs_mst())
+            numeratorDelta->set_mst(data->get_mst(metric, distance_storage));
+    }
+
+
+    /** Copy constructor, see clone()
+     */
+    GeneralizedDunnIndex(const GeneralizedDunnIndex& other)
+        : LabelledIndex<Label>(other),
+          D(other.D.clone()),
+          numeratorDelta(other.numeratorDelta->clone(D, L, count, NULL)),
+          denominatorDelta(other.denominatorDelta->clone(D, L, count, NULL))
     { }
 
+
+    // Described in the base class
+    virtual ClusterValidityIndex* clone() const
+    {
+        return new GeneralizedDunnIndex(*this);
+    }
+
+
+    // Described in the base class
+    virtual const EuclideanDistance* get_distance() const { return &D; }
+
     ~GeneralizedDunnIndex()
     {
         delete numeratorDelta;
@@ -60,32 +90,65 @@ public:
     }
 
     // Described in the base class
-    virtual void set_labels(const std::vector<uint8_t>& _L)
+    virtual void set_labels(const std::vector<Label>& _L)
     {
-        ClusterValidityIndex::set_labels(_L); // sets L, count and centroids
+        LabelledIndex<Label>::set_labels(_L); // sets L, count and centroids
         numeratorDelta->recompute_all();
         denominatorDelta->recompute_all();
     }
 
 
     // Described in the base class
-    virtual void modify(size_t i, uint8_t j)
+    virtual void modify(size_t i, size_t j)
     {
+        numeratorDelta->set_keep_journal(in_transaction());
+        denominatorDelta->set_keep_journal(in_transaction());
         numeratorDelta->before_modify(i, j);
         denominatorDelta->before_modify(i, j);
         // sets L[i]=j and updates count as well as centroids
-        ClusterValidityIndex::modify(i, j);
+        LabelledIndex<Label>::modify(i, j);
         numeratorDelta->after_modify(i, j);
         denominatorDelta->after_modify(i, j);
     }
 
 
+    // Described in the base class
+    virtual void swap(size_t i, size_t k)
+    {
+        numeratorDelta->set_keep_journal(in_transaction());
+        denominatorDelta->set_keep_journal(in_transaction());
+        numeratorDelta->before_swap(i, k);
+        denominatorDelta->before_swap(i, k);
+        // exchanges L[i] and L[k]
+        LabelledIndex<Label>::swap(i, k);
+        numeratorDelta->after_swap(i, k);
+        denominatorDelta->after_swap(i, k);
+    }
+
+
+    // Described in the base class
+    virtual void modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels)
+    {
+        check_many(idx, labels);
+        numeratorDelta->set_keep_journal(in_transaction());
+        denominatorDelta->set_keep_journal(in_transaction());
+        numeratorDelta->before_modify_many(idx, labels);
+        denominatorDelta->before_modify_many(idx, labels);
+        // sets L and count as well as centroids
+        LabelledIndex<Label>::modify_many(idx, labels);
+        numeratorDelta->after_modify_many(idx, labels);
+        denominatorDelta->after_modify_many(idx, labels);
+    }
+
+
     // Described in the base class
     virtual void undo()
     {
+        CVI_ASSERT(can_undo());
         numeratorDelta->undo();
         denominatorDelta->undo();
-        ClusterValidityIndex::undo();
+        LabelledIndex<Label>::undo();
     }
 
 
@@ -94,11 +157,12 @@ public:
     {
         FLOAT_T max_denominator = 0.0;
         FLOAT_T min_numerator = INFTY;
+        bool has_min = numeratorDelta->compute_min(min_numerator);
         for (size_t i=0; i<K; ++i) {
             FLOAT_T denom_i = denominatorDelta->compute(i);
             if (denom_i > max_denominator)
                 max_denominator = denom_i;
-            for (size_t j=i+1; j<K; ++j) {
+            for (size_t j=i+1; j<K && !has_min; ++j) {
                 FLOAT_T num_ij = numeratorDelta->compute(i, j);
                 if (num_ij < min_numerator)
                     min_numerator = num_ij;
@@ -108,30 +172,91 @@ public:
         // remember to do sqrt in deltas!
         return min_numerator/max_denominator;
     }
+
+
+    // Described in the base class
+    virtual FLOAT_T score_move(size_t i, size_t j) const
+    {
+        MovedPartitionView<Label> P(L, count, i, j);
+        const MovedCentroidsView<Label>* C = NULL;
+        std::vector<FLOAT_T> denom(K);
+        denominatorDelta->compute_moved(P, C, denom);
+
+        FLOAT_T max_denominator = 0.0;
+        FLOAT_T min_numerator = INFTY;
+        bool has_min = numeratorDelta->compute_moved_min(P, min_numerator);
+        matrix<FLOAT_T> num(has_min?0:K, has_min?0:K);
+        if (!has_min)
+            numeratorDelta->compute_moved(P, C, num);
+
+        for (size_t i=0; i<K; ++i) {
+            if (denom[i] > max_denominator)
+                max_denominator = denom[i];
+            for (size_t j=i+1; j<K && !has_min; ++j) {
+                if (num(i, j) < min_numerator)
+                    min_numerator = num(i, j);
+            }
+        }
+
+        return min_numerator/max_denominator;
+    }
 };
 
 
-class GeneralizedDunnIndexCentroidBased : public CentroidsBasedIndex
+template<class Label>
+class GeneralizedDunnIndexCentroidBased : public CentroidsBasedIndex<Label>
 {
 protected:
+    CVI_LABELLED_INDEX_MEMBERS(CentroidsBasedIndex<Label>)
+    using CentroidsBasedIndex<Label>::centroids;
+    using CentroidsBasedIndex<Label>::move_centroids;
+    using CentroidsBasedIndex<Label>::swap_centroids;
+
     EuclideanDistance D; ///< squared Euclidean
-    LowercaseDelta* numeratorDelta;
-    UppercaseDelta* denominatorDelta;
+    LowercaseDelta<Label>* numeratorDelta;
+    UppercaseDelta<Label>* denominatorDelta;
 
 public:
     // Described in the base class
     GeneralizedDunnIndexCentroidBased(
-           const matrix<FLOAT_T>& _X,
-           const uint8_t _K,
-           LowercaseDeltaFactory* numeratorDeltaFactory,
-           UppercaseDeltaFactory* denominatorDeltaFactory,
-           const bool _allow_undo=false)
-        : CentroidsBasedIndex(_X, _K, _allow_undo),
-          D(&X, n<=CVI_MAX_N_PRECOMPUTE_DISTANCE, true/*squared*/),
+           const DatasetPtr& _data,
+           const size_t _K,
+           LowercaseDeltaFactory<Label>* numeratorDeltaFactory,
+           UppercaseDeltaFactory<Label>* denominatorDeltaFactory,
+           const bool _allow_undo=false,
+           const int _metric=CVI_METRIC_EUCLIDEAN,
+           const int _distance_storage=CVI_DISTANCE_DOUBLE)
+        : CentroidsBasedIndex<Label>(_data, _K, _allow_undo,
+            _metric, _distance_storage),
+          D(data->get_distance(true/*squared*/, metric, distance_storage)),
           numeratorDelta(numeratorDeltaFactory->create(D, X, L, count, K, n, d, &centroids)),
           denominatorDelta(denominatorDeltaFactory->create(D, X, L, count, K, n, d, &centroids))
+    {
+        if (numeratorDelta->needs_mst())
+            numeratorDelta->set_mst(data->get_mst(metric, distance_storage));
+    }
+
+
+    /** Copy constructor, see clone()
+     */
+    GeneralizedDunnIndexCentroidBased(const GeneralizedDunnIndexCentroidBased& other)
+        : CentroidsBasedIndex<Label>(other),
+          D(other.D.clone()),
+          numeratorDelta(other.numeratorDelta->clone(D, L, count, &centroids)),
+          denominatorDelta(other.denominatorDelta->clone(D, L, count, &centroids))
     { }
 
+
+    // Described in the base class
+    virtual ClusterValidityIndex* clone() const
+    {
+        return new GeneralizedDunnIndexCentroidBased(*this);
+    }
+
+
+    // Described in the base class
+    virtual const EuclideanDistance* get_distance() const { return &D; }
+
     ~GeneralizedDunnIndexCentroidBased()
     {
         delete numeratorDelta;
@@ -139,32 +264,65 @@ public:
     }
 
     // Described in the base class
-    virtual void set_labels(const std::vector<uint8_t>& _L)
+    virtual void set_labels(const std::vector<Label>& _L)
     {
-        CentroidsBasedIndex::set_labels(_L); // sets L, count and centroids
+        CentroidsBasedIndex<Label>::set_labels(_L); // sets L, count and centroids
         numeratorDelta->recompute_all();
         denominatorDelta->recompute_all();
     }
 
 
     // Described in the base class
-    virtual void modify(size_t i, uint8_t j)
+    virtual void modify(size_t i, size_t j)
     {
+        numeratorDelta->set_keep_journal(in_transaction());
+        denominatorDelta->set_keep_journal(in_transaction());
         numeratorDelta->before_modify(i, j);
         denominatorDelta->before_modify(i, j);
         // sets L[i]=j and updates count as well as centroids
-        CentroidsBasedIndex::modify(i, j);
+        CentroidsBasedIndex<Label>::modify(i, j);
         numeratorDelta->after_modify(i, j);
         denominatorDelta->after_modify(i, j);
     }
 
 
+    // Described in the base class
+    virtual void swap(size_t i, size_t k)
+    {
+        numeratorDelta->set_keep_journal(in_transaction());
+        denominatorDelta->set_keep_journal(in_transaction());
+        numeratorDelta->before_swap(i, k);
+        denominatorDelta->before_swap(i, k);
+        // exchanges L[i] and L[k] and updates the centroids
+        CentroidsBasedIndex<Label>::swap(i, k);
+        numeratorDelta->after_swap(i, k);
+        denominatorDelta->after_swap(i, k);
+    }
+
+
+    // Described in the base class
+    virtual void modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels)
+    {
+        check_many(idx, labels);
+        numeratorDelta->set_keep_journal(in_transaction());
+        denominatorDelta->set_keep_journal(in_transaction());
+        numeratorDelta->before_modify_many(idx, labels);
+        denominatorDelta->before_modify_many(idx, labels);
+        // sets L and count as well as centroids
+        CentroidsBasedIndex<Label>::modify_many(idx, labels);
+        numeratorDelta->after_modify_many(idx, labels);
+        denominatorDelta->after_modify_many(idx, labels);
+    }
+
+
     // Described in the base class
     virtual void undo()
     {
+        CVI_ASSERT(can_undo());
         numeratorDelta->undo();
         denominatorDelta->undo();
-        CentroidsBasedIndex::undo();
+        CentroidsBasedIndex<Label>::undo();
     }
 
 
@@ -173,11 +331,12 @@ public:
     {
         FLOAT_T max_denominator = 0.0;
         FLOAT_T min_numerator = INFTY;
+        bool has_min = numeratorDelta->compute_min(min_numerator);
         for (size_t i=0; i<K; ++i) {
             FLOAT_T denom_i = denominatorDelta->compute(i);
             if (denom_i > max_denominator)
                 max_denominator = denom_i;
-            for (size_t j=i+1; j<K; ++j) {
+            for (size_t j=i+1; j<K && !has_min; ++j) {
                 FLOAT_T num_ij = numeratorDelta->compute(i, j);
                 if (num_ij < min_numerator)
                     min_numerator = num_ij;
@@ -187,6 +346,34 @@ public:
         // remember to do sqrt in deltas!
         return min_numerator/max_denominator;
     }
+
+
+    // Described in the base class
+    virtual FLOAT_T score_move(size_t i, size_t j) const
+    {
+        MovedCentroidsView<Label> P(X, L, count, centroids, i, j);
+        const MovedCentroidsView<Label>* C = &P;
+        std::vector<FLOAT_T> denom(K);
+        denominatorDelta->compute_moved(P, C, denom);
+
+        FLOAT_T max_denominator = 0.0;
+        FLOAT_T min_numerator = INFTY;
+        bool has_min = numeratorDelta->compute_moved_min(P, min_numerator);
+        matrix<FLOAT_T> num(has_min?0:K, has_min?0:K);
+        if (!has_min)
+            numeratorDelta->compute_moved(P, C, num);
+
+        for (size_t i=0; i<K; ++i) {
+            if (denom[i] > max_denominator)
+                max_denominator = denom[i];
+            for (size_t j=i+1; j<K && !has_min; ++j) {
+                if (num(i, j) < min_numerator)
+                    min_numerator = num(i, j);
+            }
+        }
+
+        return min_numerator/max_denominator;
+    }
 };
 
 
@@ -18,26 +18,50 @@
 
 #include "cvi.h"
 
+template<class Label>
 class Delta
 {
 protected:
     EuclideanDistance& D; ///< squared Euclidean
-    const matrix<FLOAT_T>& X;
+    matrix_view<FLOAT_T> X;
     //matrix<FLOAT_T>& X;         ///< data matrix of size n*d
-    std::vector<uint8_t>& L;    ///< current label vector of size n
+    std::vector<Label>& L;    ///< current label vector of size n
     std::vector<size_t>& count; ///< size of each of the K clusters
-    uint8_t K;
+    size_t K;
     size_t n;
     size_t d;
     matrix<FLOAT_T>* centroids; ///< centroids, can be NULL
-    
+    bool keep_journal; ///< keep the undo() data of the previous modifications?
+    std::vector<bool> affected; ///< clusters touched by modify_many()
+
+    /** Marks (in affected) the clusters that lose or gain points
+     *  when L[idx[t]] is set to labels[t]; to be called before the change
+     */
+    void mark_affected(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels)
+    {
+        affected.assign(K, false);
+        for (size_t t=0; t<idx.size(); ++t)
+            affected[L[idx[t]]] = affected[labels[t]] = true;
+    }
+
+    /** Returns an indicator vector of size n for the points in idx
+     */
+    std::vector<bool> get_moved(const std::vector<size_t>& idx) const
+    {
+        std::vector<bool> moved(n, false);
+        for (size_t t=0; t<idx.size(); ++t)
+            moved[idx[t]] = true;
+        return moved;
+    }
+
 public:
     Delta(
            EuclideanDistance& D,
-           const matrix<FLOAT_T>& X,
-           std::vector<uint8_t>& L,
+           const matrix_view<FLOAT_T>& X,
+           std::vector<Label>& L,
            std::vector<size_t>& count,
-           uint8_t K,
+           size_t K,
            size_t n,
            size_t d,
            matrix<FLOAT_T>* centroids=nullptr
@@ -49,50 +73,207 @@ public:
           K(K),
           n(n),
           d(d),
-          centroids(centroids)
+          centroids(centroids),
+          keep_journal(false)
+    { }
+
+    /** Copies the state of another object, but refers to the given
+     *  distances, labels, cluster sizes and centroids (those of
+     *  an index replica, see LabelledIndex<Label>::clone())
+     */
+    Delta(
+           const Delta& other,
+           EuclideanDistance& D,
+           std::vector<Label>& L,
+           std::vector<size_t>& count,
+           matrix<FLOAT_T>* centroids
+           )
+        : D(D),
+          X(other.X),
+          L(L),
+          count(count),
+          K(other.K),
+          n(other.n),
+          d(other.d),
+          centroids(centroids),
+          keep_journal(other.keep_journal),
+          affected(other.affected)
     { }
 
-    virtual void before_modify(size_t i, uint8_t j) = 0;
-    virtual void after_modify(size_t i, uint8_t j) = 0;
+    virtual ~Delta() { }
+
+    /** Shall the undo() data of the previous modifications be kept
+     *  on the next before_modify() (within a transaction,
+     *  see LabelledIndex<Label>::begin()) or discarded?
+     */
+    void set_keep_journal(bool keep) { keep_journal = keep; }
+
+    virtual void before_modify(size_t i, size_t j) = 0;
+    virtual void after_modify(size_t i, size_t j) = 0;
+
+    /** Called before and after the labels of the i-th and the k-th point
+     *  are exchanged, see LabelledIndex<Label>::swap();
+     *  a single undo() must revert both
+     */
+    virtual void before_swap(size_t i, size_t k) = 0;
+    virtual void after_swap(size_t i, size_t k) = 0;
+
+    /** Called before and after L[idx[t]] is set to labels[t] for all t,
+     *  see LabelledIndex<Label>::modify_many();
+     *  a single undo() must revert all the changes
+     */
+    virtual void before_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) = 0;
+    virtual void after_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) = 0;
+
     virtual void undo() = 0;
     virtual void recompute_all() = 0;
 };
 
-class LowercaseDelta : public Delta
+/** Brings the protected members of Delta<Label> into the scope
+ *  of an inheriting class template; Base is a Delta<Label>
+ *  or a class derived from it
+ */
+#define CVI_DELTA_MEMBERS(Base) \
+    using Base::D; \
+    using Base::X; \
+    using Base::L; \
+    using Base::count; \
+    using Base::K; \
+    using Base::n; \
+    using Base::d; \
+    using Base::centroids; \
+    using Base::keep_journal; \
+    using Base::affected; \
+    using Base::mark_affected; \
+    using Base::get_moved;
+
+
+template<class Label>
+class LowercaseDelta : public Delta<Label>
 {
 public:
     LowercaseDelta(
         EuclideanDistance& D,
-        const matrix<FLOAT_T>& X,
-        std::vector<uint8_t>& L,
+        const matrix_view<FLOAT_T>& X,
+        std::vector<Label>& L,
         std::vector<size_t>& count,
-        uint8_t K,
+        size_t K,
         size_t n,
         size_t d,
         matrix<FLOAT_T>* centroids=nullptr
         )
-    : Delta(D,X,L,count,K,n,d,centroids)
+    : Delta<Label>(D,X,L,count,K,n,d,centroids)
+    { }
+    LowercaseDelta(
+        const LowercaseDelta& other,
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids
+        )
+    : Delta<Label>(other,D,L,count,centroids)
     { }
+
+    /** Returns a copy that refers to the given distances, labels,
+     *  cluster sizes and centroids (to be deleted by the caller)
+     */
+    virtual LowercaseDelta<Label>* clone(
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids) const = 0;
+
     virtual FLOAT_T compute(size_t k, size_t l) = 0;
+
+    /** Determines compute(k, l) for all k<l as if the P.i-th point
+     *  was moved to the P.to-th cluster, without modifying the object's state
+     *
+     * @param P the partition after the move
+     * @param C the centroids after the move (NULL if not IsCentroidNeeded())
+     * @param res [out] matrix of size K*K; only the elements
+     *        above the main diagonal are set
+     */
+    virtual void compute_moved(const MovedPartitionView<Label>& P,
+        const MovedCentroidsView<Label>* C, matrix<FLOAT_T>& res) const = 0;
+
+    /** Does the delta need the dataset's minimum spanning tree,
+     *  see set_mst()?
+     */
+    virtual bool needs_mst() const { return false; }
+
+    /** Provides the minimum spanning tree, see Dataset::get_mst();
+     *  to be called before recompute_all()
+     */
+    virtual void set_mst(const std::shared_ptr<const MinimumSpanningTree>& mst) { }
+
+    /** Determines the minimum of compute(k, l) over all k<l directly
+     *  (if supported; then compute(k, l) is not available)
+     *
+     * @param res [out]
+     * @return false if not supported
+     */
+    virtual bool compute_min(FLOAT_T& res) const { return false; }
+
+    /** Determines compute_min() as if the P.i-th point was moved
+     *  to the P.to-th cluster, see compute_moved()
+     *
+     * @param P the partition after the move
+     * @param res [out]
+     * @return false if not supported
+     */
+    virtual bool compute_moved_min(const MovedPartitionView<Label>& P,
+        FLOAT_T& res) const { return false; }
 };
 
 
-class UppercaseDelta : public Delta
+template<class Label>
+class UppercaseDelta : public Delta<Label>
 {
 public:
     UppercaseDelta(
         EuclideanDistance& D,
-        const matrix<FLOAT_T>& X,
-        std::vector<uint8_t>& L,
+        const matrix_view<FLOAT_T>& X,
+        std::vector<Label>& L,
         std::vector<size_t>& count,
-        uint8_t K,
+        size_t K,
         size_t n,
         size_t d,
         matrix<FLOAT_T>* centroids=nullptr
         )
-    : Delta(D,X,L,count,K,n,d,centroids)
+    : Delta<Label>(D,X,L,count,K,n,d,centroids)
+    { }
+    UppercaseDelta(
+        const UppercaseDelta& other,
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids
+        )
+    : Delta<Label>(other,D,L,count,centroids)
     { }
+
+    /** Returns a copy that refers to the given distances, labels,
+     *  cluster sizes and centroids (to be deleted by the caller)
+     */
+    virtual UppercaseDelta<Label>* clone(
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids) const = 0;
+
     virtual FLOAT_T compute(size_t k) = 0;
+
+    /** Determines compute(k) for all k as if the P.i-th point
+     *  was moved to the P.to-th cluster, without modifying the object's state
+     *
+     * @param P the partition after the move
+     * @param C the centroids after the move (NULL if not IsCentroidNeeded())
+     * @param res [out] vector of size K
+     */
+    virtual void compute_moved(const MovedPartitionView<Label>& P,
+        const MovedCentroidsView<Label>* C, std::vector<FLOAT_T>& res) const = 0;
 };
 
 class DeltaFactory
@@ -102,36 +283,38 @@ public:
 };
 
 
+template<class Label>
 class LowercaseDeltaFactory : public DeltaFactory
 {
 public:
     // cannot be in DeltaFactory since result type is different, even if parameter list is the same
-    virtual LowercaseDelta* create(EuclideanDistance& D,
-           const matrix<FLOAT_T>& X,
-           std::vector<uint8_t>& L,
+    virtual LowercaseDelta<Label>* create(EuclideanDistance& D,
+           const matrix_view<FLOAT_T>& X,
+           std::vector<Label>& L,
            std::vector<size_t>& count,
-           uint8_t K,
+           size_t K,
            size_t n,
            size_t d,
            matrix<FLOAT_T>* centroids=nullptr) = 0;
 
-    // static LowercaseDeltaFactory* GetSpecializedFactory(std::string lowercaseDeltaName);
+    // static LowercaseDeltaFactory<Label>* GetSpecializedFactory(std::string lowercaseDeltaName);
 };
 
+template<class Label>
 class UppercaseDeltaFactory : public DeltaFactory
 {
 public:
     // cannot be in DeltaFactory since result type is different, even if parameter list is the same
-    virtual UppercaseDelta* create(EuclideanDistance& D,
-           const matrix<FLOAT_T>& X,
-           std::vector<uint8_t>& L,
+    virtual UppercaseDelta<Label>* create(EuclideanDistance& D,
+           const matrix_view<FLOAT_T>& X,
+           std::vector<Label>& L,
            std::vector<size_t>& count,
-           uint8_t K,
+           size_t K,
            size_t n,
            size_t d,
            matrix<FLOAT_T>* centroids=nullptr) = 0;
 
-    // static UppercaseDeltaFactory* GetSpecializedFactory(std::string uppercaseDeltaName);
+    // static UppercaseDeltaFactory<Label>* GetSpecializedFactory(std::string uppercaseDeltaName);
 };
 
 #endif
\ No newline at end of file
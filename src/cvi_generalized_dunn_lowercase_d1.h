@@ -19,36 +19,96 @@
 #include "cvi.h"
 #include "cvi_generalized_dunn_delta.h"
 
-class LowercaseDelta1 : public LowercaseDelta
+template<class Label>
+class LowercaseDelta1 : public LowercaseDelta<Label>
 {
+protected:
+    CVI_DELTA_MEMBERS(LowercaseDelta<Label>)
+
 protected:
     matrix<DistTriple> dist; /**< intra-cluster distances:
         dist(i,j) = min( X(u,), X(v,) ), X(u,) in C_i, X(v,) in C_j  (i!=j)
         */
-    matrix<DistTriple> last_dist;      ///< for undo()
-    bool last_chg; ///< for undo() (was dist changed at all?)
+    UndoJournal<DistTriple> last_dist; ///< changes to dist, for undo()
     bool needs_recompute; ///< for before and after modify
     std::function< bool(FLOAT_T, FLOAT_T) > comparator;
+    CrossLabelEdges<Label> cross; /**< if the MST is given (see set_mst()),
+        the smallest intra-cluster distance is determined based on it
+        and dist is not used
+        */
+
+    /** The value dist(i,j) is initialised with in recompute_all()
+     */
+    virtual FLOAT_T get_initial_dist() const { return INFTY; }
+
+    /** Takes into account the distance d between the i-th and the u-th point
+     *  (the former has just changed its label) in dist; logs the changes
+     */
+    void update_dist(size_t i, size_t u, FLOAT_T d) {
+        if (i == u) return;
+
+        if (L[i] != L[u]) {
+            if (comparator(d, dist(L[i], L[u]).d)) {
+                last_dist.log(dist, L[i], L[u]);
+                last_dist.log(dist, L[u], L[i]);
+                dist(L[i], L[u]) = dist(L[u], L[i]) = DistTriple(i, u, d);
+            }
+        }
+    }
 
 public:
     LowercaseDelta1(
         EuclideanDistance& D,
-        const matrix<FLOAT_T>& X,
-        std::vector<uint8_t>& L,
+        const matrix_view<FLOAT_T>& X,
+        std::vector<Label>& L,
         std::vector<size_t>& count,
-        uint8_t K,
+        size_t K,
         size_t n,
         size_t d,
         matrix<FLOAT_T>* centroids=nullptr
         )
-    : LowercaseDelta(D, X, L, count,K,n,d,centroids),
+    : LowercaseDelta<Label>(D, X, L, count,K,n,d,centroids),
     dist(K, K),
-    last_dist(K, K)
+    needs_recompute(false)
     { 
         comparator = std::less<FLOAT_T>();
 
     }
-    virtual void before_modify(size_t i, uint8_t j) {
+    LowercaseDelta1(
+        const LowercaseDelta1& other,
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids
+        )
+    : LowercaseDelta<Label>(other, D, L, count, centroids),
+    dist(other.dist),
+    last_dist(other.last_dist),
+    needs_recompute(other.needs_recompute),
+    comparator(other.comparator),
+    cross(other.cross)
+    { }
+
+    virtual LowercaseDelta<Label>* clone(
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids) const {
+            return new LowercaseDelta1<Label>(*this, D, L, count, centroids);
+        }
+
+    virtual bool needs_mst() const { return true; }
+
+    virtual void set_mst(const std::shared_ptr<const MinimumSpanningTree>& mst) {
+        cross = CrossLabelEdges<Label>(mst);
+    }
+
+    virtual void before_modify(size_t i, size_t j) {
+        if (cross.is_set()) {
+            cross.open(keep_journal);
+            return;
+        }
+
         needs_recompute = false;
         for (size_t u=0; u<K; ++u) {
 
@@ -56,50 +116,137 @@ public:
                 // if the point being modified determines intra-cluster distance:
                 if (dist(u,v).i1 == i || dist(u,v).i2 == i)
                     needs_recompute = true;
+            }
+        }
+
+        last_dist.open(keep_journal);
+    }
+    virtual void after_modify(size_t i, size_t j) {
+        if (cross.is_set()) {
+            cross.update(i, L);
+            return;
+        }
 
-                last_dist(u,v) = last_dist(v,u) = dist(u,v);
+        if (needs_recompute) {
+            last_dist.log_all(dist);
+            recompute_all();
+        }
+        else {
+            std::vector<FLOAT_T> buf;
+            const FLOAT_T* Di = D.row(i, buf);
+            for (size_t u=0; u<n; ++u)
+                update_dist(i, u, Di[u]);
+        }
+    }
+
+    virtual void before_swap(size_t i, size_t k) {
+        if (cross.is_set()) {
+            cross.open(keep_journal);
+            return;
+        }
+
+        needs_recompute = false;
+        for (size_t u=0; u<K; ++u) {
+            for (size_t v=u+1; v<K; ++v) {
+                // if either point determines intra-cluster distance:
+                if (dist(u,v).i1 == i || dist(u,v).i2 == i ||
+                        dist(u,v).i1 == k || dist(u,v).i2 == k)
+                    needs_recompute = true;
             }
         }
+
+        last_dist.open(keep_journal);
     }
-    virtual void after_modify(size_t i, uint8_t j) {
+
+    virtual void after_swap(size_t i, size_t k) {
+        if (cross.is_set()) {
+            cross.update(i, L);
+            cross.update(k, L);
+            return;
+        }
+
         if (needs_recompute) {
-            last_chg = true;
+            last_dist.log_all(dist);
             recompute_all();
         }
         else {
-            last_chg = false;
+            // only the pairs involving the two points need to be inspected
+            std::vector<FLOAT_T> buf_i, buf_k;
+            const FLOAT_T* Di = D.row(i, buf_i);
+            const FLOAT_T* Dk = D.row(k, buf_k);
             for (size_t u=0; u<n; ++u) {
-                if (i == u) continue;
+                update_dist(i, u, Di[u]);
+                update_dist(k, u, Dk[u]);
+            }
+        }
+    }
+    virtual void before_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        if (cross.is_set()) {
+            cross.open(keep_journal);
+            return;
+        }
 
-                FLOAT_T d = D(i, u);
-                if (L[i] != L[u]) {
-                    if (comparator(d, dist(L[i], L[u]).d)) {
-                        dist(L[i], L[u]) = dist(L[u], L[i]) = DistTriple(i, u, d);
-                        last_chg = true;
-                    }
-                }
+        std::vector<bool> moved = get_moved(idx);
+        needs_recompute = false;
+        for (size_t u=0; u<K; ++u) {
+            for (size_t v=u+1; v<K; ++v) {
+                // if a point being moved determines intra-cluster distance:
+                if (moved[dist(u,v).i1] || moved[dist(u,v).i2])
+                    needs_recompute = true;
             }
         }
+
+        last_dist.open(keep_journal);
     }
-    virtual void undo() {
-        if (last_chg) {
-            for (size_t i=0; i<K; ++i) {
-                for (size_t j=i+1; j<K; ++j) {
-                    dist(i,j) = dist(j,i) = last_dist(i,j);
-                }
+
+    virtual void after_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        if (cross.is_set()) {
+            for (size_t t=0; t<idx.size(); ++t)
+                cross.update(idx[t], L);
+            return;
+        }
+
+        if (needs_recompute) {
+            last_dist.log_all(dist);
+            recompute_all();
+        }
+        else {
+            std::vector<FLOAT_T> buf;
+            for (size_t t=0; t<idx.size(); ++t) {
+                const FLOAT_T* Di = D.row(idx[t], buf);
+                for (size_t u=0; u<n; ++u)
+                    update_dist(idx[t], u, Di[u]);
             }
         }
     }
+
+    virtual void undo() {
+        if (cross.is_set()) {
+            cross.revert();
+            return;
+        }
+
+        last_dist.revert(dist);
+    }
     virtual void recompute_all() {
+        if (cross.is_set()) {
+            cross.recompute(L);
+            return;
+        }
+
         for (size_t i=0; i<K; ++i) {
             for (size_t j=i+1; j<K; ++j) {
                 dist(i,j) = dist(j,i) = DistTriple(0, 0, INFTY);
             }
         }
 
+        std::vector<FLOAT_T> buf;
         for (size_t i=0; i<n-1; ++i) {
+            const FLOAT_T* Di = D.row(i, buf, i+1);
             for (size_t j=i+1; j<n; ++j) {
-                FLOAT_T d = D(i, j);
+                FLOAT_T d = Di[j];
                 if (L[i] != L[j]) {
                     if (comparator(d, dist(L[i], L[j]).d))
                         dist(L[i], L[j]) = dist(L[j], L[i]) = DistTriple(i, j, d);
@@ -109,25 +256,99 @@ public:
     }
     
     virtual FLOAT_T compute(size_t k, size_t l) {
+        CVI_ASSERT(!cross.is_set());
         return sqrt(dist(k, l).d);
     }
 
+    virtual bool compute_min(FLOAT_T& res) const {
+        if (!cross.is_set()) return false;
+        res = sqrt(cross.get_min());
+        return true;
+    }
+
+    virtual bool compute_moved_min(const MovedPartitionView<Label>& P,
+        FLOAT_T& res) const {
+        if (!cross.is_set()) return false;
+        res = sqrt(cross.get_min_moved(P));
+        return true;
+    }
+
+    virtual void compute_moved(const MovedPartitionView<Label>& P,
+        const MovedCentroidsView<Label>* C, matrix<FLOAT_T>& res) const
+    {
+        CVI_ASSERT(!cross.is_set());
+        bool recompute = false;
+        for (size_t u=0; u<K; ++u) {
+            for (size_t v=u+1; v<K; ++v) {
+                // if the point being moved determines intra-cluster distance:
+                if (dist(u,v).i1 == P.i || dist(u,v).i2 == P.i)
+                    recompute = true;
+            }
+        }
+
+        if (recompute) {
+            for (size_t u=0; u<K; ++u) {
+                for (size_t v=u+1; v<K; ++v) {
+                    res(u,v) = res(v,u) = get_initial_dist();
+                }
+            }
+
+            for (size_t u=0; u<n-1; ++u) {
+                Label l_u = P.label(u);
+                for (size_t v=u+1; v<n; ++v) {
+                    Label l_v = P.label(v);
+                    if (l_u != l_v) {
+                        FLOAT_T d = D(u, v);
+                        if (comparator(d, res(l_u, l_v)))
+                            res(l_u, l_v) = res(l_v, l_u) = d;
+                    }
+                }
+            }
+        }
+        else {
+            // the same as in after_modify()
+            for (size_t u=0; u<K; ++u) {
+                for (size_t v=u+1; v<K; ++v) {
+                    res(u,v) = res(v,u) = dist(u,v).d;
+                }
+            }
+
+            for (size_t u=0; u<n; ++u) {
+                if (P.i == u) continue;
+
+                Label l_u = P.label(u);
+                if (P.to != l_u) {
+                    FLOAT_T d = D(P.i, u);
+                    if (comparator(d, res(P.to, l_u)))
+                        res(P.to, l_u) = res(l_u, P.to) = d;
+                }
+            }
+        }
+
+        for (size_t u=0; u<K; ++u) {
+            for (size_t v=u+1; v<K; ++v) {
+                res(u,v) = sqrt(res(u,v));
+            }
+        }
+    }
+
 }; 
 
-class LowercaseDelta1Factory : public LowercaseDeltaFactory
+template<class Label>
+class LowercaseDelta1Factory : public LowercaseDeltaFactory<Label>
 {
 public:
     virtual bool IsCentroidNeeded() { return false; }
     
-    virtual LowercaseDelta* create(EuclideanDistance& D,
-           const matrix<FLOAT_T>& X,
-           std::vector<uint8_t>& L,
+    virtual LowercaseDelta<Label>* create(EuclideanDistance& D,
+           const matrix_view<FLOAT_T>& X,
+           std::vector<Label>& L,
            std::vector<size_t>& count,
-           uint8_t K,
+           size_t K,
            size_t n,
            size_t d,
            matrix<FLOAT_T>* centroids=nullptr) {
-               return new LowercaseDelta1(D, X, L, count, K, n, d, centroids);
+               return new LowercaseDelta1<Label>(D, X, L, count, K, n, d, centroids);
            }
 };
 
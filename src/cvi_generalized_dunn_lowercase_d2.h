@@ -19,24 +19,53 @@
 #include "cvi.h"
 #include "cvi_generalized_dunn_delta.h"
 
-class LowercaseDelta2 : public LowercaseDelta1
+template<class Label>
+class LowercaseDelta2 : public LowercaseDelta1<Label>
 {
+protected:
+    CVI_DELTA_MEMBERS(LowercaseDelta1<Label>)
+    using LowercaseDelta1<Label>::dist;
+    using LowercaseDelta1<Label>::comparator;
+
 public:
     LowercaseDelta2(
         EuclideanDistance& D,
-        const matrix<FLOAT_T>& X,
-        std::vector<uint8_t>& L,
+        const matrix_view<FLOAT_T>& X,
+        std::vector<Label>& L,
         std::vector<size_t>& count,
-        uint8_t K,
+        size_t K,
         size_t n,
         size_t d,
         matrix<FLOAT_T>* centroids=nullptr
         )
-    : LowercaseDelta1(D, X, L, count, K, n, d, centroids)
+    : LowercaseDelta1<Label>(D, X, L, count, K, n, d, centroids)
     { 
         comparator = std::greater<FLOAT_T>();
     }
 
+    LowercaseDelta2(
+        const LowercaseDelta2& other,
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids
+        )
+    : LowercaseDelta1<Label>(other, D, L, count, centroids)
+    { }
+
+    virtual LowercaseDelta<Label>* clone(
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids) const {
+            return new LowercaseDelta2<Label>(*this, D, L, count, centroids);
+        }
+
+    virtual FLOAT_T get_initial_dist() const { return 0.0; }
+
+    // the largest distance is not attained at an MST edge
+    virtual bool needs_mst() const { return false; }
+
     virtual void recompute_all() {
         for (size_t i=0; i<K; ++i) {
             for (size_t j=i+1; j<K; ++j) {
@@ -56,20 +85,21 @@ public:
     }
 }; 
 
-class LowercaseDelta2Factory : public LowercaseDeltaFactory
+template<class Label>
+class LowercaseDelta2Factory : public LowercaseDeltaFactory<Label>
 {
 public:
     virtual bool IsCentroidNeeded() { return false; }
     
-    virtual LowercaseDelta* create(EuclideanDistance& D,
-           const matrix<FLOAT_T>& X,
-           std::vector<uint8_t>& L,
+    virtual LowercaseDelta<Label>* create(EuclideanDistance& D,
+           const matrix_view<FLOAT_T>& X,
+           std::vector<Label>& L,
            std::vector<size_t>& count,
-           uint8_t K,
+           size_t K,
            size_t n,
            size_t d,
            matrix<FLOAT_T>* centroids=nullptr) {
-               return new LowercaseDelta2(D, X, L, count, K, n, d, centroids);
+               return new LowercaseDelta2<Label>(D, X, L, count, K, n, d, centroids);
            }
 };
 
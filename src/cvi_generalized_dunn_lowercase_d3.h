@@ -19,71 +19,147 @@
 #include "cvi.h"
 #include "cvi_generalized_dunn_delta.h"
 
-class LowercaseDelta3 : public LowercaseDelta
+template<class Label>
+class LowercaseDelta3 : public LowercaseDelta<Label>
 {
+protected:
+    CVI_DELTA_MEMBERS(LowercaseDelta<Label>)
+
 protected:
     matrix<FLOAT_T> dist_sums; /**< intra-cluster sums:
         dist(i,j) = min( X(u,), X(v,) ), X(u,) in C_i, X(v,) in C_j  (i!=j)
         */
-    matrix<FLOAT_T> last_dist_sums;      ///< for undo()
-    bool last_chg; ///< for undo() (was dist changed at all?)
+    UndoJournal<FLOAT_T> last_dist_sums; ///< changes to dist_sums, for undo()
 
 public:
     LowercaseDelta3(
         EuclideanDistance& D,
-        const matrix<FLOAT_T>& X,
-        std::vector<uint8_t>& L,
+        const matrix_view<FLOAT_T>& X,
+        std::vector<Label>& L,
         std::vector<size_t>& count,
-        uint8_t K,
+        size_t K,
         size_t n,
         size_t d,
         matrix<FLOAT_T>* centroids=nullptr
         )
-    : LowercaseDelta(D, X, L,count,K,n,d,centroids),
-    dist_sums(K, K),
-    last_dist_sums(K, K),
-    last_chg(false)
+    : LowercaseDelta<Label>(D, X, L,count,K,n,d,centroids),
+    dist_sums(K, K)
     { 
     }
-    virtual void before_modify(size_t i, uint8_t j) {
-        
-        for (size_t u=0; u<K; ++u) {
-            for (size_t v=u+1; v<K; ++v) {
-                last_dist_sums(u,v) = last_dist_sums(v,u) = dist_sums(u,v);
-            }
+    LowercaseDelta3(
+        const LowercaseDelta3& other,
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids
+        )
+    : LowercaseDelta<Label>(other, D, L, count, centroids),
+    dist_sums(other.dist_sums),
+    last_dist_sums(other.last_dist_sums)
+    { }
+
+    virtual LowercaseDelta<Label>* clone(
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids) const {
+            return new LowercaseDelta3<Label>(*this, D, L, count, centroids);
         }
 
+    virtual void before_modify(size_t i, size_t j) {
+        // only the sums involving the two affected clusters change
+        last_dist_sums.open(keep_journal);
+        last_dist_sums.log_rows_cols(dist_sums, L[i], j);
+
         // subtract a contribution of the point i to the old cluster L[i]        
+        std::vector<FLOAT_T> buf;
+        const FLOAT_T* Di = D.row(i, buf);
         for (size_t u=0; u<n; ++u) {
             if(L[i] != L[u])
             {
-                FLOAT_T d = sqrt(D(i, u));
+                FLOAT_T d = sqrt(Di[u]);
                 dist_sums(L[i], L[u]) = dist_sums(L[u], L[i]) = dist_sums(L[u], L[i]) - d;
             }
         }
-
-        last_chg = true;
-
     }
-    virtual void after_modify(size_t i, uint8_t j) {
+    virtual void after_modify(size_t i, size_t j) {
         // add a contribution of the point i to the new cluster L[i]
+        std::vector<FLOAT_T> buf;
+        const FLOAT_T* Di = D.row(i, buf);
         for (size_t u=0; u<n; ++u) {
             if(L[i] != L[u])
             {
-                FLOAT_T d = sqrt(D(i, u));
+                FLOAT_T d = sqrt(Di[u]);
                 dist_sums(L[i], L[u]) = dist_sums(L[u], L[i]) = dist_sums(L[u], L[i]) + d;
             }
         }
     }
-    virtual void undo() {
-        if (last_chg) {
-            for (size_t i=0; i<K; ++i) {
-                for (size_t j=i+1; j<K; ++j) {
-                    dist_sums(i,j) = dist_sums(j,i) = last_dist_sums(i,j);
+    virtual void before_swap(size_t i, size_t k) {
+        // only the sums involving the two affected clusters change
+        last_dist_sums.open(keep_journal);
+        last_dist_sums.log_rows_cols(dist_sums, L[i], L[k]);
+    }
+    virtual void after_swap(size_t i, size_t k) {
+        // the i-th point has moved from a to b, the k-th one from b to a;
+        // the distance between them still contributes to dist_sums(a, b)
+        Label a = L[k], b = L[i];
+        std::vector<FLOAT_T> buf_i, buf_k;
+        const FLOAT_T* Di = D.row(i, buf_i);
+        const FLOAT_T* Dk = D.row(k, buf_k);
+        for (size_t u=0; u<n; ++u) {
+            if (u == i || u == k) continue;
+            FLOAT_T d_i = sqrt(Di[u]);
+            FLOAT_T d_k = sqrt(Dk[u]);
+            Label c = L[u];
+            if (c != a) dist_sums(a, c) = dist_sums(c, a) = dist_sums(c, a) - d_i + d_k;
+            if (c != b) dist_sums(b, c) = dist_sums(c, b) = dist_sums(c, b) + d_i - d_k;
+        }
+    }
+    virtual void before_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        // only the sums involving the affected clusters change
+        mark_affected(idx, labels);
+        last_dist_sums.open(keep_journal);
+        for (size_t a=0; a<K; ++a) {
+            if (affected[a]) last_dist_sums.log_row_col(dist_sums, a);
+        }
+
+        // subtract the contributions of all the pairs involving
+        // the points being moved (each pair only once)
+        std::vector<bool> moved = get_moved(idx);
+        std::vector<FLOAT_T> buf;
+        for (size_t t=0; t<idx.size(); ++t) {
+            size_t i = idx[t];
+            const FLOAT_T* Di = D.row(i, buf);
+            for (size_t u=0; u<n; ++u) {
+                if (u == i || (moved[u] && u < i)) continue;
+                if (L[i] != L[u]) {
+                    FLOAT_T d = sqrt(Di[u]);
+                    dist_sums(L[i], L[u]) = dist_sums(L[u], L[i]) = dist_sums(L[u], L[i]) - d;
+                }
+            }
+        }
+    }
+    virtual void after_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        // add them back, taking into account the new labels
+        std::vector<bool> moved = get_moved(idx);
+        std::vector<FLOAT_T> buf;
+        for (size_t t=0; t<idx.size(); ++t) {
+            size_t i = idx[t];
+            const FLOAT_T* Di = D.row(i, buf);
+            for (size_t u=0; u<n; ++u) {
+                if (u == i || (moved[u] && u < i)) continue;
+                if (L[i] != L[u]) {
+                    FLOAT_T d = sqrt(Di[u]);
+                    dist_sums(L[i], L[u]) = dist_sums(L[u], L[i]) = dist_sums(L[u], L[i]) + d;
                 }
             }
         }
     }
+    virtual void undo() {
+        last_dist_sums.revert(dist_sums);
+    }
     virtual void recompute_all() {
         for (size_t i=0; i<K; ++i) {
             for (size_t j=i+1; j<K; ++j) {
@@ -91,9 +167,11 @@ public:
             }
         }
 
+        std::vector<FLOAT_T> buf;
         for (size_t i=0; i<n-1; ++i) {
+            const FLOAT_T* Di = D.row(i, buf, i+1);
             for (size_t j=i+1; j<n; ++j) {
-                FLOAT_T d = sqrt(D(i, j));
+                FLOAT_T d = sqrt(Di[j]);
                 if (L[i] != L[j]) {
                     dist_sums(L[i], L[j]) = dist_sums(L[j], L[i]) = dist_sums(L[j], L[i]) + d;
                 }
@@ -105,22 +183,52 @@ public:
         return dist_sums(k, l)/((FLOAT_T)count[k]*count[l]);
     }
 
+    virtual void compute_moved(const MovedPartitionView<Label>& P,
+        const MovedCentroidsView<Label>* C, matrix<FLOAT_T>& res) const
+    {
+        // the same as in before_modify() and after_modify()
+        matrix<FLOAT_T> sums(dist_sums);
+        std::vector<FLOAT_T> buf;
+        const FLOAT_T* Di = D.row(P.i, buf);
+        for (size_t u=0; u<n; ++u) {
+            if (P.from != L[u]) {
+                FLOAT_T d = sqrt(Di[u]);
+                sums(P.from, L[u]) = sums(L[u], P.from) = sums(L[u], P.from) - d;
+            }
+        }
+
+        for (size_t u=0; u<n; ++u) {
+            Label l_u = P.label(u);
+            if (P.to != l_u) {
+                FLOAT_T d = sqrt(Di[u]);
+                sums(P.to, l_u) = sums(l_u, P.to) = sums(l_u, P.to) + d;
+            }
+        }
+
+        for (size_t u=0; u<K; ++u) {
+            for (size_t v=u+1; v<K; ++v) {
+                res(u,v) = sums(u,v)/((FLOAT_T)P.size(u)*P.size(v));
+            }
+        }
+    }
+
 }; 
 
-class LowercaseDelta3Factory : public LowercaseDeltaFactory
+template<class Label>
+class LowercaseDelta3Factory : public LowercaseDeltaFactory<Label>
 {
 public:
     virtual bool IsCentroidNeeded() { return false; }
     
-    virtual LowercaseDelta* create(EuclideanDistance& D,
-           const matrix<FLOAT_T>& X,
-           std::vector<uint8_t>& L,
+    virtual LowercaseDelta<Label>* create(EuclideanDistance& D,
+           const matrix_view<FLOAT_T>& X,
+           std::vector<Label>& L,
            std::vector<size_t>& count,
-           uint8_t K,
+           size_t K,
            size_t n,
            size_t d,
            matrix<FLOAT_T>* centroids=nullptr) {
-               return new LowercaseDelta3(D, X, L, count, K, n, d, centroids);
+               return new LowercaseDelta3<Label>(D, X, L, count, K, n, d, centroids);
            }
 };
 
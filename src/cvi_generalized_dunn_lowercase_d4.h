@@ -19,26 +19,62 @@
 #include "cvi.h"
 #include "cvi_generalized_dunn_delta.h"
 
-class LowercaseDelta4 : public LowercaseDelta
+template<class Label>
+class LowercaseDelta4 : public LowercaseDelta<Label>
 {
+protected:
+    CVI_DELTA_MEMBERS(LowercaseDelta<Label>)
+
 public:
     LowercaseDelta4(
         EuclideanDistance& D,
-        const matrix<FLOAT_T>& X,
-        std::vector<uint8_t>& L,
+        const matrix_view<FLOAT_T>& X,
+        std::vector<Label>& L,
         std::vector<size_t>& count,
-        uint8_t K,
+        size_t K,
         size_t n,
         size_t d,
         matrix<FLOAT_T>* centroids=nullptr
         )
-    : LowercaseDelta(D, X, L, count,K,n,d,centroids)
+    : LowercaseDelta<Label>(D, X, L, count,K,n,d,centroids)
     { 
     }
-    virtual void before_modify(size_t i, uint8_t j) {
+    LowercaseDelta4(
+        const LowercaseDelta4& other,
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids
+        )
+    : LowercaseDelta<Label>(other, D, L, count, centroids)
+    { }
+
+    virtual LowercaseDelta<Label>* clone(
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids) const {
+            return new LowercaseDelta4<Label>(*this, D, L, count, centroids);
+        }
+
+    virtual void before_modify(size_t i, size_t j) {
         // all happens in CentroidsBasedIndex
     }
-    virtual void after_modify(size_t i, uint8_t j) {
+    virtual void after_modify(size_t i, size_t j) {
+        // all happens in CentroidsBasedIndex
+    }
+    virtual void before_swap(size_t i, size_t k) {
+        // all happens in CentroidsBasedIndex
+    }
+    virtual void after_swap(size_t i, size_t k) {
+        // all happens in CentroidsBasedIndex
+    }
+    virtual void before_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        // all happens in CentroidsBasedIndex
+    }
+    virtual void after_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
         // all happens in CentroidsBasedIndex
     }
     virtual void undo() {
@@ -56,22 +92,40 @@ public:
         return sqrt(act);
     }
 
+    virtual void compute_moved(const MovedPartitionView<Label>& P,
+        const MovedCentroidsView<Label>* C, matrix<FLOAT_T>& res) const
+    {
+        CVI_ASSERT(C);
+        for (size_t k=0; k<K; ++k) {
+            const FLOAT_T* c_k = C->centroid(k);
+            for (size_t l=k+1; l<K; ++l) {
+                const FLOAT_T* c_l = C->centroid(l);
+                FLOAT_T act = 0.0;
+                for (size_t u=0; u<d; ++u) {
+                    act += square(c_k[u] - c_l[u]);
+                }
+                res(k, l) = sqrt(act);
+            }
+        }
+    }
+
 }; 
 
-class LowercaseDelta4Factory : public LowercaseDeltaFactory
+template<class Label>
+class LowercaseDelta4Factory : public LowercaseDeltaFactory<Label>
 {
 public:
     virtual bool IsCentroidNeeded() { return true; }
     
-    virtual LowercaseDelta* create(EuclideanDistance& D,
-           const matrix<FLOAT_T>& X,
-           std::vector<uint8_t>& L,
+    virtual LowercaseDelta<Label>* create(EuclideanDistance& D,
+           const matrix_view<FLOAT_T>& X,
+           std::vector<Label>& L,
            std::vector<size_t>& count,
-           uint8_t K,
+           size_t K,
            size_t n,
            size_t d,
            matrix<FLOAT_T>* centroids=nullptr) {
-               return new LowercaseDelta4(D, X, L, count, K, n, d, centroids);
+               return new LowercaseDelta4<Label>(D, X, L, count, K, n, d, centroids);
            }
 };
 
@@ -19,12 +19,15 @@
 #include "cvi.h"
 #include "cvi_generalized_dunn_delta.h"
 
-class LowercaseDelta5 : public LowercaseDelta
+template<class Label>
+class LowercaseDelta5 : public LowercaseDelta<Label>
 {
+protected:
+    CVI_DELTA_MEMBERS(LowercaseDelta<Label>)
+
 protected:
     std::vector<double> dist_sums; ///< sum of points distances to centroid:
-    std::vector<double> last_dist_sums;      ///< for undo()
-    bool last_chg; ///< for undo() (was dist changed at all?)
+    UndoJournal<double> last_dist_sums; ///< changes to dist_sums, for undo()
 
     size_t cluster1;
     size_t cluster2;
@@ -32,32 +35,52 @@ protected:
 public:
     LowercaseDelta5(
         EuclideanDistance& D,
-        const matrix<FLOAT_T>& X,
-        std::vector<uint8_t>& L,
+        const matrix_view<FLOAT_T>& X,
+        std::vector<Label>& L,
         std::vector<size_t>& count,
-        uint8_t K,
+        size_t K,
         size_t n,
         size_t d,
         matrix<FLOAT_T>* centroids=nullptr
         )
-    : LowercaseDelta(D,X,L,count,K,n,d,centroids),
-    dist_sums(K),
-    last_dist_sums(K),
-    last_chg(false)
+    : LowercaseDelta<Label>(D,X,L,count,K,n,d,centroids),
+    dist_sums(K)
     {
     }
 
 
-    virtual void before_modify(size_t i, uint8_t j) {
-        last_chg = true;
-        for (size_t u=0; u<K; ++u) {
-                last_dist_sums[u] = dist_sums[u];
+    LowercaseDelta5(
+        const LowercaseDelta5& other,
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids
+        )
+    : LowercaseDelta<Label>(other, D, L, count, centroids),
+    dist_sums(other.dist_sums),
+    last_dist_sums(other.last_dist_sums),
+    cluster1(other.cluster1),
+    cluster2(other.cluster2)
+    { }
+
+    virtual LowercaseDelta<Label>* clone(
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids) const {
+            return new LowercaseDelta5<Label>(*this, D, L, count, centroids);
         }
 
+    virtual void before_modify(size_t i, size_t j) {
+        // only the sums of the two affected clusters change
+        last_dist_sums.open(keep_journal);
+        last_dist_sums.log(dist_sums, L[i]);
+        last_dist_sums.log(dist_sums, j);
+
 
         cluster1 = L[i];
 
-        // uint8_t cluster_index = L[i];
+        // Label cluster_index = L[i];
         // FLOAT_T act = 0.0;
         // for (size_t u=0; u<d; ++u) {
         //     act += square((*centroids)(cluster_index, u) - X(i, u));
@@ -67,8 +90,8 @@ public:
     }
 
 
-    virtual void after_modify(size_t i, uint8_t j) {
-        // uint8_t cluster_index = L[i];
+    virtual void after_modify(size_t i, size_t j) {
+        // Label cluster_index = L[i];
         // FLOAT_T act = 0.0;
         // for (size_t u=0; u<d; ++u) {
         //     act += square((*centroids)(cluster_index, u) - X(i, u));
@@ -83,7 +106,7 @@ public:
         dist_sums[cluster2] = 0;
 
         for (size_t i=0; i<n; ++i) {
-            uint8_t cluster_index = L[i];
+            Label cluster_index = L[i];
             if (cluster_index == cluster1 || cluster_index == cluster2) {
                 FLOAT_T act = 0.0;
                 for (size_t u=0; u<d; ++u) {
@@ -97,20 +120,61 @@ public:
     }
 
 
-    virtual void undo() {
-        if (last_chg) {
-            for (size_t i=0; i<K; ++i) {
-                dist_sums[i] = last_dist_sums[i];
+
+    virtual void before_swap(size_t i, size_t k) {
+        // only the sums of the two affected clusters change
+        last_dist_sums.open(keep_journal);
+        last_dist_sums.log(dist_sums, L[i]);
+        last_dist_sums.log(dist_sums, L[k]);
+
+        cluster1 = L[i];
+    }
+
+    virtual void after_swap(size_t i, size_t k) {
+        // recomputes the sums for cluster1 and L[i]
+        after_modify(i, L[i]);
+    }
+
+    virtual void before_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        // only the sums of the affected clusters change
+        mark_affected(idx, labels);
+        last_dist_sums.open(keep_journal);
+        for (size_t a=0; a<K; ++a) {
+            if (affected[a]) last_dist_sums.log(dist_sums, a);
+        }
+    }
+
+    virtual void after_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        // the centroids of the affected clusters have changed,
+        // their sums are recomputed in a single pass
+        for (size_t a=0; a<K; ++a) {
+            if (affected[a]) dist_sums[a] = 0;
+        }
+
+        for (size_t i=0; i<n; ++i) {
+            Label cluster_index = L[i];
+            if (affected[cluster_index]) {
+                FLOAT_T act = 0.0;
+                for (size_t u=0; u<d; ++u) {
+                    act += square((*centroids)(cluster_index, u) - X(i, u));
+                }
+                dist_sums[cluster_index] += sqrt(act);
             }
         }
     }
 
+    virtual void undo() {
+        last_dist_sums.revert(dist_sums);
+    }
+
 
     virtual void recompute_all() {
         std::fill(dist_sums.begin(), dist_sums.end(), 0);
 
         for (size_t i=0; i<n; ++i) {
-            uint8_t cluster_index = L[i];
+            Label cluster_index = L[i];
             FLOAT_T act = 0.0;
             for (size_t u=0; u<d; ++u) {
                 act += square((*centroids)(cluster_index, u) - X(i, u));
@@ -124,22 +188,53 @@ public:
     virtual FLOAT_T compute(size_t k, size_t l) {
         return (dist_sums[k]+dist_sums[l])/((FLOAT_T)count[k]+count[l]);
     }
+
+
+    virtual void compute_moved(const MovedPartitionView<Label>& P,
+        const MovedCentroidsView<Label>* C, matrix<FLOAT_T>& res) const
+    {
+        CVI_ASSERT(C);
+
+        // the same as in after_modify()
+        std::vector<double> sums(dist_sums);
+        sums[P.from] = 0;
+        sums[P.to] = 0;
+
+        for (size_t i=0; i<n; ++i) {
+            Label cluster_index = P.label(i);
+            if (cluster_index == P.from || cluster_index == P.to) {
+                const FLOAT_T* c = C->centroid(cluster_index);
+                FLOAT_T act = 0.0;
+                for (size_t u=0; u<d; ++u) {
+                    act += square(c[u] - X(i, u));
+                }
+                sums[cluster_index] += sqrt(act);
+            }
+        }
+
+        for (size_t k=0; k<K; ++k) {
+            for (size_t l=k+1; l<K; ++l) {
+                res(k, l) = (sums[k]+sums[l])/((FLOAT_T)P.size(k)+P.size(l));
+            }
+        }
+    }
 };
 
-class LowercaseDelta5Factory : public LowercaseDeltaFactory
+template<class Label>
+class LowercaseDelta5Factory : public LowercaseDeltaFactory<Label>
 {
 public:
     virtual bool IsCentroidNeeded() { return true; }
 
-    virtual LowercaseDelta* create(EuclideanDistance& D,
-           const matrix<FLOAT_T>& X,
-           std::vector<uint8_t>& L,
+    virtual LowercaseDelta<Label>* create(EuclideanDistance& D,
+           const matrix_view<FLOAT_T>& X,
+           std::vector<Label>& L,
            std::vector<size_t>& count,
-           uint8_t K,
+           size_t K,
            size_t n,
            size_t d,
            matrix<FLOAT_T>* centroids=nullptr) {
-               return new LowercaseDelta5(D, X, L, count, K, n, d, centroids);
+               return new LowercaseDelta5<Label>(D, X, L, count, K, n, d, centroids);
            }
 };
 
@@ -19,15 +19,18 @@
 #include "cvi.h"
 #include "cvi_generalized_dunn_delta.h"
 
-class LowercaseDelta6 : public LowercaseDelta
+template<class Label>
+class LowercaseDelta6 : public LowercaseDelta<Label>
 {
+protected:
+    CVI_DELTA_MEMBERS(LowercaseDelta<Label>)
+
 protected:
     matrix<DistTriple> dist; /**< intra-cluster distances:
         dist(i,j) = min( X(u,), X(v,) ), X(u,) in C_i, X(v,) in C_j  (i!=j)
         */
-    matrix<DistTriple> last_dist;      ///< for undo()
+    UndoJournal<DistTriple> last_dist; ///< changes to dist, for undo()
     std::vector<DistTriple> min_dists; ///< helper for calculating minimum distances to clusters for a single point
-    bool last_chg; ///< for undo() (was dist changed at all?)
     bool needs_recompute; ///< for before and after modify
     size_t cluster1;
     size_t cluster2;
@@ -35,41 +38,71 @@ protected:
 public:
     LowercaseDelta6(
         EuclideanDistance& D,
-        const matrix<FLOAT_T>& X,
-        std::vector<uint8_t>& L,
+        const matrix_view<FLOAT_T>& X,
+        std::vector<Label>& L,
         std::vector<size_t>& count,
-        uint8_t K,
+        size_t K,
         size_t n,
         size_t d,
         matrix<FLOAT_T>* centroids=nullptr
         )
-    : LowercaseDelta(D, X, L, count,K,n,d,centroids),
+    : LowercaseDelta<Label>(D, X, L, count,K,n,d,centroids),
     dist(K, K),
-    last_dist(K, K),
-    min_dists(K)
+    min_dists(K),
+    needs_recompute(false),
+    cluster1(0),
+    cluster2(0)
+    { }
+    LowercaseDelta6(
+        const LowercaseDelta6& other,
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids
+        )
+    : LowercaseDelta<Label>(other, D, L, count, centroids),
+    dist(other.dist),
+    last_dist(other.last_dist),
+    min_dists(other.min_dists),
+    needs_recompute(other.needs_recompute),
+    cluster1(other.cluster1),
+    cluster2(other.cluster2)
     { }
-    virtual void before_modify(size_t i, uint8_t j) {
+
+    virtual LowercaseDelta<Label>* clone(
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids) const {
+            return new LowercaseDelta6<Label>(*this, D, L, count, centroids);
+        }
+
+    virtual void before_modify(size_t i, size_t j) {
         needs_recompute = false;
         for (size_t u=0; u<K; ++u) {
             for (size_t v=u+1; v<K; ++v) {
                 // if the point being modified determines intra-cluster distance:
                 if (dist(u,v).i1 == i || dist(u,v).i2 == i)
                     needs_recompute = true;
-
-                last_dist(u,v) = last_dist(v,u) = dist(u,v);
             }
         }
 
         cluster1 = L[i];
+
+        // dist is not symmetric, hence all the changed elements
+        // (not just the upper triangle) are logged
+        last_dist.open(keep_journal);
+        if (needs_recompute)
+            last_dist.log_all(dist);
+        else
+            last_dist.log_rows_cols(dist, cluster1, j);
     }
-    virtual void after_modify(size_t i, uint8_t j) {
+    virtual void after_modify(size_t i, size_t j) {
         if (needs_recompute) {
-            last_chg = true;
             recompute_all();
         }
         else {
             //recompute_all();
-            last_chg = false;
             cluster2 = L[i];
             
             for (size_t i1=0; i1<K; ++i1) {
@@ -94,10 +127,9 @@ public:
                 }
 
                 // update maximum minimum distance on cluster level
-                for(uint8_t l=0; l<K; ++l) {
+                for (size_t l=0; l<K; ++l) {
                     if ( l != L[i1] && dist(L[i1],l).d < min_dists[l].d) {
                         dist(L[i1],l) = min_dists[l];
-                        last_chg = true;
                     }
                 }   
             }
@@ -116,27 +148,103 @@ public:
                 }
 
                 // update maximum minimum distance on cluster level
-                for(uint8_t l=0; l<K; ++l) {
+                for (size_t l=0; l<K; ++l) {
                     if (l != cluster1 && l != cluster2)
                         continue;
 
                     if ( l != L[i1] && dist(L[i1],l).d < min_dists[l].d) {
                         dist(L[i1],l) = min_dists[l];
-                        last_chg = true;
                     }
                 }   
             }
         }
     }
-    virtual void undo() {
-        if (last_chg) {
-            for (size_t i=0; i<K; ++i) {
-                for (size_t j=i+1; j<K; ++j) {
-                    dist(i,j) = dist(j,i) = last_dist(i,j);
+    virtual void before_swap(size_t i, size_t k) {
+        needs_recompute = false;
+        for (size_t u=0; u<K; ++u) {
+            for (size_t v=0; v<K; ++v) {
+                // if either point determines intra-cluster distance:
+                if (u != v && (dist(u,v).i1 == i || dist(u,v).i2 == i ||
+                        dist(u,v).i1 == k || dist(u,v).i2 == k))
+                    needs_recompute = true;
+            }
+        }
+
+        cluster1 = L[i];
+
+        last_dist.open(keep_journal);
+        if (needs_recompute)
+            last_dist.log_all(dist);
+        else
+            last_dist.log_rows_cols(dist, L[i], L[k]);
+    }
+    virtual void after_swap(size_t i, size_t k) {
+        // the distances from and to cluster1 and L[i] are
+        // determined from scratch
+        after_modify(i, L[i]);
+    }
+    virtual void before_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        // the entries not involving the affected clusters stay the same
+        mark_affected(idx, labels);
+        last_dist.open(keep_journal);
+        for (size_t a=0; a<K; ++a) {
+            if (affected[a]) last_dist.log_row_col(dist, a);
+        }
+    }
+    virtual void after_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        // the distances from and to the affected clusters
+        // are determined from scratch
+        for (size_t i1=0; i1<K; ++i1) {
+            for (size_t j=i1+1; j<K; ++j) {
+                if (affected[i1] || affected[j])
+                    dist(i1,j) = dist(j,i1) = DistTriple(0, 0, 0);
+            }
+        }
+
+        for (size_t i1=0; i1<n; ++i1) {
+            if (!affected[L[i1]])
+                continue;
+            // for every point i we find its minimum distance to every other cluster
+            std::fill(min_dists.begin(), min_dists.end(), DistTriple(0, 0, INFTY));
+            for (size_t j=0; j<n; ++j) {
+                if (L[i1] != L[j]) {
+                    FLOAT_T d = D(i1, j);
+                    if (d < min_dists[L[j]].d)
+                        min_dists[L[j]] = DistTriple(i1, j, d);
                 }
             }
+
+            // update maximum minimum distance on cluster level
+            for (size_t l=0; l<K; ++l) {
+                if (l != L[i1] && dist(L[i1],l).d < min_dists[l].d)
+                    dist(L[i1],l) = min_dists[l];
+            }
+        }
+
+        for (size_t i1=0; i1<n; ++i1) {
+            if (affected[L[i1]])
+                continue;  // already considered above
+            // minimum distances to the affected clusters only
+            std::fill(min_dists.begin(), min_dists.end(), DistTriple(0, 0, INFTY));
+            for (size_t j=0; j<n; ++j) {
+                if (affected[L[j]]) {
+                    FLOAT_T d = D(i1, j);
+                    if (d < min_dists[L[j]].d)
+                        min_dists[L[j]] = DistTriple(i1, j, d);
+                }
+            }
+
+            for (size_t l=0; l<K; ++l) {
+                if (affected[l] && dist(L[i1],l).d < min_dists[l].d)
+                    dist(L[i1],l) = min_dists[l];
+            }
         }
     }
+    virtual void undo() {
+        last_dist.revert(dist);
+    }
     virtual void recompute_all() {
         
         for (size_t i=0; i<K; ++i) {
@@ -158,7 +266,7 @@ public:
             }
 
             // update maximum minimum distance on cluster level
-            for(uint8_t l=0; l<K; ++l) {
+            for (size_t l=0; l<K; ++l) {
                 if ( l != L[i] && dist(L[i],l).d < min_dists[l].d) {
                     dist(L[i],l) = min_dists[l];
                 }
@@ -171,22 +279,68 @@ public:
         return sqrt(maxx);
     }
 
+    virtual void compute_moved(const MovedPartitionView<Label>& P,
+        const MovedCentroidsView<Label>* C, matrix<FLOAT_T>& res) const
+    {
+        // only the distances from and to the two affected clusters change
+        matrix<FLOAT_T> maxmin(K, K);
+        for (size_t k=0; k<K; ++k) {
+            for (size_t l=0; l<K; ++l) {
+                if (k == P.from || k == P.to || l == P.from || l == P.to)
+                    maxmin(k, l) = 0.0;
+                else
+                    maxmin(k, l) = dist(k, l).d;
+            }
+        }
+
+        std::vector<FLOAT_T> min_d(K);
+        for (size_t u=0; u<n; ++u) {
+            Label l_u = P.label(u);
+            bool u_affected = (l_u == P.from || l_u == P.to);
+
+            // the minimum distance from u to every other (affected) cluster
+            std::fill(min_d.begin(), min_d.end(), INFTY);
+            for (size_t v=0; v<n; ++v) {
+                Label l_v = P.label(v);
+                if (l_u == l_v) continue;
+                if (!u_affected && l_v != P.from && l_v != P.to) continue;
+                FLOAT_T d = D(u, v);
+                if (d < min_d[l_v])
+                    min_d[l_v] = d;
+            }
+
+            for (size_t l=0; l<K; ++l) {
+                if (l == l_u) continue;
+                if (!u_affected && l != P.from && l != P.to) continue;
+                if (maxmin(l_u, l) < min_d[l])
+                    maxmin(l_u, l) = min_d[l];
+            }
+        }
+
+        for (size_t k=0; k<K; ++k) {
+            for (size_t l=k+1; l<K; ++l) {
+                res(k, l) = sqrt(std::max(maxmin(k, l), maxmin(l, k)));
+            }
+        }
+    }
+
 }; 
 
-class LowercaseDelta6Factory : public LowercaseDeltaFactory
+template<class Label>
+class LowercaseDelta6Factory : public LowercaseDeltaFactory<Label>
 {
 public:
     virtual bool IsCentroidNeeded() { return false; }
     
-    virtual LowercaseDelta* create(EuclideanDistance& D,
-           const matrix<FLOAT_T>& X,
-           std::vector<uint8_t>& L,
+    virtual LowercaseDelta<Label>* create(EuclideanDistance& D,
+           const matrix_view<FLOAT_T>& X,
+           std::vector<Label>& L,
            std::vector<size_t>& count,
-           uint8_t K,
+           size_t K,
            size_t n,
            size_t d,
            matrix<FLOAT_T>* centroids=nullptr) {
-               return new LowercaseDelta6(D, X, L, count, K, n, d, centroids);
+               return new LowercaseDelta6<Label>(D, X, L, count, K, n, d, centroids);
            }
 };
 
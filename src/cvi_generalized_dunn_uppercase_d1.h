@@ -19,79 +19,167 @@
 #include "cvi.h"
 #include "cvi_generalized_dunn_delta.h"
 
-class UppercaseDelta1 : public UppercaseDelta
+template<class Label>
+class UppercaseDelta1 : public UppercaseDelta<Label>
 {
+protected:
+    CVI_DELTA_MEMBERS(UppercaseDelta<Label>)
+
 protected:
     std::vector<DistTriple> diam; /**< cluster diameters:
         diam[i] = max( X(u,), X(v,) ), X(u,), X(v,) in C_i
         */
-    std::vector<DistTriple> last_diam; ///< for undo()
-    bool last_chg; ///< for undo() (was diam changed at all?)
+    UndoJournal<DistTriple> last_diam; ///< changes to diam, for undo()
     bool needs_recompute; ///< for before and after modify
+
+    /** Takes into account the distance d between the i-th and the u-th point
+     *  (the former has just changed its label) in diam; logs the changes
+     */
+    void update_diam(size_t i, size_t u, FLOAT_T d) {
+        if (i == u) return;
+
+        if (L[i] == L[u]) {
+            if (d > diam[L[i]].d) {
+                last_diam.log(diam, L[i]);
+                diam[L[i]] = DistTriple(i, u, d);
+            }
+        }
+    }
 public:
     UppercaseDelta1(
         EuclideanDistance& D,
-        const matrix<FLOAT_T>& X,
-        std::vector<uint8_t>& L,
+        const matrix_view<FLOAT_T>& X,
+        std::vector<Label>& L,
         std::vector<size_t>& count,
-        uint8_t K,
+        size_t K,
         size_t n,
         size_t d,
         matrix<FLOAT_T>* centroids=nullptr
         )
-    : UppercaseDelta(D,X,L,count,K,n,d,centroids),
+    : UppercaseDelta<Label>(D,X,L,count,K,n,d,centroids),
     diam(K),
-    last_diam(K)
+    needs_recompute(false)
     { }
-    virtual void before_modify(size_t i, uint8_t j) {
+    UppercaseDelta1(
+        const UppercaseDelta1& other,
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids
+        )
+    : UppercaseDelta<Label>(other, D, L, count, centroids),
+    diam(other.diam),
+    last_diam(other.last_diam),
+    needs_recompute(other.needs_recompute)
+    { }
+
+    virtual UppercaseDelta<Label>* clone(
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids) const {
+            return new UppercaseDelta1<Label>(*this, D, L, count, centroids);
+        }
+
+    virtual void before_modify(size_t i, size_t j) {
         needs_recompute = false;
         for (size_t u=0; u<K; ++u) {
-            last_diam[u] = diam[u];
-
             // if the point being modified determines its cluster's diameter:
             if (diam[u].i1 == i || diam[u].i2 == i)
                 needs_recompute = true;
         }
 
+        last_diam.open(keep_journal);
     }
 
-    virtual void after_modify(size_t i, uint8_t j) {
+    virtual void after_modify(size_t i, size_t j) {
         if (needs_recompute) {
-            last_chg = true;
+            for (size_t u=0; u<K; ++u)
+                last_diam.log(diam, u);
             recompute_all();
         }
         else {
-            last_chg = false;
+            std::vector<FLOAT_T> buf;
+            const FLOAT_T* Di = D.row(i, buf);
+            for (size_t u=0; u<n; ++u)
+                update_diam(i, u, Di[u]);
+        }
+    }
+
+    virtual void before_swap(size_t i, size_t k) {
+        needs_recompute = false;
+        for (size_t u=0; u<K; ++u) {
+            // if either point determines its cluster's diameter:
+            if (diam[u].i1 == i || diam[u].i2 == i ||
+                    diam[u].i1 == k || diam[u].i2 == k)
+                needs_recompute = true;
+        }
+
+        last_diam.open(keep_journal);
+    }
+
+    virtual void after_swap(size_t i, size_t k) {
+        if (needs_recompute) {
+            for (size_t u=0; u<K; ++u)
+                last_diam.log(diam, u);
+            recompute_all();
+        }
+        else {
+            // only the pairs involving the two points need to be inspected
+            std::vector<FLOAT_T> buf_i, buf_k;
+            const FLOAT_T* Di = D.row(i, buf_i);
+            const FLOAT_T* Dk = D.row(k, buf_k);
             for (size_t u=0; u<n; ++u) {
-                if (i == u) continue;
-
-                FLOAT_T d = D(i, u);
-                if (L[i] == L[u]) {
-                    if (d > diam[L[i]].d) {
-                        diam[L[i]] = DistTriple(i, u, d);
-                        last_chg = true;
-                    }
-                }
+                update_diam(i, u, Di[u]);
+                update_diam(k, u, Dk[u]);
             }
         }
     }
 
-    virtual void undo(){
-        if (last_chg) {
-            for (size_t i=0; i<K; ++i) {
-                diam[i] = last_diam[i];
+    virtual void before_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        std::vector<bool> moved = get_moved(idx);
+        needs_recompute = false;
+        for (size_t u=0; u<K; ++u) {
+            // if a point being moved determines its cluster's diameter:
+            if (moved[diam[u].i1] || moved[diam[u].i2])
+                needs_recompute = true;
+        }
+
+        last_diam.open(keep_journal);
+    }
+
+    virtual void after_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        if (needs_recompute) {
+            for (size_t u=0; u<K; ++u)
+                last_diam.log(diam, u);
+            recompute_all();
+        }
+        else {
+            std::vector<FLOAT_T> buf;
+            for (size_t t=0; t<idx.size(); ++t) {
+                const FLOAT_T* Di = D.row(idx[t], buf);
+                for (size_t u=0; u<n; ++u)
+                    update_diam(idx[t], u, Di[u]);
             }
         }
     }
 
+    virtual void undo(){
+        last_diam.revert(diam);
+    }
+
     virtual void recompute_all(){
         for (size_t i=0; i<K; ++i) {
             diam[i] = DistTriple(0, 0, 0.0);
         }
 
+        std::vector<FLOAT_T> buf;
         for (size_t i=0; i<n-1; ++i) {
+            const FLOAT_T* Di = D.row(i, buf, i+1);
             for (size_t j=i+1; j<n; ++j) {
-                double d = D(i, j);
+                double d = Di[j];
                 if (L[i] == L[j]) {
                     if (d > diam[L[i]].d)
                         diam[L[i]] = DistTriple(i, j, d);
@@ -103,23 +191,59 @@ public:
     virtual FLOAT_T compute(size_t k){
         return sqrt(diam[k].d);
     }
+
+    virtual void compute_moved(const MovedPartitionView<Label>& P,
+        const MovedCentroidsView<Label>* C, std::vector<FLOAT_T>& res) const
+    {
+        for (size_t k=0; k<K; ++k)
+            res[k] = diam[k].d;
+
+        // if the point being moved determines its cluster's diameter,
+        // the diameter must be determined from scratch
+        if (diam[P.from].i1 == P.i || diam[P.from].i2 == P.i) {
+            std::vector<size_t> members;
+            for (size_t u=0; u<n; ++u)
+                if (P.label(u) == P.from) members.push_back(u);
+
+            res[P.from] = 0.0;
+            for (size_t u=0; u+1<members.size(); ++u) {
+                for (size_t v=u+1; v<members.size(); ++v) {
+                    FLOAT_T d = D(members[u], members[v]);
+                    if (d > res[P.from])
+                        res[P.from] = d;
+                }
+            }
+        }
+
+        for (size_t u=0; u<n; ++u) {
+            if (P.i == u || P.label(u) != P.to) continue;
+
+            FLOAT_T d = D(P.i, u);
+            if (d > res[P.to])
+                res[P.to] = d;
+        }
+
+        for (size_t k=0; k<K; ++k)
+            res[k] = sqrt(res[k]);
+    }
 };
 
 
-class UppercaseDelta1Factory : public UppercaseDeltaFactory
+template<class Label>
+class UppercaseDelta1Factory : public UppercaseDeltaFactory<Label>
 {
 public:
     virtual bool IsCentroidNeeded() { return false; }
     
-    virtual UppercaseDelta* create(EuclideanDistance& D,
-           const matrix<FLOAT_T>& X,
-           std::vector<uint8_t>& L,
+    virtual UppercaseDelta<Label>* create(EuclideanDistance& D,
+           const matrix_view<FLOAT_T>& X,
+           std::vector<Label>& L,
            std::vector<size_t>& count,
-           uint8_t K,
+           size_t K,
            size_t n,
            size_t d,
            matrix<FLOAT_T>* centroids=nullptr) {
-               return new UppercaseDelta1(D, X, L, count, K, n, d, centroids);
+               return new UppercaseDelta1<Label>(D, X, L, count, K, n, d, centroids);
            }
 };
 
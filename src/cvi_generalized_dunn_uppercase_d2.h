@@ -19,33 +19,55 @@
 #include "cvi.h"
 #include "cvi_generalized_dunn_delta.h"
 
-class UppercaseDelta2 : public UppercaseDelta
+template<class Label>
+class UppercaseDelta2 : public UppercaseDelta<Label>
 {
+protected:
+    CVI_DELTA_MEMBERS(UppercaseDelta<Label>)
+
 protected:
     std::vector<double> dist_sums; ///< sum of points distances to centroid:
-    std::vector<double> last_dist_sums;      ///< for undo()
-    bool last_chg; ///< for undo() (was dist changed at all?)
+    UndoJournal<double> last_dist_sums; ///< changes to dist_sums, for undo()
 public:
     UppercaseDelta2(
         EuclideanDistance& D,
-        const matrix<FLOAT_T>& X,
-        std::vector<uint8_t>& L,
+        const matrix_view<FLOAT_T>& X,
+        std::vector<Label>& L,
         std::vector<size_t>& count,
-        uint8_t K,
+        size_t K,
         size_t n,
         size_t d,
         matrix<FLOAT_T>* centroids=nullptr
         )
-    : UppercaseDelta(D,X,L,count,K,n,d,centroids),
-    dist_sums(K),
-    last_dist_sums(K),
-    last_chg(false)
+    : UppercaseDelta<Label>(D,X,L,count,K,n,d,centroids),
+    dist_sums(K)
     { }
-    virtual void before_modify(size_t i, uint8_t j) {
-        for (size_t u=0; u<K; ++u) {
-            last_dist_sums[u] = dist_sums[u];
+    UppercaseDelta2(
+        const UppercaseDelta2& other,
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids
+        )
+    : UppercaseDelta<Label>(other, D, L, count, centroids),
+    dist_sums(other.dist_sums),
+    last_dist_sums(other.last_dist_sums)
+    { }
+
+    virtual UppercaseDelta<Label>* clone(
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids) const {
+            return new UppercaseDelta2<Label>(*this, D, L, count, centroids);
         }
 
+    virtual void before_modify(size_t i, size_t j) {
+        // only the sums of the two affected clusters change
+        last_dist_sums.open(keep_journal);
+        last_dist_sums.log(dist_sums, L[i]);
+        last_dist_sums.log(dist_sums, j);
+
         // subtract a contribution of the point i to the old cluster L[i]        
         for (size_t u=0; u<n; ++u) {
             if(L[i] == L[u] && i != u)
@@ -55,10 +77,9 @@ public:
             }
         }
 
-        last_chg = true;
     }
 
-    virtual void after_modify(size_t i, uint8_t j) {
+    virtual void after_modify(size_t i, size_t j) {
         // add a contribution of the point i to the new cluster L[i]        
         for (size_t u=0; u<n; ++u) {
             if(L[i] == L[u] && i != u)
@@ -69,21 +90,74 @@ public:
         }
     }
 
-    virtual void undo(){
-        if (last_chg) {
-            for (size_t i=0; i<K; ++i) {
-                dist_sums[i] = last_dist_sums[i];
+    virtual void before_swap(size_t i, size_t k) {
+        // only the sums of the two affected clusters change
+        last_dist_sums.open(keep_journal);
+        last_dist_sums.log(dist_sums, L[i]);
+        last_dist_sums.log(dist_sums, L[k]);
+    }
+
+    virtual void after_swap(size_t i, size_t k) {
+        // the i-th point has moved from a to b, the k-th one from b to a
+        Label a = L[k], b = L[i];
+        for (size_t u=0; u<n; ++u) {
+            if (u == i || u == k) continue;
+            if (L[u] == a)
+                dist_sums[a] += sqrt(D(k, u)) - sqrt(D(i, u));
+            else if (L[u] == b)
+                dist_sums[b] += sqrt(D(i, u)) - sqrt(D(k, u));
+        }
+    }
+
+    virtual void before_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        // only the sums of the affected clusters change
+        mark_affected(idx, labels);
+        last_dist_sums.open(keep_journal);
+        for (size_t a=0; a<K; ++a) {
+            if (affected[a]) last_dist_sums.log(dist_sums, a);
+        }
+
+        // subtract the contributions of all the pairs involving
+        // the points being moved (each pair only once)
+        std::vector<bool> moved = get_moved(idx);
+        for (size_t t=0; t<idx.size(); ++t) {
+            size_t i = idx[t];
+            for (size_t u=0; u<n; ++u) {
+                if (u == i || (moved[u] && u < i)) continue;
+                if (L[i] == L[u])
+                    dist_sums[L[i]] -= sqrt(D(i, u));
             }
         }
     }
 
+    virtual void after_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        // add them back, taking into account the new labels
+        std::vector<bool> moved = get_moved(idx);
+        for (size_t t=0; t<idx.size(); ++t) {
+            size_t i = idx[t];
+            for (size_t u=0; u<n; ++u) {
+                if (u == i || (moved[u] && u < i)) continue;
+                if (L[i] == L[u])
+                    dist_sums[L[i]] += sqrt(D(i, u));
+            }
+        }
+    }
+
+    virtual void undo(){
+        last_dist_sums.revert(dist_sums);
+    }
+
     virtual void recompute_all(){
         std::fill(dist_sums.begin(), dist_sums.end(), 0);
 
         // UNKNOWN: do we take (i,j) and (j,i)? Or only one (i,j)?
+        std::vector<FLOAT_T> buf;
         for (size_t i=0; i<n-1; ++i) {
+            const FLOAT_T* Di = D.row(i, buf, i+1);
             for (size_t j=i+1; j<n; ++j) {
-                FLOAT_T d = sqrt(D(i, j));
+                FLOAT_T d = sqrt(Di[j]);
                 if (L[i] == L[j]) {
                     dist_sums[L[i]] += d;
                 }
@@ -94,23 +168,43 @@ public:
     virtual FLOAT_T compute(size_t k){
         return (dist_sums[k])/((FLOAT_T)count[k]*(count[k]-1));
     }
+
+    virtual void compute_moved(const MovedPartitionView<Label>& P,
+        const MovedCentroidsView<Label>* C, std::vector<FLOAT_T>& res) const
+    {
+        // the same as in before_modify() and after_modify()
+        std::vector<double> sums(dist_sums);
+        for (size_t u=0; u<n; ++u) {
+            if (P.from == L[u] && P.i != u)
+                sums[P.from] -= sqrt(D(P.i, u));
+        }
+
+        for (size_t u=0; u<n; ++u) {
+            if (P.to == P.label(u) && P.i != u)
+                sums[P.to] += sqrt(D(P.i, u));
+        }
+
+        for (size_t k=0; k<K; ++k)
+            res[k] = (sums[k])/((FLOAT_T)P.size(k)*(P.size(k)-1));
+    }
 };
 
 
-class UppercaseDelta2Factory : public UppercaseDeltaFactory
+template<class Label>
+class UppercaseDelta2Factory : public UppercaseDeltaFactory<Label>
 {
 public:
     virtual bool IsCentroidNeeded() { return false; }
     
-    virtual UppercaseDelta* create(EuclideanDistance& D,
-           const matrix<FLOAT_T>& X,
-           std::vector<uint8_t>& L,
+    virtual UppercaseDelta<Label>* create(EuclideanDistance& D,
+           const matrix_view<FLOAT_T>& X,
+           std::vector<Label>& L,
            std::vector<size_t>& count,
-           uint8_t K,
+           size_t K,
            size_t n,
            size_t d,
            matrix<FLOAT_T>* centroids=nullptr) {
-               return new UppercaseDelta2(D, X, L, count, K, n, d, centroids);
+               return new UppercaseDelta2<Label>(D, X, L, count, K, n, d, centroids);
            }
 };
 
@@ -19,39 +19,62 @@
 #include "cvi.h"
 #include "cvi_generalized_dunn_delta.h"
 
-class UppercaseDelta3 : public UppercaseDelta
+template<class Label>
+class UppercaseDelta3 : public UppercaseDelta<Label>
 {
+protected:
+    CVI_DELTA_MEMBERS(UppercaseDelta<Label>)
+
 protected:
     std::vector<double> dist_sums; ///< sum of points distances to centroid:
-    std::vector<double> last_dist_sums;      ///< for undo()
-    bool last_chg; ///< for undo() (was dist changed at all?)
+    UndoJournal<double> last_dist_sums; ///< changes to dist_sums, for undo()
     size_t cluster1;
     size_t cluster2;
 public:
     UppercaseDelta3(
         EuclideanDistance& D,
-        const matrix<FLOAT_T>& X,
-        std::vector<uint8_t>& L,
+        const matrix_view<FLOAT_T>& X,
+        std::vector<Label>& L,
         std::vector<size_t>& count,
-        uint8_t K,
+        size_t K,
         size_t n,
         size_t d,
         matrix<FLOAT_T>* centroids=nullptr
         )
-    : UppercaseDelta(D,X,L,count,K,n,d,centroids),
-    dist_sums(K),
-    last_dist_sums(K),
-    last_chg(false)
+    : UppercaseDelta<Label>(D,X,L,count,K,n,d,centroids),
+    dist_sums(K)
     { }
-    virtual void before_modify(size_t i, uint8_t j) {
-        last_chg = true;
-        for (size_t u=0; u<K; ++u) {
-                last_dist_sums[u] = dist_sums[u];
+    UppercaseDelta3(
+        const UppercaseDelta3& other,
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids
+        )
+    : UppercaseDelta<Label>(other, D, L, count, centroids),
+    dist_sums(other.dist_sums),
+    last_dist_sums(other.last_dist_sums),
+    cluster1(other.cluster1),
+    cluster2(other.cluster2)
+    { }
+
+    virtual UppercaseDelta<Label>* clone(
+        EuclideanDistance& D,
+        std::vector<Label>& L,
+        std::vector<size_t>& count,
+        matrix<FLOAT_T>* centroids) const {
+            return new UppercaseDelta3<Label>(*this, D, L, count, centroids);
         }
 
+    virtual void before_modify(size_t i, size_t j) {
+        // only the sums of the two affected clusters change
+        last_dist_sums.open(keep_journal);
+        last_dist_sums.log(dist_sums, L[i]);
+        last_dist_sums.log(dist_sums, j);
+
         cluster1 = L[i];
 
-        // uint8_t cluster_index = L[i];
+        // Label cluster_index = L[i];
         // FLOAT_T act = 0.0;
         // for (size_t u=0; u<d; ++u) {
         //     act += square((*centroids)(cluster_index, u) - X(i, u));
@@ -60,8 +83,8 @@ public:
         // dist_sums[cluster_index] -= d;
     }
 
-    virtual void after_modify(size_t i, uint8_t j) {
-        // uint8_t cluster_index = L[i];
+    virtual void after_modify(size_t i, size_t j) {
+        // Label cluster_index = L[i];
         // FLOAT_T act = 0.0;
         // for (size_t u=0; u<d; ++u) {
         //     act += square((*centroids)(cluster_index, u) - X(i, u));
@@ -75,7 +98,7 @@ public:
         dist_sums[cluster2] = 0;
 
         for (size_t i=0; i<n; ++i) {
-            uint8_t cluster_index = L[i];
+            Label cluster_index = L[i];
             if (cluster_index == cluster1 || cluster_index == cluster2) {
                 FLOAT_T act = 0.0;
                 for (size_t u=0; u<d; ++u) {
@@ -88,14 +111,55 @@ public:
 
     }
 
-    virtual void undo(){
-        if (last_chg) {
-            for (size_t i=0; i<K; ++i) {
-                dist_sums[i] = last_dist_sums[i];
+
+    virtual void before_swap(size_t i, size_t k) {
+        // only the sums of the two affected clusters change
+        last_dist_sums.open(keep_journal);
+        last_dist_sums.log(dist_sums, L[i]);
+        last_dist_sums.log(dist_sums, L[k]);
+
+        cluster1 = L[i];
+    }
+
+    virtual void after_swap(size_t i, size_t k) {
+        // recomputes the sums for cluster1 and L[i]
+        after_modify(i, L[i]);
+    }
+
+    virtual void before_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        // only the sums of the affected clusters change
+        mark_affected(idx, labels);
+        last_dist_sums.open(keep_journal);
+        for (size_t a=0; a<K; ++a) {
+            if (affected[a]) last_dist_sums.log(dist_sums, a);
+        }
+    }
+
+    virtual void after_modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels) {
+        // the centroids of the affected clusters have changed,
+        // their sums are recomputed in a single pass
+        for (size_t a=0; a<K; ++a) {
+            if (affected[a]) dist_sums[a] = 0;
+        }
+
+        for (size_t i=0; i<n; ++i) {
+            Label cluster_index = L[i];
+            if (affected[cluster_index]) {
+                FLOAT_T act = 0.0;
+                for (size_t u=0; u<d; ++u) {
+                    act += square((*centroids)(cluster_index, u) - X(i, u));
+                }
+                dist_sums[cluster_index] += sqrt(act);
             }
         }
     }
 
+    virtual void undo(){
+        last_dist_sums.revert(dist_sums);
+    }
+
     virtual void recompute_all(){
         // Rcpp::Rcout << "before fill"<< std::endl;
         std::fill(dist_sums.begin(), dist_sums.end(), 0);
@@ -105,7 +169,7 @@ public:
         // Rcpp::Rcout << "centroids[0][0] = " << (*centroids)(0,0) << std::endl;
 
         for (size_t i=0; i<n; ++i) {
-            uint8_t cluster_index = L[i];
+            Label cluster_index = L[i];
             FLOAT_T act = 0.0;
             for (size_t u=0; u<d; ++u) {
                 act += square((*centroids)(cluster_index, u) - X(i, u));
@@ -118,23 +182,50 @@ public:
     virtual FLOAT_T compute(size_t k){
         return 2.0*(dist_sums[k])/(count[k]);
     }
+
+    virtual void compute_moved(const MovedPartitionView<Label>& P,
+        const MovedCentroidsView<Label>* C, std::vector<FLOAT_T>& res) const
+    {
+        CVI_ASSERT(C);
+
+        // the same as in after_modify()
+        std::vector<double> sums(dist_sums);
+        sums[P.from] = 0;
+        sums[P.to] = 0;
+
+        for (size_t i=0; i<n; ++i) {
+            Label cluster_index = P.label(i);
+            if (cluster_index == P.from || cluster_index == P.to) {
+                const FLOAT_T* c = C->centroid(cluster_index);
+                FLOAT_T act = 0.0;
+                for (size_t u=0; u<d; ++u) {
+                    act += square(c[u] - X(i, u));
+                }
+                sums[cluster_index] += sqrt(act);
+            }
+        }
+
+        for (size_t k=0; k<K; ++k)
+            res[k] = 2.0*(sums[k])/(P.size(k));
+    }
 };
 
 
-class UppercaseDelta3Factory : public UppercaseDeltaFactory
+template<class Label>
+class UppercaseDelta3Factory : public UppercaseDeltaFactory<Label>
 {
 public:
     virtual bool IsCentroidNeeded() { return true; }
     
-    virtual UppercaseDelta* create(EuclideanDistance& D,
-           const matrix<FLOAT_T>& X,
-           std::vector<uint8_t>& L,
+    virtual UppercaseDelta<Label>* create(EuclideanDistance& D,
+           const matrix_view<FLOAT_T>& X,
+           std::vector<Label>& L,
            std::vector<size_t>& count,
-           uint8_t K,
+           size_t K,
            size_t n,
            size_t d,
            matrix<FLOAT_T>* centroids=nullptr) {
-               return new UppercaseDelta3(D, X, L, count, K, n, d, centroids);
+               return new UppercaseDelta3<Label>(D, X, L, count, K, n, d, centroids);
            }
 };
 
@@ -38,124 +38,501 @@
  *  1987, pp. 53-65, doi:10.1016/0377-0427(87)90125-7.
  *
  */
-class SilhouetteIndex : public ClusterValidityIndex
+template<class Label>
+class SilhouetteIndex : public LabelledIndex<Label>
 {
 protected:
-    std::vector<FLOAT_T> A; ///< cluster "radius"
-    std::vector<FLOAT_T> B; ///< distance to "nearest" cluster
+    CVI_LABELLED_INDEX_MEMBERS(LabelledIndex<Label>)
+
     matrix<FLOAT_T> C;      ///< auxiliary array; Let C(i,j) == sum of
                 ///< distances between X(i,:) and all points in the j-th cluster
     EuclideanDistance D;    ///< D(i, j) gives the Euclidean distance
                 ///< between X(i,:) and X(j,:) /can be precomputed for speed/
     bool widths;
 
+    std::vector<FLOAT_T> nearest_dist; ///< b(u) = min_{k != L[u]} C(u,k)/count[k]
+    std::vector<Label> nearest;        ///< the k at which b(u) is attained
+    FLOAT_T cur_sum;                   ///< sum of the scores, see add_score()
+    size_t cur_singletons;             ///< number of points in singleton clusters
+
+
+    /** Gives C(u,k) for the current partition
+     */
+    struct CurrentSums
+    {
+        const matrix<FLOAT_T>& C;
+
+        CurrentSums(const matrix<FLOAT_T>& _C) : C(_C) { }
+
+        inline FLOAT_T operator()(size_t u, size_t k) const { return C(u, k); }
+    };
+
+
+    /** Gives C(u,k) for the partition after a move, updated as in modify()
+     */
+    struct MovedSums
+    {
+        const matrix<FLOAT_T>& C;
+        const MovedPartitionView<Label>& P;
+        std::vector<FLOAT_T> buf;
+        const FLOAT_T* dist_i;  ///< dist_i[u] = D(P.i, u)
+
+        MovedSums(const matrix<FLOAT_T>& _C, const MovedPartitionView<Label>& _P,
+                const EuclideanDistance& D)
+            : C(_C), P(_P), dist_i(D.row(P.i, buf))
+        { }
+
+        inline FLOAT_T operator()(size_t u, size_t k) const {
+            if (k == P.from) return C(u, k)-dist_i[u];
+            else if (k == P.to) return C(u, k)+dist_i[u];
+            else return C(u, k);
+        }
+    };
+
+
+    /** Computes the index for a given partition
+     *  (PartitionView<Label> with CurrentSums or MovedPartitionView<Label> with MovedSums)
+     */
+    template<class Partition, class Sums>
+    FLOAT_T compute_for(const Partition& P, const Sums& S) const
+    {
+        // compute the mean of silhouette scores of each point
+        FLOAT_T ret = 0.0;
+        size_t num_singletons = 0;
+        for (size_t i=0; i<n; ++i) {
+            // Let S(i,j) == sum of distances between X(i,) and all points in the j-th cluster
+            Label l = P.label(i);
+            FLOAT_T a = 0.0;    // cluster "radius"
+            FLOAT_T b = INFTY;  // distance to "nearest" cluster
+            for (size_t j=0; j<K; ++j) {
+                if (j == l) {
+                    a = S(i,j)/(FLOAT_T)(P.size(j)-1);
+                }
+                else {
+                    if (S(i,j)/(FLOAT_T)(P.size(j)) < b)
+                        b = S(i,j)/(FLOAT_T)(P.size(j));
+                }
+            }
+
+            add_score(ret, num_singletons, a, b, P.size(l));
+        }
+
+        if (widths)
+            ret = ret/(FLOAT_T)(K-num_singletons);
+        else
+            ret = ret/(FLOAT_T)n;
+
+        CVI_ASSERT(std::fabs(ret) < 1.0+1e-12);
+
+        return ret;
+    }
+
+
+    /** Adds a point's silhouette score to the sum, see compute_for()
+     */
+    inline void add_score(FLOAT_T& ret, size_t& num_singletons,
+        FLOAT_T a, FLOAT_T b, size_t size) const
+    {
+        if (size > 1) { // silhouette score of 0 for singleton clusters
+            FLOAT_T cur = (b-a)/std::max(b, a);
+            if (widths)
+                ret += cur/(FLOAT_T)size;
+            else
+                ret += cur;
+        }
+        else
+            num_singletons++;
+    }
+
+
+    /** Determines nearest_dist[u] and nearest[u] from scratch, in O(K) time
+     */
+    inline void rescan_nearest(size_t u)
+    {
+        Label l = L[u];
+        nearest_dist[u] = INFTY;
+        nearest[u] = l;
+        for (size_t k=0; k<K; ++k) {
+            if (k == l) continue;
+            if (C(u,k)/(FLOAT_T)(count[k]) < nearest_dist[u]) {
+                nearest_dist[u] = C(u,k)/(FLOAT_T)(count[k]);
+                nearest[u] = (Label)k;
+            }
+        }
+    }
+
+
+    /** Updates nearest_dist and nearest and recomputes cur_sum and
+     *  cur_singletons (which compute() relies upon) after C(:,k1) and C(:,k2) and the
+     *  sizes of these two clusters have changed, and the labels
+     *  of the i1-th and the i2-th point have changed.
+     *
+     *  For most points, the nearest cluster is determined in O(1) time:
+     *  only if it was k1 or k2 and it is now farther away, all the
+     *  clusters must be scanned again.  The scores are summed up in
+     *  the same order as in compute_for(), so the results are the same.
+     *
+     *  If k1 == K, all the nearest clusters are determined from scratch.
+     */
+    void update_scores(size_t k1=0, size_t k2=0, size_t i1=0, size_t i2=0)
+    {
+        const bool full = (k1 == K);
+        cur_sum = 0.0;
+        cur_singletons = 0;
+        for (size_t u=0; u<n; ++u) {
+            Label l = L[u];
+            if (full || u == i1 || u == i2)
+                rescan_nearest(u);
+            else {
+                // the smallest of the changed average distances
+                FLOAT_T m = INFTY;
+                size_t mk = l;
+                if (k1 != l && C(u,k1)/(FLOAT_T)(count[k1]) < m) {
+                    m = C(u,k1)/(FLOAT_T)(count[k1]);
+                    mk = k1;
+                }
+                if (k2 != l && C(u,k2)/(FLOAT_T)(count[k2]) < m) {
+                    m = C(u,k2)/(FLOAT_T)(count[k2]);
+                    mk = k2;
+                }
+
+                if (nearest[u] == k1 || nearest[u] == k2) {
+                    // the others are not closer than the old b(u)
+                    if (m <= nearest_dist[u]) {
+                        nearest_dist[u] = m;
+                        nearest[u] = (Label)mk;
+                    }
+                    else
+                        rescan_nearest(u);
+                }
+                else if (m < nearest_dist[u]) {
+                    nearest_dist[u] = m;
+                    nearest[u] = (Label)mk;
+                }
+            }
+
+            FLOAT_T a = C(u,l)/(FLOAT_T)(count[l]-1);
+            add_score(cur_sum, cur_singletons, a, nearest_dist[u], count[l]);
+        }
+    }
+
+
+    /** Updates C as if the labels of the i-th and the k-th point were
+     *  exchanged (in a single pass); the labels are not modified.
+     *
+     *  Applied once again after the labels have been exchanged,
+     *  reverts the update.
+     */
+    void swap_sums(size_t i, size_t k)
+    {
+        Label li = L[i], lk = L[k];
+        std::vector<FLOAT_T> buf_i, buf_k;
+        const FLOAT_T* Di = D.row(i, buf_i);
+        const FLOAT_T* Dk = D.row(k, buf_k);
+        for (size_t u=0; u<n; ++u) {
+            FLOAT_T diff = Dk[u]-Di[u];
+            C(u, li) += diff;
+            C(u, lk) -= diff;
+        }
+    }
+
+    /** Updates C as if L[idx[t]] was set to labels[t] for all t;
+     *  the labels are not modified; only the rows of D corresponding
+     *  to the moved points are needed
+     */
+    void move_sums(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels)
+    {
+        std::vector<FLOAT_T> buf;
+        for (size_t t=0; t<idx.size(); ++t) {
+            size_t i = idx[t];
+            Label from = L[i], to = labels[t];
+            if (from == to) continue;
+            const FLOAT_T* Di = D.row(i, buf);
+            for (size_t u=0; u<n; ++u) {
+                FLOAT_T dist = Di[u];
+                C(u, from) -= dist;
+                C(u, to)   += dist;
+            }
+        }
+    }
+
 public:
     // Described in the base class
     SilhouetteIndex(
-           const matrix<FLOAT_T>& _X,
-           const uint8_t _K,
+           const DatasetPtr& _data,
+           const size_t _K,
            const bool _allow_undo=false,
-           bool _widths=false)
-        : ClusterValidityIndex(_X, _K, _allow_undo),
-          A(n),
-          B(n),
+           bool _widths=false,
+           const int _metric=CVI_METRIC_EUCLIDEAN,
+           const int _distance_storage=CVI_DISTANCE_DOUBLE)
+        : LabelledIndex<Label>(_data, _K, _allow_undo,
+            _metric, _distance_storage),
           C(n, K),
-          D(&X, n<=CVI_MAX_N_PRECOMPUTE_DISTANCE)
+          D(data->get_distance(false/*not squared*/, metric, distance_storage)),
+          nearest_dist(n), nearest(n), cur_sum(0.0), cur_singletons(0)
     {
         widths = _widths;
     }
 
+
     // Described in the base class
-    virtual void set_labels(const std::vector<uint8_t>& _L)
+    virtual ClusterValidityIndex* clone() const
     {
-        ClusterValidityIndex::set_labels(_L); // sets L, count and centroids
+        SilhouetteIndex* ret = new SilhouetteIndex(*this);
+        ret->D = D.clone();  // own row cache (if used)
+        return ret;
+    }
+
+
+    // Described in the base class
+    virtual const EuclideanDistance* get_distance() const { return &D; }
+
+    // Described in the base class
+    virtual void set_labels(const std::vector<Label>& _L)
+    {
+        LabelledIndex<Label>::set_labels(_L); // sets L, count and centroids
 
         for (size_t i=0; i<n; ++i) {
             for (size_t j=0; j<K; ++j) C(i,j) = 0.0;
         }
 
-        for (size_t i=0; i<n-1; ++i) {
-            for (size_t j=i+1; j<n; ++j) {
-                FLOAT_T dist = D(i, j);
-                C(i, L[j]) += dist;
-                C(j, L[i]) += dist;
+        if (cvi_get_num_threads() > 1 && D.is_thread_safe()) {
+            // each thread processes different rows of C;
+            // every distance is fetched twice, but C(i,:) is
+            // accumulated in the same order as below (j=0,1,...,n-1),
+            // hence the results are exactly the same
+            #ifdef _OPENMP
+            #pragma omp parallel for schedule(dynamic, 16) num_threads(cvi_get_num_threads())
+            #endif
+            for (size_t i=0; i<n; ++i) {
+                std::vector<FLOAT_T> buf;
+                const FLOAT_T* Di = D.row(i, buf);
+                for (size_t j=0; j<n; ++j) {
+                    if (i == j) continue;
+                    C(i, L[j]) += Di[j];
+                }
             }
         }
+        else {
+            std::vector<FLOAT_T> buf;
+            for (size_t i=0; i<n-1; ++i) {
+                const FLOAT_T* Di = D.row(i, buf, i+1);
+                for (size_t j=i+1; j<n; ++j) {
+                    FLOAT_T dist = Di[j];
+                    C(i, L[j]) += dist;
+                    C(j, L[i]) += dist;
+                }
+            }
+        }
+
+        update_scores(K);
     }
 
 
     // Described in the base class
-    virtual void modify(size_t i, uint8_t j)
+    virtual void modify(size_t i, size_t j)
     {
+        Label tmp = L[i];
+        std::vector<FLOAT_T> buf;
+        const FLOAT_T* Di = D.row(i, buf);
         for (size_t u=0; u<n; ++u) {
-            FLOAT_T dist = D(i, u);
+            FLOAT_T dist = Di[u];
             C(u, L[i]) -= dist;
             C(u, j)    += dist;
         }
 
 
         // sets L[i]=j and updates count as well as centroids
-        ClusterValidityIndex::modify(i, j);
+        LabelledIndex<Label>::modify(i, j);
+
+        update_scores(tmp, j, i, i);
+    }
+
+
+    // Described in the base class
+    virtual void swap(size_t i, size_t k)
+    {
+        CVI_ASSERT(L[i] != L[k]);
+        Label li = L[i], lk = L[k];
+        swap_sums(i, k);
+
+        // exchanges L[i] and L[k]
+        LabelledIndex<Label>::swap(i, k);
+
+        update_scores(li, lk, i, k);
+    }
+
+
+    // Described in the base class
+    virtual void modify_many(const std::vector<size_t>& idx,
+        const std::vector<Label>& labels)
+    {
+        check_many(idx, labels);
+        move_sums(idx, labels);
+
+        // sets L and count
+        LabelledIndex<Label>::modify_many(idx, labels);
+
+        update_scores(K);
     }
 
 
     // Described in the base class
     virtual void undo()
     {
+        CVI_ASSERT(can_undo());
+        if (journal.back().is_many()) {
+            move_sums(journal.back().many_idx, journal.back().many_labels);
+            LabelledIndex<Label>::undo();
+            update_scores(K);
+            return;
+        }
+        else if (journal.back().is_swap()) {
+            size_t i = journal.back().i, k = journal.back().k;
+            Label li = L[i], lk = L[k];
+            swap_sums(i, k);
+            LabelledIndex<Label>::undo();
+            update_scores(li, lk, i, k);
+            return;
+        }
+
+        size_t last_i = journal.back().i;
+        Label last_j = journal.back().j;
+        Label tmp = L[last_i];
+
+        std::vector<FLOAT_T> buf;
+        const FLOAT_T* Di = D.row(last_i, buf);
         for (size_t u=0; u<n; ++u) {
-            double dist = D(last_i, u);
+            FLOAT_T dist = Di[u];
             C(u, L[last_i]) -= dist;
             C(u, last_j)    += dist;
         }
 
-        ClusterValidityIndex::undo();
+        LabelledIndex<Label>::undo();
+
+        update_scores(tmp, last_j, last_i, last_i);
     }
 
 
     // Described in the base class
     virtual FLOAT_T compute()
     {
-        for (size_t i=0; i<n; ++i) {
-            // Let C(i,j) == sum of distances between X(i,) and all points in the j-th cluster
-            B[i] = INFTY;
-            for (size_t j=0; j<K; ++j) {
-                if (j == L[i]) {
-                    A[i] = C(i,j)/(FLOAT_T)(count[j]-1);
+        // cur_sum and cur_singletons are kept up to date by update_scores(),
+        // hence this gives the same as compute_for(PartitionView, CurrentSums)
+        FLOAT_T ret;
+        if (widths)
+            ret = cur_sum/(FLOAT_T)(K-cur_singletons);
+        else
+            ret = cur_sum/(FLOAT_T)n;
+
+        CVI_ASSERT(std::fabs(ret) < 1.0+1e-12);
+
+        return ret;
+    }
+
+
+    // Described in the base class
+    virtual FLOAT_T score_move(size_t i, size_t j) const
+    {
+        MovedPartitionView<Label> P(L, count, i, j);
+        return compute_for(P, MovedSums(C, P, D));
+    }
+
+
+    // Described in the base class
+    virtual void score_point_moves(size_t i, FLOAT_T* res) const
+    {
+        // A single scan of the distances D(i,:) suffices.
+        // Removing the i-th point from its cluster affects all the moves
+        // in the same way; then, for each u, the second smallest
+        // average distance to the other clusters is enough to
+        // update u's silhouette score for every target cluster in O(1).
+        Label a = L[i];
+        for (size_t j=0; j<K; ++j)
+            res[j] = std::numeric_limits<FLOAT_T>::quiet_NaN();
+        if (count[a] <= 1) return;
+
+        std::vector<size_t> size(count);  // after removing the i-th point
+        size[a]--;
+
+        std::vector<FLOAT_T> buf;
+        const FLOAT_T* Di = D.row(i, buf);
+
+        std::vector<FLOAT_T> ret(K, 0.0);
+        std::vector<size_t> num_singletons(K, 0);
+        for (size_t u=0; u<n; ++u) {
+            if (u == i) {
+                for (size_t j=0; j<K; ++j) {
+                    if (j == a) continue;
+                    FLOAT_T a_u = C(u,j)/(FLOAT_T)(size[j]+1-1);
+                    FLOAT_T b_u = INFTY;
+                    for (size_t k=0; k<K; ++k) {
+                        if (k == j) continue;
+                        if (C(u,k)/(FLOAT_T)(size[k]) < b_u)
+                            b_u = C(u,k)/(FLOAT_T)(size[k]);
+                    }
+                    add_score(ret[j], num_singletons[j], a_u, b_u, size[j]+1);
+                }
+                continue;
+            }
+
+            FLOAT_T dist = Di[u];
+            Label l = L[u];
+
+            // the two smallest average distances to the other clusters
+            // and the radius, all after the removal of the i-th point
+            FLOAT_T a_u = 0.0;
+            FLOAT_T b1 = INFTY, b2 = INFTY;
+            size_t k1 = K;
+            for (size_t k=0; k<K; ++k) {
+                FLOAT_T c = (k == a)?(C(u,k)-dist):C(u,k);
+                if (k == l) {
+                    a_u = c/(FLOAT_T)(size[k]-1);
                 }
                 else {
-                    if (C(i,j)/(FLOAT_T)(count[j]) < B[i])
-                        B[i] = C(i,j)/(FLOAT_T)(count[j]);
+                    FLOAT_T cur = c/(FLOAT_T)(size[k]);
+                    if (cur < b1) { b2 = b1; b1 = cur; k1 = k; }
+                    else if (cur < b2) b2 = cur;
                 }
             }
-        }
 
-        // compute the mean of silhouette scores of each point
-        FLOAT_T ret = 0.0;
-        if (widths) {
-            size_t num_singletons = 0;
-            for (size_t i=0; i<n; ++i) {
-                if (count[L[i]] > 1) { // silhouette score of 0 for singleton clusters
-                    FLOAT_T cur = (B[i]-A[i])/std::max(B[i], A[i]);
-                    ret += cur/(FLOAT_T)count[L[i]];
+            for (size_t j=0; j<K; ++j) {
+                if (j == a) continue;
+                FLOAT_T c = C(u,j)+dist;
+                if (j == l) {
+                    add_score(ret[j], num_singletons[j],
+                        c/(FLOAT_T)(size[j]+1-1), b1, size[j]+1);
                 }
-                else
-                    num_singletons++;
-            }
-            ret = ret/(FLOAT_T)(K-num_singletons);
-        }
-        else {
-            for (size_t i=0; i<n; ++i) {
-                if (count[L[i]] > 1) { // silhouette score of 0 for singleton clusters
-                    FLOAT_T cur = (B[i]-A[i])/std::max(B[i], A[i]);
-                    ret += cur;
+                else {
+                    FLOAT_T b_u = (k1 == j)?b2:b1;
+                    if (c/(FLOAT_T)(size[j]+1) < b_u)
+                        b_u = c/(FLOAT_T)(size[j]+1);
+                    add_score(ret[j], num_singletons[j], a_u, b_u, size[l]);
                 }
             }
-            ret = ret/(FLOAT_T)n;
         }
 
-        CVI_ASSERT(std::fabs(ret) < 1.0+1e-12);
+        for (size_t j=0; j<K; ++j) {
+            if (j == a) continue;
+            if (widths)
+                res[j] = ret[j]/(FLOAT_T)(K-num_singletons[j]);
+            else
+                res[j] = ret[j]/(FLOAT_T)n;
+        }
+    }
 
-        return ret;
+
+    // Described in the base class
+    virtual void score_all_moves(matrix<FLOAT_T>& res) const
+    {
+        CVI_ASSERT(res.nrow() == n && res.ncol() == K);
+
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic, 16) num_threads(cvi_get_num_threads()) if(D.is_thread_safe())
+        #endif
+        for (size_t i=0; i<n; ++i)
+            score_point_moves(i, res.row(i));
     }
 };
 
@@ -0,0 +1,264 @@
+/*  Internal cluster validity indices
+ *
+ *  Copyleft (C) 2020, Marek Gagolewski <https://www.gagolewski.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License
+ *  Version 3, 19 November 2007, published by the Free Software Foundation.
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Affero General Public License Version 3 for more details.
+ *  You should have received a copy of the License along with this program.
+ *  If this is not the case, refer to <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CVI_SILHOUETTE_SAMPLED_H
+#define __CVI_SILHOUETTE_SAMPLED_H
+
+#include <random>
+#include "cvi.h"
+
+
+/** Quantile of the standard normal distribution used by
+ *  SampledSilhouetteIndex for the (1-alpha) confidence intervals
+ */
+#define CVI_SILHOUETTE_SAMPLED_Z 1.959963984540054  /* alpha=0.05 */
+
+
+/** Seed of the random generator used by SampledSilhouetteIndex
+ */
+#define CVI_SILHOUETTE_SAMPLED_SEED 123
+
+
+/** A Stratified Sampling Estimate of the Silhouette Coefficient
+ *
+ *  Estimates the index computed by SilhouetteIndex without
+ *  the O(n^2) time and memory costs: a sample of (about) M points
+ *  is drawn (without replacement) from the clusters, each
+ *  represented proportionally to its size, but by at least
+ *  2 points (or all if smaller).  The silhouette scores of the sampled
+ *  points are computed exactly, i.e., based on their distances to all
+ *  the n points, in O(Mn) time.
+ *
+ *  Then, the overall average score (widths=false) is estimated by
+ *  the stratified sample mean, and the mean of the cluster average
+ *  widths (widths=true) -- by the mean of the per-cluster sample means.
+ *  A normal approximation-based confidence interval
+ *  (with the finite population correction) can be obtained by calling
+ *  get_confidence_interval() after compute().
+ *
+ *  The sample is drawn anew in each compute() call, using a random generator
+ *  with a fixed seed, so that the estimate is a deterministic function
+ *  of the labels.  If M >= n, the exact value is obtained.
+ *
+ *  The pairwise distances are provided by Dataset::get_distance(),
+ *  which computes them on the fly unless they fit in the memory budget
+ *  set by cvi_distance_policy().
+ */
+template<class Label>
+class SampledSilhouetteIndex : public LabelledIndex<Label>
+{
+protected:
+    CVI_LABELLED_INDEX_MEMBERS(LabelledIndex<Label>)
+
+    EuclideanDistance D;    ///< D(i, j) gives the Euclidean distance
+                            ///< between X(i,:) and X(j,:)
+    bool widths;
+    size_t M;               ///< (approximate) sample size
+
+    FLOAT_T last_lower;     ///< confidence interval determined by compute()
+    FLOAT_T last_upper;
+
+
+    /** Draws the sample: the indexes of the points stratified
+     *  by the clusters, see the class description
+     *
+     * @param P PartitionView or MovedPartitionView
+     * @param sample [out] the indexes of the sampled points from
+     *        the k-th cluster are given by sample[k]
+     */
+    template<class Partition>
+    void draw_sample(const Partition& P,
+        std::vector< std::vector<size_t> >& sample) const
+    {
+        sample.assign(K, std::vector<size_t>());
+        for (size_t k=0; k<K; ++k)
+            sample[k].reserve(P.size(k));
+        for (size_t i=0; i<n; ++i)
+            sample[P.label(i)].push_back(i);
+
+        // not std::uniform_int_distribution, which is implementation-defined
+        std::mt19937 rng(CVI_SILHOUETTE_SAMPLED_SEED);
+        for (size_t k=0; k<K; ++k) {
+            size_t nk = sample[k].size();
+            size_t mk = (size_t)((FLOAT_T)M*nk/(FLOAT_T)n+0.5);
+            mk = std::min(nk, std::max(mk, (size_t)2));
+
+            // partial Fisher-Yates shuffle
+            for (size_t t=0; t<mk; ++t) {
+                size_t r = t+(size_t)(rng()%(nk-t));
+                std::swap(sample[k][t], sample[k][r]);
+            }
+            sample[k].resize(mk);
+        }
+    }
+
+
+    /** Computes the index for a given partition
+     *  (PartitionView<Label> or MovedPartitionView)
+     *
+     * @param P
+     * @param lower [out] the lower bound of the confidence interval
+     * @param upper [out] the upper bound
+     * @return the estimate
+     */
+    template<class Partition>
+    FLOAT_T compute_for(const Partition& P, FLOAT_T& lower, FLOAT_T& upper) const
+    {
+        std::vector< std::vector<size_t> > sample;
+        draw_sample(P, sample);
+
+        std::vector<size_t> idx;  // all the sampled points
+        for (size_t k=0; k<K; ++k)
+            idx.insert(idx.end(), sample[k].begin(), sample[k].end());
+
+        std::vector<FLOAT_T> s(n, 0.0);  // scores of the sampled points
+
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic) num_threads(cvi_get_num_threads()) if(D.is_thread_safe())
+        #endif
+        for (size_t t=0; t<idx.size(); ++t) {
+            size_t i = idx[t];
+            Label l = P.label(i);
+            if (P.size(l) <= 1) continue;  // singleton -> score of 0
+
+            std::vector<FLOAT_T> buf;
+            const FLOAT_T* Di = D.row(i, buf);
+            std::vector<FLOAT_T> S(K, 0.0);  // sums of distances to each cluster
+            for (size_t u=0; u<n; ++u) {
+                if (u == i) continue;
+                S[P.label(u)] += Di[u];
+            }
+
+            FLOAT_T a = S[l]/(FLOAT_T)(P.size(l)-1);
+            FLOAT_T b = INFTY;
+            for (size_t k=0; k<K; ++k) {
+                if (k == l) continue;
+                if (S[k]/(FLOAT_T)(P.size(k)) < b)
+                    b = S[k]/(FLOAT_T)(P.size(k));
+            }
+
+            FLOAT_T m = std::max(a, b);
+            if (m > 0.0) s[i] = (b-a)/m;
+        }
+
+        // stratified estimates of the mean and its variance
+        FLOAT_T est = 0.0, var = 0.0;
+        size_t num_singletons = 0;
+        for (size_t k=0; k<K; ++k) {
+            size_t nk = P.size(k), mk = sample[k].size();
+            if (nk <= 1) {
+                ++num_singletons;
+                continue;
+            }
+
+            FLOAT_T mean = 0.0;
+            for (size_t t=0; t<mk; ++t)
+                mean += s[sample[k][t]];
+            mean /= (FLOAT_T)mk;
+
+            FLOAT_T var_k = 0.0;
+            if (mk < nk) {
+                for (size_t t=0; t<mk; ++t)
+                    var_k += square(s[sample[k][t]]-mean);
+                var_k /= (FLOAT_T)(mk-1);
+                var_k *= (1.0-mk/(FLOAT_T)nk)/(FLOAT_T)mk;
+            }
+
+            FLOAT_T w = (widths)?1.0:(nk/(FLOAT_T)n);
+            est += w*mean;
+            var += w*w*var_k;
+        }
+
+        if (widths) {
+            est /= (FLOAT_T)(K-num_singletons);
+            var /= square((FLOAT_T)(K-num_singletons));
+        }
+
+        FLOAT_T h = CVI_SILHOUETTE_SAMPLED_Z*sqrt(var);
+        lower = std::max(est-h, (FLOAT_T)-1.0);
+        upper = std::min(est+h, (FLOAT_T)1.0);
+
+        CVI_ASSERT(std::fabs(est) < 1.0+1e-12);
+        return est;
+    }
+
+
+public:
+    // Described in the base class
+    SampledSilhouetteIndex(
+           const DatasetPtr& _data,
+           const size_t _K,
+           const bool _allow_undo=false,
+           bool _widths=false,
+           size_t _M=1000,
+           const int _metric=CVI_METRIC_EUCLIDEAN,
+           const int _distance_storage=CVI_DISTANCE_DOUBLE)
+        : LabelledIndex<Label>(_data, _K, _allow_undo,
+            _metric, _distance_storage),
+          D(data->get_distance(false/*not squared*/, metric, distance_storage)),
+          widths(_widths), M(_M),
+          last_lower(std::numeric_limits<FLOAT_T>::quiet_NaN()),
+          last_upper(std::numeric_limits<FLOAT_T>::quiet_NaN())
+    {
+        CVI_ASSERT(M > 0);
+    }
+
+
+    // Described in the base class
+    virtual ClusterValidityIndex* clone() const
+    {
+        SampledSilhouetteIndex* ret = new SampledSilhouetteIndex(*this);
+        ret->D = D.clone();
+        return ret;
+    }
+
+
+    // Described in the base class
+    virtual const EuclideanDistance* get_distance() const { return &D; }
+
+
+    /** Returns the confidence interval for the value of the Silhouette
+     *  Coefficient determined by the most recent call to compute()
+     *  (NaNs if there was none)
+     *
+     * @param lower [out]
+     * @param upper [out]
+     */
+    void get_confidence_interval(FLOAT_T& lower, FLOAT_T& upper) const
+    {
+        lower = last_lower;
+        upper = last_upper;
+    }
+
+
+    // Described in the base class
+    virtual FLOAT_T compute()
+    {
+        return compute_for(PartitionView<Label>(L, count), last_lower, last_upper);
+    }
+
+
+    // Described in the base class
+    virtual FLOAT_T score_move(size_t i, size_t j) const
+    {
+        FLOAT_T lower, upper;
+        return compute_for(MovedPartitionView<Label>(L, count, i, j), lower, upper);
+    }
+
+};
+
+
+
+#endif
@@ -0,0 +1,136 @@
+/*  Internal cluster validity indices
+ *
+ *  Copyleft (C) 2020, Marek Gagolewski <https://www.gagolewski.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License
+ *  Version 3, 19 November 2007, published by the Free Software Foundation.
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Affero General Public License Version 3 for more details.
+ *  You should have received a copy of the License along with this program.
+ *  If this is not the case, refer to <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CVI_SILHOUETTE_SIMPLIFIED_H
+#define __CVI_SILHOUETTE_SIMPLIFIED_H
+
+#include "cvi.h"
+
+
+
+/** The Simplified Silhouette Coefficient
+ *
+ *  Like the Silhouette Coefficient (see SilhouetteIndex), but a(i)
+ *  is the distance between the i-th point and its cluster's centroid
+ *  and b(i) is the distance to the nearest other centroid.
+ *  Overall average per-point scores (widths=false) or the mean of the
+ *  cluster average widths (widths=true) are reported; points
+ *  in singleton clusters get the score of 0.
+ *
+ *  An approximation of the Silhouette Coefficient that needs
+ *  O(nKd) time and no pairwise distances, hence is applicable
+ *  to large datasets.
+ *
+ *  E.R. Hruschka, L.N. de Castro, R.J.G.B. Campello,
+ *  Evolutionary algorithms for clustering gene-expression data,
+ *  In: Proc. 4th IEEE Intl. Conf. Data Mining (ICDM), 2004, pp. 403-406.
+ */
+template<class Label>
+class SimplifiedSilhouetteIndex : public CentroidsBasedIndex<Label>
+{
+protected:
+    CVI_LABELLED_INDEX_MEMBERS(CentroidsBasedIndex<Label>)
+    using CentroidsBasedIndex<Label>::centroids;
+
+    bool widths;
+
+public:
+    // Described in the base class
+    SimplifiedSilhouetteIndex(
+           const DatasetPtr& _data,
+           const size_t _K,
+           const bool _allow_undo=false,
+           bool _widths=false,
+           const int _metric=CVI_METRIC_EUCLIDEAN,
+           const int _distance_storage=CVI_DISTANCE_DOUBLE)
+        : CentroidsBasedIndex<Label>(_data, _K, _allow_undo,
+            _metric, _distance_storage)
+    {
+        widths = _widths;
+    }
+
+
+    // Described in the base class
+    virtual ClusterValidityIndex* clone() const
+    {
+        return new SimplifiedSilhouetteIndex(*this);
+    }
+
+
+    /** Computes the index for a given partition
+     *  (CentroidsView<Label> or MovedCentroidsView)
+     */
+    template<class Partition>
+    FLOAT_T compute_for(const Partition& P) const
+    {
+        std::vector<FLOAT_T> ret(K, 0.0);  // sums of scores in each cluster
+        for (size_t i=0; i<n; ++i) {
+            Label l = P.label(i);
+            if (P.size(l) <= 1) continue;  // singleton -> score of 0
+
+            FLOAT_T a = INFTY, b = INFTY;
+            for (size_t k=0; k<K; ++k) {
+                const FLOAT_T* c = P.centroid(k);
+                FLOAT_T dist = 0.0;
+                for (size_t u=0; u<d; ++u)
+                    dist += square(c[u]-X(i,u));
+                dist = sqrt(dist);
+
+                if (k == l) a = dist;
+                else if (dist < b) b = dist;
+            }
+
+            FLOAT_T m = std::max(a, b);
+            if (m > 0.0) ret[l] += (b-a)/m;
+        }
+
+        FLOAT_T res = 0.0;
+        if (widths) {
+            size_t num_singletons = 0;
+            for (size_t k=0; k<K; ++k) {
+                if (P.size(k) <= 1) ++num_singletons;
+                else res += ret[k]/(FLOAT_T)P.size(k);
+            }
+            res /= (FLOAT_T)(K-num_singletons);
+        }
+        else {
+            for (size_t k=0; k<K; ++k)
+                res += ret[k];
+            res /= (FLOAT_T)n;
+        }
+
+        CVI_ASSERT(std::fabs(res) < 1.0+1e-12);
+        return res;
+    }
+
+
+    // Described in the base class
+    virtual FLOAT_T compute()
+    {
+        return compute_for(CentroidsView<Label>(L, count, centroids));
+    }
+
+
+    // Described in the base class
+    virtual FLOAT_T score_move(size_t i, size_t j) const
+    {
+        return compute_for(MovedCentroidsView<Label>(X, L, count, centroids, i, j));
+    }
+
+};
+
+
+
+#endif
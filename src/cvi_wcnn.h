@@ -35,38 +35,121 @@
  *  TODO: check if this appeared in the literature -- this is
  *  a very simple idea.
  */
-class WCNNIndex : public NNBasedIndex
+template<class Label>
+class WCNNIndex : public NNBasedIndex<Label>
 {
-public:
-    // Described in the base class
+protected:
+    CVI_LABELLED_INDEX_MEMBERS(NNBasedIndex<Label>)
+    using NNBasedIndex<Label>::M;
+    using NNBasedIndex<Label>::nn;
+    using NNBasedIndex<Label>::dist;
+    using NNBasedIndex<Label>::ind;
+
+public:    // Described in the base class
     WCNNIndex(
-           const matrix<FLOAT_T>& _X,
-           const uint8_t _K,
+           const DatasetPtr& _data,
+           const size_t _K,
            const bool _allow_undo=false,
-           const size_t _M=10
+           const size_t _M=10,
+           const int _metric=CVI_METRIC_EUCLIDEAN,
+           const int _distance_storage=CVI_DISTANCE_DOUBLE
              )
-        : NNBasedIndex(_X, _K, _allow_undo, _M)
+        : NNBasedIndex<Label>(_data, _K, _allow_undo, _M,
+            _metric, _distance_storage)
     {
         ;
     }
 
 
-    virtual FLOAT_T compute()
+    // Described in the base class
+    virtual ClusterValidityIndex* clone() const
+    {
+        return new WCNNIndex(*this);
+    }
+
+
+    /** Computes the index for a given partition
+     *  (PartitionView<Label> or MovedPartitionView)
+     */
+    template<class Partition>
+    FLOAT_T compute_for(const Partition& P) const
     {
         for (size_t i=0; i<K; ++i)
-            if (count[i] <= M)
+            if (P.size(i) <= M)
                 return -INFTY;
 
         size_t wcnn = 0;
         for (size_t i=0; i<n; ++i) {
+            Label l = P.label(i);
             for (size_t j=0; j<M; ++j) {
-                if (L[i] == L[ind(i, j)])
+                if (l == P.label(ind(i, j)))
                     wcnn++;
             }
         }
         return wcnn/(FLOAT_T)(n*M);
     }
 
+
+    virtual FLOAT_T compute()
+    {
+        return compute_for(PartitionView<Label>(L, count));
+    }
+
+
+    // Described in the base class
+    virtual FLOAT_T score_move(size_t i, size_t j) const
+    {
+        return compute_for(MovedPartitionView<Label>(L, count, i, j));
+    }
+
+
+    // Described in the base class
+    virtual void score_all_moves(matrix<FLOAT_T>& res) const
+    {
+        CVI_ASSERT(res.nrow() == n && res.ncol() == K);
+
+        // nn_count(i, k) - number of the i-th point's M nearest neighbours
+        // in the k-th cluster; rev_count(i, k) - number of points in the
+        // k-th cluster that have the i-th point amongst their M NNs
+        matrix<size_t> nn_count(n, K, 0);
+        matrix<size_t> rev_count(n, K, 0);
+        size_t wcnn = 0;
+        for (size_t i=0; i<n; ++i) {
+            for (size_t j=0; j<M; ++j) {
+                nn_count(i, L[ind(i, j)])++;
+                rev_count(ind(i, j), L[i])++;
+                if (L[i] == L[ind(i, j)])
+                    wcnn++;
+            }
+        }
+
+        size_t num_small = 0;  // number of clusters of size <= M
+        for (size_t k=0; k<K; ++k)
+            if (count[k] <= M) num_small++;
+
+        for (size_t i=0; i<n; ++i) {
+            Label a = L[i];
+            for (size_t j=0; j<K; ++j) {
+                if (j == a || count[a] <= 1) {
+                    res(i, j) = std::numeric_limits<FLOAT_T>::quiet_NaN();
+                    continue;
+                }
+
+                // the sizes of the a-th and the j-th cluster change
+                size_t cur_small = num_small-(count[a] <= M)-(count[j] <= M)
+                    +(count[a]-1 <= M)+(count[j]+1 <= M);
+                if (cur_small > 0) {
+                    res(i, j) = -INFTY;
+                    continue;
+                }
+
+                size_t cur_wcnn = wcnn
+                    -nn_count(i, a)+nn_count(i, j)-rev_count(i, a)+rev_count(i, j);
+                res(i, j) = cur_wcnn/(FLOAT_T)(n*M);
+            }
+        }
+    }
+
 };
 
 
@@ -44,38 +44,127 @@
  *  doi:10.1080/03610927408827101.
  *
  */
-class WCSSIndex : public CentroidsBasedIndex
+template<class Label>
+class WCSSIndex : public CentroidsBasedIndex<Label>
 {
 protected:
+    CVI_LABELLED_INDEX_MEMBERS(CentroidsBasedIndex<Label>)
+    using CentroidsBasedIndex<Label>::centroids;
+    using CentroidsBasedIndex<Label>::move_centroids;
+    using CentroidsBasedIndex<Label>::swap_centroids;
+
     bool weighted;          ///< false for WCSS, true for the Ball-Hall index
 
 public:
     // Described in the base class
     WCSSIndex(
-           const matrix<FLOAT_T>& _X,
-           const uint8_t _K,
+           const DatasetPtr& _data,
+           const size_t _K,
            const bool _allow_undo=false,
-           bool _weighted=false)
-        : CentroidsBasedIndex(_X, _K, _allow_undo)
+           bool _weighted=false,
+           const int _metric=CVI_METRIC_EUCLIDEAN,
+           const int _distance_storage=CVI_DISTANCE_DOUBLE)
+        : CentroidsBasedIndex<Label>(_data, _K, _allow_undo,
+            _metric, _distance_storage)
     {
         weighted = _weighted;
     }
 
 
-
     // Described in the base class
-    virtual FLOAT_T compute()
+    virtual ClusterValidityIndex* clone() const
+    {
+        return new WCSSIndex(*this);
+    }
+
+
+
+    /** Computes the index for a given partition
+     *  (CentroidsView<Label> or MovedCentroidsView)
+     */
+    template<class Partition>
+    FLOAT_T compute_for(const Partition& P) const
     {
         // sum of within-cluster squared L2 distances
         FLOAT_T wcss = 0.0;
         for (size_t i=0; i<n; ++i) {
+            Label k = P.label(i);
+            const FLOAT_T* c = P.centroid(k);
             for (size_t j=0; j<d; ++j) {
-                wcss += square(centroids(L[i],j)-X(i,j))/((weighted)?count[L[i]]:1.0);
+                wcss += square(c[j]-X(i,j))/((weighted)?P.size(k):1.0);
             }
         }
         return -wcss;  // negative!!!
     }
 
+
+    // Described in the base class
+    virtual FLOAT_T compute()
+    {
+        return compute_for(CentroidsView<Label>(L, count, centroids));
+    }
+
+
+    // Described in the base class
+    virtual FLOAT_T score_move(size_t i, size_t j) const
+    {
+        return compute_for(MovedCentroidsView<Label>(X, L, count, centroids, i, j));
+    }
+
+
+    // Described in the base class
+    virtual void score_all_moves(matrix<FLOAT_T>& res) const
+    {
+        CVI_ASSERT(res.nrow() == n && res.ncol() == K);
+
+        // W[k] = sum of squared L2 distances between
+        // the k-th centroid and the cluster members
+        std::vector<FLOAT_T> W(K, 0.0);
+        for (size_t i=0; i<n; ++i) {
+            for (size_t u=0; u<d; ++u) {
+                W[L[i]] += square(centroids(L[i],u)-X(i,u));
+            }
+        }
+
+        FLOAT_T wcss = 0.0;
+        for (size_t k=0; k<K; ++k)
+            wcss += (weighted)?(W[k]/count[k]):W[k];
+
+        // moving the i-th point from the a-th to the j-th cluster gives
+        // W[a] -= count[a]/(count[a]-1)*||X(i,:)-centroids(a,:)||^2 and
+        // W[j] += count[j]/(count[j]+1)*||X(i,:)-centroids(j,:)||^2
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(static) num_threads(cvi_get_num_threads())
+        #endif
+        for (size_t i=0; i<n; ++i) {
+            Label a = L[i];
+            for (size_t j=0; j<K; ++j) {
+                FLOAT_T e = 0.0;
+                for (size_t u=0; u<d; ++u)
+                    e += square(centroids(j,u)-X(i,u));
+                res(i, j) = e;  // temporarily
+            }
+
+            if (count[a] <= 1) {
+                for (size_t j=0; j<K; ++j)
+                    res(i, j) = std::numeric_limits<FLOAT_T>::quiet_NaN();
+                continue;
+            }
+
+            FLOAT_T W_a = W[a]-res(i, a)*count[a]/(count[a]-1.0);
+            for (size_t j=0; j<K; ++j) {
+                if (j == a) continue;
+                FLOAT_T W_j = W[j]+res(i, j)*count[j]/(count[j]+1.0);
+                if (weighted)
+                    res(i, j) = -(wcss-W[a]/count[a]-W[j]/count[j]
+                        +W_a/(count[a]-1.0)+W_j/(count[j]+1.0));
+                else
+                    res(i, j) = -(wcss-W[a]-W[j]+W_a+W_j);
+            }
+            res(i, a) = std::numeric_limits<FLOAT_T>::quiet_NaN();
+        }
+    }
+
 };
 
 
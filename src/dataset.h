@@ -0,0 +1,675 @@
+/*  A dataset together with the auxiliary data structures
+ *  (pairwise distances, nearest neighbours, column statistics)
+ *  that can be shared by many cluster validity index objects
+ *
+ *  Copyleft (C) 2020-2021, Marek Gagolewski <https://www.gagolewski.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License
+ *  Version 3, 19 November 2007, published by the Free Software Foundation.
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Affero General Public License Version 3 for more details.
+ *  You should have received a copy of the License along with this program.
+ *  If this is not the case, refer to <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DATASET_H
+#define __DATASET_H
+
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <utility>
+#include <tuple>
+#include <memory>
+#include <string>
+#include "common.h"
+#include "matrix.h"
+#include "distance.h"
+#include "distance_file.h"
+
+
+
+/** M nearest neighbours of each point in a dataset
+ *  (w.r.t. the Euclidean distance or another metric, see the metric policies).
+ *
+ *  The neighbours are sorted increasingly w.r.t. the distance;
+ *  ties are resolved in favour of points with smaller indexes.
+ */
+struct NNGraph
+{
+    const size_t M;       ///< number of nearest neighbours
+    matrix<FLOAT_T> dist; ///< dist(i, j) is the distance between i and its j-th NN
+    matrix<size_t> ind;   ///< ind(i, j) is the index of the j-th NN of i
+
+
+    /** Determines the M nearest neighbours of each point
+     *
+     *  Time complexity: O(n^2 (d+M)).
+     *
+     * @param X dataset (transformed by the metric policy's prepare())
+     * @param _M number of nearest neighbours, 0 < M < n
+     * @param metric one of CVI_METRIC_*
+     */
+    NNGraph(const matrix_view<FLOAT_T>& X, const size_t _M,
+            int metric=CVI_METRIC_EUCLIDEAN)
+        : M(_M),
+          dist(X.nrow(), _M, INFTY),
+          ind(X.nrow(), _M, X.nrow())
+    {
+        CVI_ASSERT(M>0 && M<X.nrow());
+
+        size_t n = X.nrow();
+        switch (metric) {
+            case CVI_METRIC_MANHATTAN:   compute(n, __MetricDistance<MetricManhattan>(X)); break;
+            case CVI_METRIC_CHEBYSHEV:   compute(n, __MetricDistance<MetricChebyshev>(X)); break;
+            case CVI_METRIC_COSINE:      compute(n, __MetricDistance<MetricCosine>(X)); break;
+            case CVI_METRIC_MAHALANOBIS: compute(n, __MetricDistance<MetricMahalanobis>(X)); break;
+            default:                     compute(n, __MetricDistance<MetricEuclidean>(X));
+        }
+    }
+
+
+    /** Determines the M nearest neighbours of each point
+     *  given the pairwise distances
+     *
+     *  Time complexity: O(n^2 M).
+     *
+     * @param n number of points
+     * @param D the (non-squared) distances, D(i, j); e.g., an EuclideanDistance
+     *        object (which must be thread-safe)
+     * @param _M number of nearest neighbours, 0 < M < n
+     */
+    template<class Dissimilarity>
+    NNGraph(size_t n, const Dissimilarity& D, const size_t _M)
+        : M(_M),
+          dist(n, _M, INFTY),
+          ind(n, _M, n)
+    {
+        CVI_ASSERT(M>0 && M<n);
+        compute(n, D);
+    }
+
+
+    /** Takes the first M nearest neighbours from a graph with more
+     *  neighbours; the result is the same as if it was computed from scratch.
+     *
+     * @param other
+     * @param _M number of nearest neighbours, 0 < M <= other.M
+     */
+    NNGraph(const NNGraph& other, const size_t _M)
+        : M(_M),
+          dist(other.dist.nrow(), _M),
+          ind(other.ind.nrow(), _M)
+    {
+        CVI_ASSERT(M>0 && M<=other.M);
+        for (size_t i=0; i<dist.nrow(); ++i) {
+            for (size_t j=0; j<M; ++j) {
+                dist(i, j) = other.dist(i, j);
+                ind(i, j)  = other.ind(i, j);
+            }
+        }
+    }
+
+
+private:
+    template<class Dissimilarity>
+    void compute(size_t n, const Dissimilarity& D)
+    {
+        if (cvi_get_num_threads() > 1) {
+            // each thread determines the nearest neighbours of different
+            // points; every distance is computed twice, but
+            // the candidates are considered in the same order as below,
+            // hence the results are the same (ties included)
+            #ifdef _OPENMP
+            #pragma omp parallel for schedule(dynamic, 16) num_threads(cvi_get_num_threads())
+            #endif
+            for (size_t i=0; i<n; ++i) {
+                for (size_t j=0; j<n; ++j) {
+                    if (i == j) continue;
+                    FLOAT_T dij = D(i, j);
+
+                    if (dij < dist(i, M-1)) {
+                        // j may be amongst M NNs of i
+                        size_t l = M-1;
+                        while (l > 0 && dij < dist(i, l-1)) {
+                            dist(i, l) = dist(i, l-1);
+                            ind(i, l)  = ind(i, l-1);
+                            l--;
+                        }
+                        dist(i, l) = dij;
+                        ind(i, l)  = j;
+                    }
+                }
+            }
+            return;
+        }
+
+        for (size_t i=0; i<n-1; ++i) {
+            for (size_t j=i+1; j<n; ++j) {
+                FLOAT_T dij = D(i, j);
+
+                if (dij < dist(i, M-1)) {
+                    // j may be amongst M NNs of i
+                    size_t l = M-1;
+                    while (l > 0 && dij < dist(i, l-1)) {
+                        dist(i, l) = dist(i, l-1);
+                        ind(i, l)  = ind(i, l-1);
+                        l--;
+                    }
+                    dist(i, l) = dij;
+                    ind(i, l)  = j;
+                }
+
+                if (dij < dist(j, M-1)) {
+                    // i may be amongst M NNs of j
+                    size_t l = M-1;
+                    while (l > 0 && dij < dist(j, l-1)) {
+                        dist(j, l) = dist(j, l-1);
+                        ind(j, l)  = ind(j, l-1);
+                        l--;
+                    }
+                    dist(j, l) = dij;
+                    ind(j, l)  = i;
+                }
+            }
+        }
+    }
+};
+
+
+
+/** A minimum spanning tree of the complete graph whose vertices are
+ *  the points in a dataset and whose edge weights are the pairwise distances.
+ *
+ *  By the cut property, for any partition of the points, the minimum
+ *  of the distances between the points with different labels is attained
+ *  at an MST edge (the lightest one joining two such points).
+ *
+ *  The edges are sorted increasingly w.r.t. the weights;
+ *  ties are resolved in favour of the edges with smaller indexes
+ *  of the points.
+ */
+struct MinimumSpanningTree
+{
+    std::vector<size_t> i1;  ///< the first (smaller) vertex of each of the n-1 edges
+    std::vector<size_t> i2;  ///< the second one
+    std::vector<FLOAT_T> d;  ///< d[e] = D(i1[e], i2[e])
+    std::vector< std::vector<size_t> > incident;
+        ///< incident[i] gives the edges incident to the i-th point
+
+
+    /** Determines the MST by means of the Jarnik-Prim algorithm
+     *  for complete graphs
+     *
+     *  Time complexity: O(n^2) distance evaluations, memory: O(n).
+     *
+     * @param n number of points
+     * @param D the distances, D(i, j); the edge weights are exactly
+     *        these values
+     */
+    MinimumSpanningTree(size_t n, const EuclideanDistance& D)
+        : incident(n)
+    {
+        if (n <= 1) return;
+
+        std::vector<FLOAT_T> best(n, INFTY);  // the lightest edge to the tree
+        std::vector<size_t> from(n, n);       // the vertex it comes from
+        std::vector<bool> in_tree(n, false);
+        std::vector< std::tuple<FLOAT_T, size_t, size_t> > edges;
+        std::vector<FLOAT_T> buf;
+
+        size_t cur = 0;
+        in_tree[cur] = true;
+        for (size_t step=1; step<n; ++step) {
+            const FLOAT_T* Dc = D.row(cur, buf);
+            size_t next = n;
+            for (size_t v=0; v<n; ++v) {
+                if (in_tree[v]) continue;
+                if (Dc[v] < best[v]) {
+                    best[v] = Dc[v];
+                    from[v] = cur;
+                }
+                if (next == n || best[v] < best[next])
+                    next = v;
+            }
+
+            edges.push_back(std::make_tuple(best[next],
+                std::min(from[next], next), std::max(from[next], next)));
+            in_tree[next] = true;
+            cur = next;
+        }
+
+        std::sort(edges.begin(), edges.end());  // lexicographically
+
+        i1.resize(n-1);
+        i2.resize(n-1);
+        d.resize(n-1);
+        for (size_t e=0; e<n-1; ++e) {
+            d[e]  = std::get<0>(edges[e]);
+            i1[e] = std::get<1>(edges[e]);
+            i2[e] = std::get<2>(edges[e]);
+            incident[i1[e]].push_back(e);
+            incident[i2[e]].push_back(e);
+        }
+    }
+};
+
+
+
+/** A dataset X together with some auxiliary data structures
+ *  that are computed on demand and then reused, so that
+ *  many cluster validity index objects built on the same X
+ *  (e.g., for different K or different indices) can share them:
+ *
+ *  - the condensed matrices of pairwise distances (squared or not;
+ *    possibly memory-mapped from a file) or caches of their rows,
+ *  - the M nearest neighbours of each point,
+ *  - the minimum spanning tree,
+ *  - the column means,
+ *  - X transformed for the needs of a metric (see the metric policies).
+ *
+ *  The distances and nearest neighbours are determined w.r.t.
+ *  the metric (and stored in the way) requested by the caller;
+ *  the dataset keeps the structures for each combination separately,
+ *  so that the indices using different settings can share it.
+ *
+ *  Alternatively, a dataset can be given solely by the pairwise distances
+ *  between its points (e.g., for non-vector data), which are then used
+ *  as they are, without copying. Such a dataset has no coordinates
+ *  (X is of size n*0), hence the centroid-based indices cannot be used.
+ *
+ *  Pass it around as a DatasetPtr.
+ */
+class Dataset
+{
+protected:
+    /** (metric, storage or -1 for mmap or -2 for row cache
+     *  or -3 for on the fly, squared) */
+    typedef std::tuple<int, int, bool> DistanceKey;
+
+    std::shared_ptr<const void> X_owner;  ///< manages the buffer X refers to
+    matrix_view<FLOAT_T> X;  ///< data matrix of size n*d
+    const size_t n;     ///< number of points
+    const size_t d;     ///< dataset dimensionality
+
+    std::string distance_file;  ///< see set_distance_file()
+    int distance_file_storage;  ///< CVI_DISTANCE_* used in distance_file
+    std::map< DistanceKey, EuclideanDistance > distances;
+    std::map< std::pair<int, size_t>, std::shared_ptr<const NNGraph> > nn;
+        ///< (metric, M) -> graph
+    std::map< DistanceKey, std::shared_ptr<const MinimumSpanningTree> > mst;
+        ///< key of the squared distances it is built upon -> MST
+    std::map< int, std::shared_ptr< const matrix<FLOAT_T> > > metric_X;
+        ///< metric -> transformed X
+    std::vector<FLOAT_T> column_means; ///< empty if not yet computed
+
+    std::shared_ptr<const void> given_owner;  ///< manages given_distances
+    const FLOAT_T* given_distances;  ///< condensed distance vector or NULL
+
+
+    template<class Metric>
+    void prepare_metric_X()
+    {
+        matrix<FLOAT_T>* Xm = new matrix<FLOAT_T>(X.data(), n, d, true);
+        std::shared_ptr< const matrix<FLOAT_T> > _Xm(Xm);
+        Metric::prepare(*Xm);
+        int key = Metric::type;
+        metric_X[key] = _Xm;
+    }
+
+
+    /** Checks if the given metric can be used, see get_distance()
+     */
+    void check_metric(int metric) const
+    {
+        CVI_ASSERT(metric >= CVI_METRIC_EUCLIDEAN && metric <= CVI_METRIC_MAHALANOBIS);
+        if (!has_coordinates() && metric != CVI_METRIC_EUCLIDEAN)
+            throw std::runtime_error("CVI: the metric cannot be changed for a dataset given by the pairwise distances");
+    }
+
+
+    /** See get_distance(bool, int, int)
+     *
+     * @param squared squared distances?
+     * @param metric one of CVI_METRIC_*
+     * @param distance_storage one of CVI_DISTANCE_*
+     * @param key [out] identifies the distances returned
+     */
+    EuclideanDistance get_distance(bool squared, int metric,
+        int distance_storage, DistanceKey& key)
+    {
+        check_metric(metric);
+        CVI_ASSERT(distance_storage == CVI_DISTANCE_DOUBLE ||
+            distance_storage == CVI_DISTANCE_FLOAT32 ||
+            distance_storage == CVI_DISTANCE_UINT16);
+
+        if (!has_coordinates()) {
+            key = DistanceKey(metric, CVI_DISTANCE_DOUBLE, squared);
+            return EuclideanDistance(X, given_owner, given_distances,
+                CVI_DISTANCE_DOUBLE, 1.0, false, squared);
+        }
+
+        if (!distance_file.empty() && metric == CVI_METRIC_EUCLIDEAN) {
+            if (distance_storage != distance_file_storage)
+                throw std::runtime_error("CVI: the requested distance_storage differs from the distance file's one");
+            key = DistanceKey(metric, -1, squared);  // -1 == memory-mapped
+            if (distances.find(key) == distances.end())
+                distances.insert(std::make_pair(key,
+                    map_distance_file(X, distance_file, squared)));
+            return distances.find(key)->second;
+        }
+
+        key = DistanceKey(metric, distance_storage, squared);
+        std::map< DistanceKey, EuclideanDistance >::iterator it =
+            distances.find(key);
+        if (it != distances.end())
+            return it->second;
+
+        // the other kind of distances (squared or not) already precomputed
+        // serve these too, converted on access: such a view takes
+        // no memory, hence it is not charged to the budget
+        it = distances.find(DistanceKey(metric, distance_storage, !squared));
+        if (it != distances.end())
+            return it->second.as_squared(squared);
+
+        DistanceKey key_cache(metric, -2, squared);  // -2 == row cache
+        it = distances.find(key_cache);
+        if (it != distances.end()) {
+            key = key_cache;
+            return it->second;
+        }
+
+        matrix_view<FLOAT_T> Xm = get_metric_X(metric);
+        const DistancePolicy& policy = cvi_distance_policy();
+        size_t nslots = 0;
+        int mode = policy.choose(n, d,
+            get_distance_storage_size(distance_storage),
+            get_distance_bytes(), &nslots);
+
+        if (mode == CVI_DISTANCE_MODE_ON_THE_FLY) {
+            key = DistanceKey(metric, -3, squared);  // -3 == on the fly
+            return EuclideanDistance(Xm, false, squared,
+                CVI_DISTANCE_DOUBLE, metric);
+        }
+        else if (mode == CVI_DISTANCE_MODE_ROW_CACHE) {
+            key = key_cache;
+            size_t block = std::max((size_t)1, policy.row_block);
+            return distances.insert(std::make_pair(key_cache,
+                EuclideanDistance(Xm, squared, block, nslots, metric))).first->second;
+        }
+
+        // the full matrix has contiguous rows, but takes twice the memory
+        bool full = (distance_storage == CVI_DISTANCE_DOUBLE &&
+            policy.choose_full(n, get_distance_bytes()));
+
+        it = distances.insert(std::make_pair(key,
+            EuclideanDistance(Xm, true, squared, distance_storage, metric, full))).first;
+
+        return it->second;
+    }
+
+
+public:
+    /** Constructor
+     *
+     * @param _X data matrix of size n*d; pass an rvalue
+     *        (e.g., std::move(X)) to avoid copying it
+     */
+    Dataset(matrix<FLOAT_T> _X)
+        : X(NULL, _X.nrow(), _X.ncol()), n(_X.nrow()), d(_X.ncol()),
+          distance_file_storage(CVI_DISTANCE_DOUBLE),
+          given_distances(NULL)
+    {
+        matrix<FLOAT_T>* _Xo = new matrix<FLOAT_T>(std::move(_X));
+        X_owner = std::shared_ptr<const matrix<FLOAT_T> >(_Xo);
+        X = matrix_view<FLOAT_T>(*_Xo);
+    }
+
+
+    /** Constructor: a dataset wrapping a row-major array that is not copied
+     *
+     * @param _X view of the data matrix of size n*d
+     * @param _owner manages the lifetime of the buffer _X refers to
+     */
+    Dataset(const matrix_view<FLOAT_T>& _X,
+            const std::shared_ptr<const void>& _owner)
+        : X_owner(_owner), X(_X), n(_X.nrow()), d(_X.ncol()),
+          distance_file_storage(CVI_DISTANCE_DOUBLE),
+          given_distances(NULL)
+    {
+        ;
+    }
+
+
+    /** Constructor: a dataset given by the pairwise distances
+     *
+     * @param _n number of points
+     * @param _owner manages the lifetime of the buffer
+     * @param _D condensed distance vector of size n*(n-1)/2,
+     *        see pairwise_distances(); it is not copied
+     */
+    Dataset(size_t _n, const std::shared_ptr<const void>& _owner,
+            const FLOAT_T* _D)
+        : X(NULL, _n, 0), n(_n), d(0),
+          distance_file_storage(CVI_DISTANCE_DOUBLE),
+          given_owner(_owner),
+          given_distances(_D)
+    {
+        CVI_ASSERT(_D);
+    }
+
+
+    /** Returns the data matrix */
+    matrix_view<FLOAT_T> get_X() const { return X; }
+
+    /** Returns the number of data points */
+    size_t get_n() const { return n; }
+
+    /** Returns the dataset dimensionality */
+    size_t get_d() const { return d; }
+
+    /** Is X available, or is the dataset given by the pairwise distances? */
+    bool has_coordinates() const { return given_distances == NULL; }
+
+
+    /** Returns X transformed by the given metric policy's prepare(),
+     *  i.e., the matrix on which the raw dissimilarities should be computed
+     *  (X itself for the metrics that require no transformation)
+     *
+     * @param metric one of CVI_METRIC_*
+     */
+    matrix_view<FLOAT_T> get_metric_X(int metric)
+    {
+        if (metric != CVI_METRIC_COSINE && metric != CVI_METRIC_MAHALANOBIS)
+            return X;
+
+        if (metric_X.find(metric) == metric_X.end()) {
+            if (metric == CVI_METRIC_COSINE)
+                prepare_metric_X<MetricCosine>();
+            else
+                prepare_metric_X<MetricMahalanobis>();
+        }
+        return matrix_view<FLOAT_T>(*metric_X[metric]);
+    }
+
+
+    /** Makes get_distance() read the Euclidean distances from a file
+     *  generated by write_distance_file() (via a read-only memory map)
+     *  instead of computing them
+     *
+     * @param fname file name or an empty string to compute the
+     *        distances as usual
+     */
+    void set_distance_file(const std::string& fname)
+    {
+        if (!has_coordinates() && !fname.empty())
+            throw std::runtime_error("CVI: a dataset given by the pairwise distances cannot use a distance file");
+        distance_file = fname;
+        distances.erase(DistanceKey(CVI_METRIC_EUCLIDEAN, -1, false));
+        distances.erase(DistanceKey(CVI_METRIC_EUCLIDEAN, -1, true));
+        mst.erase(DistanceKey(CVI_METRIC_EUCLIDEAN, -1, true));
+        if (!fname.empty()) {  // open now so as to check if the file is valid
+            EuclideanDistance D = map_distance_file(X, fname, false);
+            distance_file_storage = D.get_storage();
+            distances.insert(std::make_pair(
+                DistanceKey(CVI_METRIC_EUCLIDEAN, -1, false), D));
+        }
+    }
+
+
+    /** Returns the number of bytes needed to store a single
+     *  precomputed distance
+     *
+     * @param storage one of CVI_DISTANCE_*
+     */
+    static size_t get_distance_storage_size(int storage)
+    {
+        if (storage == CVI_DISTANCE_FLOAT32) return sizeof(float);
+        else if (storage == CVI_DISTANCE_UINT16) return sizeof(uint16_t);
+        else return sizeof(FLOAT_T);
+    }
+
+
+    /** Returns the number of bytes used by the distance buffers
+     *  (precomputed distances and row caches; memory-mapped files excluded)
+     *  held by this object
+     */
+    size_t get_distance_bytes() const
+    {
+        size_t bytes = 0;
+        for (std::map< DistanceKey, EuclideanDistance >::const_iterator
+                it = distances.begin(); it != distances.end(); ++it)
+            bytes += it->second.get_bytes();
+        return bytes;
+    }
+
+
+    /** Returns an object to compute the distances (w.r.t. a given
+     *  metric) between the points in X.
+     *
+     *  The Euclidean distances are read from the file set by
+     *  set_distance_file(), if any; the requested storage must then agree
+     *  with the file's one. Otherwise, the global DistancePolicy decides
+     *  (given the memory already used by the other distance buffers)
+     *  whether they should be precomputed (in the requested storage),
+     *  (and if so, whether the full matrix should be stored, see
+     *  EuclideanDistance::is_full()), whether the recently used rows
+     *  of the distance matrix should be cached, or whether they should
+     *  be computed on the fly.
+     *  The buffers are shared by all the returned objects;
+     *  in particular, the squared and the non-squared distances
+     *  are served by the same precomputed buffer, whichever was
+     *  requested first (see EuclideanDistance::as_squared()).
+     *
+     *  For a dataset given by the pairwise distances, these are returned
+     *  (and squared on access if needed).
+     *
+     * @param squared squared distances?
+     * @param metric one of CVI_METRIC_EUCLIDEAN (default),
+     *        CVI_METRIC_MANHATTAN, CVI_METRIC_CHEBYSHEV,
+     *        CVI_METRIC_COSINE, CVI_METRIC_MAHALANOBIS
+     * @param distance_storage one of CVI_DISTANCE_DOUBLE (default),
+     *        CVI_DISTANCE_FLOAT32, CVI_DISTANCE_UINT16
+     */
+    EuclideanDistance get_distance(bool squared,
+        int metric=CVI_METRIC_EUCLIDEAN, int distance_storage=CVI_DISTANCE_DOUBLE)
+    {
+        DistanceKey key;
+        return get_distance(squared, metric, distance_storage, key);
+    }
+
+
+    /** Returns the minimum spanning tree w.r.t. the squared distances
+     *  given by get_distance(true, metric, distance_storage),
+     *  see MinimumSpanningTree (the same tree is valid for the non-squared ones)
+     *
+     *  The tree is cached together with the distances it is built upon,
+     *  so that its edge weights are always the ones get_distance()
+     *  returns for the same arguments.
+     *
+     * @param metric one of CVI_METRIC_*
+     * @param distance_storage one of CVI_DISTANCE_*
+     */
+    std::shared_ptr<const MinimumSpanningTree> get_mst(
+        int metric=CVI_METRIC_EUCLIDEAN, int distance_storage=CVI_DISTANCE_DOUBLE)
+    {
+        DistanceKey key;
+        EuclideanDistance D = get_distance(true, metric, distance_storage, key);
+
+        std::map< DistanceKey, std::shared_ptr<const MinimumSpanningTree> >::iterator it =
+            mst.find(key);
+        if (it != mst.end())
+            return it->second;
+
+        std::shared_ptr<const MinimumSpanningTree> t(
+            new MinimumSpanningTree(n, D));
+        mst[key] = t;
+        return t;
+    }
+
+
+    /** Returns the M nearest neighbours of each point
+     *  (w.r.t. a given metric)
+     *
+     *  The graph is computed only once for each M; graphs for smaller M
+     *  are derived from the ones with greater M.
+     *
+     * @param M number of nearest neighbours, 0 < M < n
+     * @param metric one of CVI_METRIC_*
+     */
+    std::shared_ptr<const NNGraph> get_nn(size_t M,
+        int metric=CVI_METRIC_EUCLIDEAN)
+    {
+        check_metric(metric);
+
+        std::pair<int, size_t> key(metric, M);
+        std::map< std::pair<int, size_t>, std::shared_ptr<const NNGraph> >::iterator it =
+            nn.lower_bound(key);  // first graph with >= M neighbours
+
+        if (it != nn.end() && it->first == key)
+            return it->second;
+
+        std::shared_ptr<const NNGraph> g;
+        if (it != nn.end() && it->first.first == metric)
+            g.reset(new NNGraph(*(it->second), M));
+        else if (!has_coordinates())
+            g.reset(new NNGraph(n, get_distance(false), M));
+        else
+            g.reset(new NNGraph(get_metric_X(metric), M, metric));
+        nn[key] = g;
+        return g;
+    }
+
+
+
+
+    /** Returns the centroid of the whole dataset, i.e.,
+     *  the vector of the column means
+     */
+    const std::vector<FLOAT_T>& get_column_means()
+    {
+        if (column_means.size() != d) {
+            std::vector<FLOAT_T> means(d, 0.0);
+            for (size_t i=0; i<n; ++i) {
+                for (size_t j=0; j<d; ++j) {
+                    means[j] += X(i, j);
+                }
+            }
+            for (size_t j=0; j<d; ++j) {
+                means[j] /= (FLOAT_T)n;
+            }
+            column_means.swap(means);
+        }
+        return column_means;
+    }
+};
+
+
+typedef std::shared_ptr<Dataset> DatasetPtr;
+
+
+#endif
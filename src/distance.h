@@ -0,0 +1,1325 @@
+/*  Pairwise distances between the points in a dataset
+ *
+ *  Copyleft (C) 2020-2021, Marek Gagolewski <https://www.gagolewski.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License
+ *  Version 3, 19 November 2007, published by the Free Software Foundation.
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Affero General Public License Version 3 for more details.
+ *  You should have received a copy of the License along with this program.
+ *  If this is not the case, refer to <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DISTANCE_H
+#define __DISTANCE_H
+
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <list>
+#include <limits>
+#include <memory>
+#include <stdint.h>
+#include "common.h"
+#include "matrix.h"
+
+#if defined(__AVX512F__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+
+
+/** Computes the squared Euclidean distance between two vectors.
+ *
+ * @param x c_contiguous vector of length d
+ * @param y c_contiguous vector of length d
+ * @param d length of both x and y
+ * @return sum((x-y)^2)
+ */
+FLOAT_T distance_l2_squared(const FLOAT_T* x, const FLOAT_T* y, size_t d)
+{
+    FLOAT_T ret = 0.0;
+    for (size_t i=0; i<d; i++) {
+        ret += (x[i]-y[i])*(x[i]-y[i]);
+    }
+    return ret;
+}
+
+
+
+/* Distance metrics, see the corresponding metric policies */
+#define CVI_METRIC_EUCLIDEAN   0
+#define CVI_METRIC_MANHATTAN   1
+#define CVI_METRIC_CHEBYSHEV   2
+#define CVI_METRIC_COSINE      3
+#define CVI_METRIC_MAHALANOBIS 4
+
+
+/** Metric policy: the Euclidean distance
+ *
+ *  A metric policy defines how the "raw" dissimilarity between
+ *  two points is computed: combine() is applied on an accumulator
+ *  (initially 0) and each coordinate-wise difference in turn.
+ *  Versions working on SIMD registers are provided as well, so that
+ *  the inner loops can be inlined and vectorised, see distance_raw() and
+ *  pairwise_distances(). A raw value is then converted to the actual
+ *  distance or its square.
+ *
+ *  Some metrics require the data to be transformed beforehand,
+ *  see prepare().
+ */
+struct MetricEuclidean
+{
+    static const int type = CVI_METRIC_EUCLIDEAN;
+
+    static inline FLOAT_T combine(FLOAT_T acc, FLOAT_T t) { return acc+t*t; }
+#ifdef __AVX512F__
+    static inline __m512d combine(__m512d acc, __m512d t) {
+        return _mm512_add_pd(acc, _mm512_mul_pd(t, t));
+    }
+#endif
+#ifdef __AVX__
+    static inline __m256d combine(__m256d acc, __m256d t) {
+        return _mm256_add_pd(acc, _mm256_mul_pd(t, t));
+    }
+#endif
+
+    /** Converts a raw value to the distance */
+    static inline FLOAT_T to_distance(FLOAT_T raw) { return sqrt(raw); }
+
+    /** Converts a raw value to the squared distance */
+    static inline FLOAT_T to_squared(FLOAT_T raw) { return raw; }
+
+    /** Transforms the data matrix (in place) so that the raw values
+     *  computed on the transformed points give the desired metric
+     */
+    static void prepare(matrix<FLOAT_T>& /*X*/) { }
+
+    /** Converts an upper bound for the Euclidean distance between
+     *  the (prepared) points to an upper bound for the metric
+     */
+    static FLOAT_T bound(FLOAT_T l2_bound, size_t /*d*/) { return l2_bound; }
+};
+
+
+/** Metric policy: the Manhattan (L1) distance
+ */
+struct MetricManhattan
+{
+    static const int type = CVI_METRIC_MANHATTAN;
+
+    static inline FLOAT_T combine(FLOAT_T acc, FLOAT_T t) { return acc+std::fabs(t); }
+#ifdef __AVX512F__
+    static inline __m512d combine(__m512d acc, __m512d t) {
+        return _mm512_add_pd(acc, _mm512_abs_pd(t));
+    }
+#endif
+#ifdef __AVX__
+    static inline __m256d combine(__m256d acc, __m256d t) {
+        return _mm256_add_pd(acc, _mm256_andnot_pd(_mm256_set1_pd(-0.0), t));
+    }
+#endif
+
+    static inline FLOAT_T to_distance(FLOAT_T raw) { return raw; }
+    static inline FLOAT_T to_squared(FLOAT_T raw) { return raw*raw; }
+    static void prepare(matrix<FLOAT_T>& /*X*/) { }
+    static FLOAT_T bound(FLOAT_T l2_bound, size_t d) { return l2_bound*sqrt((FLOAT_T)d); }
+};
+
+
+/** Metric policy: the Chebyshev (maximum, L-infinity) distance
+ */
+struct MetricChebyshev
+{
+    static const int type = CVI_METRIC_CHEBYSHEV;
+
+    static inline FLOAT_T combine(FLOAT_T acc, FLOAT_T t) { return std::max(acc, std::fabs(t)); }
+#ifdef __AVX512F__
+    static inline __m512d combine(__m512d acc, __m512d t) {
+        return _mm512_max_pd(acc, _mm512_abs_pd(t));
+    }
+#endif
+#ifdef __AVX__
+    static inline __m256d combine(__m256d acc, __m256d t) {
+        return _mm256_max_pd(acc, _mm256_andnot_pd(_mm256_set1_pd(-0.0), t));
+    }
+#endif
+
+    static inline FLOAT_T to_distance(FLOAT_T raw) { return raw; }
+    static inline FLOAT_T to_squared(FLOAT_T raw) { return raw*raw; }
+    static void prepare(matrix<FLOAT_T>& /*X*/) { }
+    static FLOAT_T bound(FLOAT_T l2_bound, size_t /*d*/) { return l2_bound; }
+};
+
+
+/** Metric policy: the cosine distance, 1-cos(x, y)
+ *
+ *  The points are normalised to unit length beforehand;
+ *  then 1-cos(x, y) = ||x-y||^2/2.
+ */
+struct MetricCosine : public MetricEuclidean
+{
+    static const int type = CVI_METRIC_COSINE;
+
+    static inline FLOAT_T to_distance(FLOAT_T raw) { return 0.5*raw; }
+    static inline FLOAT_T to_squared(FLOAT_T raw) { return 0.25*raw*raw; }
+
+    static void prepare(matrix<FLOAT_T>& X)
+    {
+        size_t n = X.nrow(), d = X.ncol();
+        for (size_t i=0; i<n; ++i) {
+            FLOAT_T norm = 0.0;
+            for (size_t j=0; j<d; ++j) norm += X(i, j)*X(i, j);
+            if (!(norm > 0.0))
+                throw std::runtime_error("CVI: the cosine distance is undefined for zero vectors");
+            norm = sqrt(norm);
+            for (size_t j=0; j<d; ++j) X(i, j) /= norm;
+        }
+    }
+
+    static FLOAT_T bound(FLOAT_T l2_bound, size_t /*d*/) {
+        return std::min((FLOAT_T)2.0, 0.5*l2_bound*l2_bound);
+    }
+};
+
+
+/** Metric policy: the Mahalanobis distance w.r.t. the sample
+ *  covariance matrix, S, of the whole dataset
+ *
+ *  The points are whitened beforehand: given the Cholesky
+ *  decomposition S = L L^T, each x is replaced with L^{-1} x;
+ *  then the Euclidean distances between the transformed points
+ *  are the Mahalanobis distances between the original ones.
+ */
+struct MetricMahalanobis : public MetricEuclidean
+{
+    static const int type = CVI_METRIC_MAHALANOBIS;
+
+    static void prepare(matrix<FLOAT_T>& X)
+    {
+        size_t n = X.nrow(), d = X.ncol();
+        if (n <= d)
+            throw std::runtime_error("CVI: the Mahalanobis distance requires n > d");
+
+        std::vector<FLOAT_T> mean(d, 0.0);
+        for (size_t i=0; i<n; ++i)
+            for (size_t j=0; j<d; ++j) mean[j] += X(i, j);
+        for (size_t j=0; j<d; ++j) mean[j] /= (FLOAT_T)n;
+
+        for (size_t i=0; i<n; ++i)
+            for (size_t j=0; j<d; ++j) X(i, j) -= mean[j];
+
+        matrix<FLOAT_T> L(d, d, 0.0);  // the covariance matrix, then its factor
+        for (size_t i=0; i<n; ++i)
+            for (size_t j=0; j<d; ++j)
+                for (size_t k=0; k<=j; ++k) L(j, k) += X(i, j)*X(i, k);
+        for (size_t j=0; j<d; ++j)
+            for (size_t k=0; k<=j; ++k) L(j, k) /= (FLOAT_T)(n-1);
+
+        // in-place Cholesky decomposition of the lower triangle
+        for (size_t j=0; j<d; ++j) {
+            FLOAT_T s = L(j, j);
+            for (size_t k=0; k<j; ++k) s -= L(j, k)*L(j, k);
+            if (!(s > 0.0))
+                throw std::runtime_error("CVI: the covariance matrix is singular");
+            L(j, j) = sqrt(s);
+            for (size_t i=j+1; i<d; ++i) {
+                FLOAT_T t = L(i, j);
+                for (size_t k=0; k<j; ++k) t -= L(i, k)*L(j, k);
+                L(i, j) = t/L(j, j);
+            }
+        }
+
+        // forward substitution: x := L^{-1} x
+        for (size_t i=0; i<n; ++i) {
+            for (size_t j=0; j<d; ++j) {
+                FLOAT_T t = X(i, j);
+                for (size_t k=0; k<j; ++k) t -= L(j, k)*X(i, k);
+                X(i, j) = t/L(j, j);
+            }
+        }
+    }
+};
+
+
+/** Computes the raw dissimilarity between two vectors
+ *  w.r.t. a given metric policy
+ *
+ * @param x c_contiguous vector of length d
+ * @param y c_contiguous vector of length d
+ * @param d length of both x and y
+ * @return for MetricEuclidean, the same as distance_l2_squared()
+ */
+template<class Metric>
+inline FLOAT_T distance_raw(const FLOAT_T* x, const FLOAT_T* y, size_t d)
+{
+    FLOAT_T ret = 0.0;
+    for (size_t i=0; i<d; i++) {
+        ret = Metric::combine(ret, x[i]-y[i]);
+    }
+    return ret;
+}
+
+
+
+/** Function object computing the distances (or, if Raw, the raw
+ *  dissimilarities) between the rows of a matrix w.r.t. a given
+ *  metric policy on the fly; can be used wherever
+ *  an EuclideanDistance object is accepted as a template argument
+ */
+template<class Metric, bool Raw=false>
+struct __MetricDistance
+{
+    matrix_view<FLOAT_T> X;
+
+    __MetricDistance(const matrix_view<FLOAT_T>& _X) : X(_X) { }
+
+    inline FLOAT_T operator()(size_t i, size_t j) const
+    {
+        FLOAT_T raw = distance_raw<Metric>(X.row(i), X.row(j), X.ncol());
+        return Raw?raw:Metric::to_distance(raw);
+    }
+};
+
+
+/** Number of consecutive points whose coordinates are interleaved
+ *  in a single panel, see pairwise_distances_l2_squared()
+ */
+#define CVI_DISTANCE_PANEL 8
+
+/** Approximate number of bytes of the interleaved data matrix to be kept
+ *  in the cache while processing a single tile of panels,
+ *  see pairwise_distances_l2_squared()
+ */
+#define CVI_DISTANCE_TILE_BYTES 262144
+
+
+
+/** Computes the raw dissimilarities (see the metric policies)
+ *  between the i-th and i+1-th point and the CVI_DISTANCE_PANEL points
+ *  stored in a panel (a helper for pairwise_distances()).
+ *
+ *  Each value is accumulated coordinate by coordinate in the same order
+ *  as in distance_raw() (and, for MetricEuclidean, distance_l2_squared()),
+ *  using the same sequence of operations. Therefore, the results are
+ *  bit-for-bit identical, unless the compiler is permitted to contract
+ *  the scalar version into fused multiply-adds.
+ *
+ * @param x1 c_contiguous vector of length d
+ * @param x2 c_contiguous vector of length d or NULL
+ * @param panel CVI_DISTANCE_PANEL*d array; panel[k*CVI_DISTANCE_PANEL+l]
+ *        gives the k-th coordinate of the l-th point
+ * @param d dimensionality
+ * @param out1 [out] dissimilarities between x1 and the panel's points
+ * @param out2 [out] dissimilarities between x2 and the panel's points
+ */
+template<class Metric>
+inline void __distance_panel(
+    const FLOAT_T* x1, const FLOAT_T* x2, const FLOAT_T* panel, size_t d,
+    FLOAT_T* out1, FLOAT_T* out2)
+{
+#if defined(__AVX512F__) && CVI_DISTANCE_PANEL == 8
+    __m512d a1 = _mm512_setzero_pd();
+    __m512d a2 = _mm512_setzero_pd();
+    for (size_t k=0; k<d; ++k) {
+        __m512d p = _mm512_loadu_pd(panel+k*CVI_DISTANCE_PANEL);
+        __m512d t1 = _mm512_sub_pd(_mm512_set1_pd(x1[k]), p);
+        a1 = Metric::combine(a1, t1);
+        if (x2) {
+            __m512d t2 = _mm512_sub_pd(_mm512_set1_pd(x2[k]), p);
+            a2 = Metric::combine(a2, t2);
+        }
+    }
+    _mm512_storeu_pd(out1, a1);
+    _mm512_storeu_pd(out2, a2);
+#elif defined(__AVX__) && CVI_DISTANCE_PANEL == 8
+    __m256d a1l = _mm256_setzero_pd(), a1h = _mm256_setzero_pd();
+    __m256d a2l = _mm256_setzero_pd(), a2h = _mm256_setzero_pd();
+    for (size_t k=0; k<d; ++k) {
+        __m256d pl = _mm256_loadu_pd(panel+k*CVI_DISTANCE_PANEL);
+        __m256d ph = _mm256_loadu_pd(panel+k*CVI_DISTANCE_PANEL+4);
+        __m256d b1 = _mm256_broadcast_sd(x1+k);
+        __m256d t1l = _mm256_sub_pd(b1, pl), t1h = _mm256_sub_pd(b1, ph);
+        a1l = Metric::combine(a1l, t1l);
+        a1h = Metric::combine(a1h, t1h);
+        if (x2) {
+            __m256d b2 = _mm256_broadcast_sd(x2+k);
+            __m256d t2l = _mm256_sub_pd(b2, pl), t2h = _mm256_sub_pd(b2, ph);
+            a2l = Metric::combine(a2l, t2l);
+            a2h = Metric::combine(a2h, t2h);
+        }
+    }
+    _mm256_storeu_pd(out1, a1l);
+    _mm256_storeu_pd(out1+4, a1h);
+    _mm256_storeu_pd(out2, a2l);
+    _mm256_storeu_pd(out2+4, a2h);
+#else
+    // portable version; each half of the panel is processed
+    // separately so that all the accumulators fit into registers
+    for (size_t h=0; h<CVI_DISTANCE_PANEL; h+=4) {
+        FLOAT_T a10 = 0.0, a11 = 0.0, a12 = 0.0, a13 = 0.0;
+        FLOAT_T a20 = 0.0, a21 = 0.0, a22 = 0.0, a23 = 0.0;
+        const FLOAT_T* p = panel+h;
+        const FLOAT_T* y = (x2)?x2:x1;
+        for (size_t k=0; k<d; ++k, p+=CVI_DISTANCE_PANEL) {
+            a10 = Metric::combine(a10, x1[k]-p[0]);
+            a11 = Metric::combine(a11, x1[k]-p[1]);
+            a12 = Metric::combine(a12, x1[k]-p[2]);
+            a13 = Metric::combine(a13, x1[k]-p[3]);
+            a20 = Metric::combine(a20, y[k]-p[0]);
+            a21 = Metric::combine(a21, y[k]-p[1]);
+            a22 = Metric::combine(a22, y[k]-p[2]);
+            a23 = Metric::combine(a23, y[k]-p[3]);
+        }
+        out1[h+0] = a10; out1[h+1] = a11; out1[h+2] = a12; out1[h+3] = a13;
+        out2[h+0] = a20; out2[h+1] = a21; out2[h+2] = a22; out2[h+3] = a23;
+    }
+#endif
+}
+
+
+
+/** Computes all the pairwise raw dissimilarities w.r.t. a given
+ *  metric policy (e.g., the squared Euclidean distances)
+ *  between the rows of a given matrix, in the condensed form.
+ *
+ *  D[i*n - i*(i+1)/2 + (j-i-1)] will be set to the (encoded) raw
+ *  dissimilarity between the i-th and the j-th row, for all i<j.
+ *
+ *  The points are first interleaved into panels of
+ *  CVI_DISTANCE_PANEL consecutive rows, so that the distances between
+ *  a single point and all the points in a panel can be computed
+ *  using SIMD instructions (AVX-512, AVX or whatever the compiler
+ *  vectorises the portable version to). The panels are processed in tiles
+ *  that fit in the cache; each tile is paired with all the points
+ *  to its left, two at a time, so that the results are written to
+ *  contiguous chunks of D.
+ *
+ *  The results are the same as the ones generated by
+ *  distance_raw(), see __distance_panel().
+ *
+ *  The computations are distributed amongst cvi_get_num_threads() threads;
+ *  the results do not depend on the number of threads.
+ *
+ *  Time complexity: O(n^2 d). Additional memory: O(n d).
+ *
+ *  Optionally, only the distances between the rows in [r0, r1) and
+ *  the rows that follow them can be computed, so that the condensed
+ *  matrix can be generated block by block. Then D[0] corresponds to
+ *  the pair (r0, r0+1).
+ *
+ * @param X c_contiguous matrix of size n*d
+ * @param n number of rows
+ * @param d number of columns
+ * @param D [out] array of size n*(n-1)/2 (or the corresponding block)
+ * @param encode a function object applied on each raw value
+ *        before storing it in D, e.g., to take the square root
+ *        or to convert it to a different type
+ * @param r0 first row
+ * @param r1 one past the last row (or 0 for n)
+ */
+template<class Metric, class T, class Encoder>
+void pairwise_distances(
+    const FLOAT_T* X, size_t n, size_t d, T* D, const Encoder& encode,
+    size_t r0=0, size_t r1=0)
+{
+    if (r1 == 0 || r1 > n) r1 = n;
+    if (n <= 1 || r0+1 >= n || r0 >= r1) return;
+
+    const size_t P = CVI_DISTANCE_PANEL;
+    size_t npanels = (n+P-1)/P;
+    size_t pstart = (r0+1)/P;  // the first panel with a point > r0
+    std::vector<FLOAT_T> panels((npanels-pstart)*P*d, 0.0); // zero-padded
+    for (size_t j=pstart*P; j<n; ++j) {
+        FLOAT_T* panel = panels.data()+(j/P-pstart)*P*d;
+        for (size_t k=0; k<d; ++k)
+            panel[k*P+j%P] = X[j*d+k];
+    }
+
+    size_t k0 = r0*n - r0*(r0+1)/2;  // index of (r0, r0+1)
+
+    // number of panels that fit in a tile
+    size_t tile = CVI_DISTANCE_TILE_BYTES/(sizeof(FLOAT_T)*P*std::max(d, (size_t)1));
+    tile = std::max((size_t)2, tile);
+
+    #ifdef _OPENMP
+    #pragma omp parallel num_threads(cvi_get_num_threads())
+    #endif
+    {
+        FLOAT_T out1[CVI_DISTANCE_PANEL], out2[CVI_DISTANCE_PANEL];
+        for (size_t p0=pstart; p0<npanels; p0+=tile) {
+            size_t p1 = std::min(p0+tile, npanels);  // panels [p0, p1) in this tile
+            size_t j1 = std::min(p1*P, n);           // i.e., points [p0*P, j1)
+            size_t imax = std::min(r1, j1-1);
+
+            // process two rows at a time; each thread writes to different rows
+            #ifdef _OPENMP
+            #pragma omp for schedule(dynamic, 4)
+            #endif
+            for (size_t i=r0; i<imax; i+=2) {
+                size_t m = (i+2<j1 && i+1<r1)?2:1;
+                const FLOAT_T* x2 = (m==2)?(X+(i+1)*d):NULL;
+                for (size_t p=std::max(p0, (i+1)/P); p<p1; ++p) {
+                    size_t j0 = p*P;
+                    size_t jmax = std::min(j0+P, n);
+                    __distance_panel<Metric>(X+i*d, x2,
+                        panels.data()+(p-pstart)*P*d, d, out1, out2);
+
+                    for (size_t u=0; u<m; ++u) {
+                        const FLOAT_T* out = (u==0)?out1:out2;
+                        size_t iu = i+u;
+                        size_t k = iu*n - iu*(iu+1)/2 - k0;  // index of (iu, iu+1) in D
+                        for (size_t j=std::max(j0, iu+1); j<jmax; ++j)
+                            D[k+(j-iu-1)] = encode(out[j-j0]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+
+
+/** Computes all the pairwise squared Euclidean distances
+ *  between the rows of a given matrix, in the condensed form,
+ *  see pairwise_distances().
+ */
+template<class T, class Encoder>
+void pairwise_distances_l2_squared(
+    const FLOAT_T* X, size_t n, size_t d, T* D, const Encoder& encode,
+    size_t r0=0, size_t r1=0)
+{
+    pairwise_distances<MetricEuclidean>(X, n, d, D, encode, r0, r1);
+}
+
+
+/** Identity encoder for pairwise_distances() */
+struct __DistanceIdentity
+{
+    FLOAT_T operator()(FLOAT_T x) const { return x; }
+};
+
+
+/** Computes all the pairwise squared Euclidean distances
+ *  between the rows of a given matrix, in the condensed form.
+ *
+ * @param X c_contiguous matrix of size n*d
+ * @param n number of rows
+ * @param d number of columns
+ * @param D [out] array of size n*(n-1)/2
+ */
+void pairwise_distances_l2_squared(
+    const FLOAT_T* X, size_t n, size_t d, FLOAT_T* D)
+{
+    pairwise_distances_l2_squared(X, n, d, D, __DistanceIdentity());
+}
+
+
+
+
+/* Types of storage for the precomputed distances, see EuclideanDistance */
+#define CVI_DISTANCE_DOUBLE  0  ///< 64-bit floats
+#define CVI_DISTANCE_FLOAT32 1  ///< 32-bit floats
+#define CVI_DISTANCE_UINT16  2  ///< 16-bit unsigned integers times a scale
+
+
+/** Storage policy: distances stored as FLOAT_Ts (exact)
+ */
+struct DistanceStorageDouble
+{
+    typedef FLOAT_T value_type;
+    static const int type = CVI_DISTANCE_DOUBLE;
+    const FLOAT_T scale;
+
+    DistanceStorageDouble(FLOAT_T /*max_dist*/) : scale(1.0) { }
+    value_type encode(FLOAT_T x) const { return x; }
+    FLOAT_T decode(value_type x) const { return x; }
+};
+
+
+/** Storage policy: distances stored as single precision floats
+ *  (relative error of up to ~6e-8)
+ */
+struct DistanceStorageFloat32
+{
+    typedef float value_type;
+    static const int type = CVI_DISTANCE_FLOAT32;
+    const FLOAT_T scale;
+
+    DistanceStorageFloat32(FLOAT_T /*max_dist*/) : scale(1.0) { }
+    value_type encode(FLOAT_T x) const { return (float)x; }
+    FLOAT_T decode(value_type x) const { return (FLOAT_T)x; }
+};
+
+
+/** Storage policy: distances stored as 16-bit unsigned integers, being
+ *  multiples of a per-matrix scale, max_dist/65535
+ *  (absolute error of up to max_dist/131070)
+ *
+ *  Only non-squared distances are stored this way (and squared on access
+ *  if needed): with the step of max_dist^2/65535, the small squared
+ *  distances would be rounded to a few multiples of it or to zero.
+ */
+struct DistanceStorageUInt16
+{
+    typedef uint16_t value_type;
+    static const int type = CVI_DISTANCE_UINT16;
+    const FLOAT_T scale;
+
+    DistanceStorageUInt16(FLOAT_T max_dist)
+        : scale((max_dist > 0.0)?(max_dist/65535.0):1.0) { }
+
+    value_type encode(FLOAT_T x) const {
+        FLOAT_T q = std::floor(x/scale+0.5);
+        return (value_type)((q < 65535.0)?q:65535.0);
+    }
+    FLOAT_T decode(value_type x) const { return scale*(FLOAT_T)x; }
+};
+
+
+/** Encoder for pairwise_distances() that converts the raw values
+ *  to distances or squared distances (see the metric policies)
+ *  and applies a storage policy
+ */
+template<class Storage, class Metric=MetricEuclidean>
+struct __DistanceEncoder
+{
+    const Storage& storage;
+    const bool squared;
+
+    __DistanceEncoder(const Storage& _storage, bool _squared)
+        : storage(_storage), squared(_squared) { }
+
+    typename Storage::value_type operator()(FLOAT_T x) const {
+        return storage.encode(squared?Metric::to_squared(x):Metric::to_distance(x));
+    }
+};
+
+
+/** Returns an upper bound for the Euclidean distance between any two rows
+ *  of a given matrix: the smaller of the bounding box's diagonal and twice
+ *  the greatest distance from the centroid.
+ *
+ *  Time complexity: O(n d).
+ *
+ * @param X data matrix
+ * @return
+ */
+FLOAT_T max_distance_bound(const matrix_view<FLOAT_T>& X)
+{
+    size_t n = X.nrow(), d = X.ncol();
+    if (n <= 1) return 0.0;
+
+    std::vector<FLOAT_T> xmin(X.row(0), X.row(0)+d);
+    std::vector<FLOAT_T> xmax(X.row(0), X.row(0)+d);
+    std::vector<FLOAT_T> xmean(d, 0.0);
+    for (size_t i=0; i<n; ++i) {
+        for (size_t j=0; j<d; ++j) {
+            xmin[j] = std::min(xmin[j], X(i, j));
+            xmax[j] = std::max(xmax[j], X(i, j));
+            xmean[j] += X(i, j);
+        }
+    }
+
+    FLOAT_T diag = 0.0;
+    for (size_t j=0; j<d; ++j) {
+        diag += square(xmax[j]-xmin[j]);
+        xmean[j] /= (FLOAT_T)n;
+    }
+
+    FLOAT_T radius = 0.0;
+    for (size_t i=0; i<n; ++i)
+        radius = std::max(radius, distance_l2_squared(X.row(i), xmean.data(), d));
+
+    // add some slack for the round-off errors
+    return std::min(sqrt(diag), 2.0*sqrt(radius))*(1.0+1e-12);
+}
+
+
+
+
+/* The ways in which EuclideanDistance can provide the distances */
+#define CVI_DISTANCE_MODE_ON_THE_FLY   0  ///< computed on each access
+#define CVI_DISTANCE_MODE_PRECOMPUTED  1  ///< condensed matrix in memory
+#define CVI_DISTANCE_MODE_ROW_CACHE    2  ///< cache of recently used rows
+#define CVI_DISTANCE_MODE_MAPPED       3  ///< memory-mapped file
+
+
+/** Approximate size of the buffer used to generate a block of rows
+ *  of the condensed distance matrix when the full one is precomputed,
+ *  see EuclideanDistance::is_full()
+ */
+#define CVI_DISTANCE_FULL_BLOCK_BYTES 67108864
+
+
+/** Decides how the pairwise distances should be provided
+ *  given the available memory, see DistancePolicy::choose().
+ *
+ *  The global instance, consulted whenever a Dataset needs
+ *  a new EuclideanDistance object, is returned by cvi_distance_policy().
+ */
+struct DistancePolicy
+{
+    /** Memory budget (in bytes) for all the distance buffers of
+     *  a single dataset (shared by all the CVI objects based on it)
+     */
+    size_t max_bytes;
+
+    /** Estimated cost of reading a cached distance, relative to
+     *  the cost of processing one coordinate when computing a distance
+     *  on the fly; the row cache is not used if d <= access_cost
+     */
+    FLOAT_T access_cost;
+
+    /** Number of consecutive rows that are computed and cached together
+     */
+    size_t row_block;
+
+    /** Minimal number of row blocks that must fit in the memory budget
+     *  for the row cache to be used
+     */
+    size_t min_row_blocks;
+
+    /** Shall the full n*n matrix be precomputed instead of the condensed
+     *  one if it fits in the budget? See choose_full().
+     */
+    bool full_matrix;
+
+
+    DistancePolicy()
+        : max_bytes((size_t)10000*9999/2*sizeof(FLOAT_T)),  // n=10000, double
+          access_cost(8.0), row_block(1), min_row_blocks(16),
+          full_matrix(true)
+    { }
+
+
+    /** Chooses the mode: full precomputation if the condensed matrix fits
+     *  in the budget, the row cache if there is enough memory left for it
+     *  and the distances are costly to compute, on the fly otherwise.
+     *
+     * @param n number of points
+     * @param d dimensionality
+     * @param value_size bytes per a precomputed distance (storage type)
+     * @param bytes_in_use bytes already used by the dataset's other buffers
+     * @param nslots [out] number of row blocks to cache (if applicable)
+     * @return one of CVI_DISTANCE_MODE_*
+     */
+    int choose(size_t n, size_t d, size_t value_size, size_t bytes_in_use,
+        size_t* nslots=NULL) const
+    {
+        size_t avail = (bytes_in_use < max_bytes)?(max_bytes-bytes_in_use):0;
+        if (n <= 1 || n*(n-1)/2*value_size <= avail)
+            return CVI_DISTANCE_MODE_PRECOMPUTED;
+
+        size_t block_bytes = std::max((size_t)1, row_block)*n*sizeof(FLOAT_T);
+        size_t nblocks = avail/block_bytes;
+        if ((FLOAT_T)d > access_cost && nblocks >= std::max((size_t)1, min_row_blocks)) {
+            if (nslots) *nslots = nblocks;
+            return CVI_DISTANCE_MODE_ROW_CACHE;
+        }
+
+        return CVI_DISTANCE_MODE_ON_THE_FLY;
+    }
+
+
+    /** Once choose() has decided that the distances are to be precomputed
+     *  and they are to be stored as FLOAT_Ts, determines whether the full
+     *  matrix (twice the memory) should be stored instead of the condensed
+     *  one, so that each row is contiguous, see EuclideanDistance::row().
+     *
+     *  No room needs to be left for the other kind of distances
+     *  (squared or not): Dataset::get_distance() derives them from
+     *  this buffer, see EuclideanDistance::as_squared().
+     *
+     * @param n number of points
+     * @param bytes_in_use bytes already used by the dataset's other buffers
+     * @return
+     */
+    bool choose_full(size_t n, size_t bytes_in_use) const
+    {
+        size_t avail = (bytes_in_use < max_bytes)?(max_bytes-bytes_in_use):0;
+        return full_matrix && n*n*sizeof(FLOAT_T) <= avail;
+    }
+};
+
+
+/** Returns the global distance policy (which can be modified)
+ */
+inline DistancePolicy& cvi_distance_policy()
+{
+    static DistancePolicy policy;
+    return policy;
+}
+
+
+/** A cache of blocks of full rows of the distance matrix,
+ *  with the least recently used block evicted first
+ *  (for internal use in EuclideanDistance)
+ */
+struct __DistanceRowCache
+{
+    size_t block;   ///< number of rows in each block
+    size_t nslots;  ///< number of blocks that can be cached
+    std::vector<FLOAT_T> buf;        ///< cached rows, nslots*block*n
+    std::vector<size_t> block_slot;  ///< slot of each block or SIZE_MAX
+    std::vector<size_t> slot_block;  ///< block in each slot or SIZE_MAX
+    std::list<size_t> lru;           ///< slots, most recently used first
+    std::vector< std::list<size_t>::iterator > slot_pos; ///< slot -> lru item
+    size_t hits;    ///< number of distances read from the cache
+    size_t misses;  ///< number of blocks computed
+
+    __DistanceRowCache(size_t n, size_t _block, size_t _nslots)
+        : block(_block), nslots(_nslots),
+          buf(_nslots*_block*n),
+          block_slot((n+_block-1)/_block, std::numeric_limits<size_t>::max()),
+          slot_block(_nslots, std::numeric_limits<size_t>::max()),
+          slot_pos(_nslots),
+          hits(0), misses(0)
+    {
+        for (size_t s=0; s<nslots; ++s)
+            slot_pos[s] = lru.insert(lru.end(), s);
+    }
+
+
+    /** Returns the slot holding the b-th block (and marks it as
+     *  the most recently used one) or SIZE_MAX if it is not cached
+     */
+    size_t find(size_t b)
+    {
+        size_t s = block_slot[b];
+        if (s != std::numeric_limits<size_t>::max() && slot_pos[s] != lru.begin())
+            lru.splice(lru.begin(), lru, slot_pos[s]);
+        return s;
+    }
+
+
+    /** Evicts the least recently used block and returns its slot,
+     *  which is now assigned to the b-th block
+     */
+    size_t assign(size_t b)
+    {
+        size_t s = lru.back();
+        if (slot_block[s] != std::numeric_limits<size_t>::max())
+            block_slot[slot_block[s]] = std::numeric_limits<size_t>::max();
+        slot_block[s] = b;
+        block_slot[b] = s;
+        lru.splice(lru.begin(), lru, slot_pos[s]);
+        return s;
+    }
+};
+
+
+
+
+/** Computes Euclidean distances between pairs of points in the same dataset.
+ *  Results might be precomputed for smaller datasets.
+ *
+ *  Other metrics are supported too, see the metric policies
+ *  (e.g., MetricManhattan); the switch over the metric type is made
+ *  once per distance (or once per precomputed matrix or cached row),
+ *  the inner loops are specialised for each metric.
+ *
+ *  The precomputed distances can be stored as doubles (exact),
+ *  32-bit floats (half the memory) or quantised to 16-bit integers
+ *  (a quarter of the memory), see CVI_DISTANCE_DOUBLE,
+ *  CVI_DISTANCE_FLOAT32, CVI_DISTANCE_UINT16 and the corresponding
+ *  storage policies.
+ *
+ *  Alternatively, the recently used rows of the distance matrix can
+ *  be cached (see DistancePolicy) or the distances can be read from
+ *  a memory-mapped file (see map_distance_file()).
+ *
+ *  Distances stored as doubles can also be precomputed in the form
+ *  of the full n*n matrix (see is_full()), in which each row is contiguous;
+ *  whole rows are accessed via row() in all the modes.
+ *
+ *  Objects of this class are lightweight handles: copies share the same
+ *  (immutable) buffer with the precomputed distances (or the same cache).
+ *  An object in the row cache mode must not be used by many threads
+ *  simultaneously, see is_thread_safe().
+ */
+class EuclideanDistance
+{
+private:
+    matrix_view<FLOAT_T> X;
+    std::shared_ptr<const void> D;  ///< owns the precomputed distances
+    const void* Dp;   ///< D.get() or NULL
+    int storage;      ///< one of CVI_DISTANCE_*
+    FLOAT_T scale;    ///< for CVI_DISTANCE_UINT16
+    bool precomputed;
+    bool full;        ///< the full n*n matrix stored row by row?
+    bool squared;
+    bool stored_squared;  ///< are the precomputed distances squared?
+    int mode;             ///< one of CVI_DISTANCE_MODE_*
+    int metric;           ///< one of CVI_METRIC_*
+    std::shared_ptr<__DistanceRowCache> cache;  ///< or NULL
+    size_t n;
+    size_t d;
+
+
+    /** Computes D(i, j) w.r.t. a given metric policy */
+    template<class Metric>
+    inline FLOAT_T compute(size_t i, size_t j) const
+    {
+        FLOAT_T raw = distance_raw<Metric>(X.row(i), X.row(j), d);
+        return squared?Metric::to_squared(raw):Metric::to_distance(raw);
+    }
+
+
+    /** Computes D(i, j) w.r.t. the current metric */
+    inline FLOAT_T compute(size_t i, size_t j) const
+    {
+        switch (metric) {
+            case CVI_METRIC_MANHATTAN:   return compute<MetricManhattan>(i, j);
+            case CVI_METRIC_CHEBYSHEV:   return compute<MetricChebyshev>(i, j);
+            case CVI_METRIC_COSINE:      return compute<MetricCosine>(i, j);
+            case CVI_METRIC_MAHALANOBIS: return compute<MetricMahalanobis>(i, j);
+            default:                     return compute<MetricEuclidean>(i, j);
+        }
+    }
+
+
+    /** Computes the r-th row of the distance matrix */
+    template<class Metric>
+    void compute_row(size_t r, FLOAT_T* row) const
+    {
+        for (size_t u=0; u<n; ++u)
+            row[u] = (u == r)?0.0:compute<Metric>(r, u);
+    }
+
+
+    /** Gets D(i, j) from the row cache, computing the block of rows
+     *  that includes the i-th one if neither the i-th nor the j-th row
+     *  is available
+     */
+    FLOAT_T get_cached(size_t i, size_t j) const
+    {
+        __DistanceRowCache& c = *cache;
+        size_t s = c.find(i/c.block);
+        if (s != std::numeric_limits<size_t>::max()) {
+            ++c.hits;
+            return c.buf[(s*c.block+i%c.block)*n+j];
+        }
+
+        s = c.find(j/c.block);
+        if (s != std::numeric_limits<size_t>::max()) {
+            ++c.hits;
+            return c.buf[(s*c.block+j%c.block)*n+i];
+        }
+
+        ++c.misses;
+        size_t b = i/c.block;
+        s = c.assign(b);
+        size_t r0 = b*c.block, r1 = std::min(n, r0+c.block);
+        for (size_t r=r0; r<r1; ++r) {
+            FLOAT_T* row = c.buf.data()+(s*c.block+r-r0)*n;
+            switch (metric) {
+                case CVI_METRIC_MANHATTAN:   compute_row<MetricManhattan>(r, row); break;
+                case CVI_METRIC_CHEBYSHEV:   compute_row<MetricChebyshev>(r, row); break;
+                case CVI_METRIC_COSINE:      compute_row<MetricCosine>(r, row); break;
+                case CVI_METRIC_MAHALANOBIS: compute_row<MetricMahalanobis>(r, row); break;
+                default:                     compute_row<MetricEuclidean>(r, row);
+            }
+        }
+        return c.buf[(s*c.block+i%c.block)*n+j];
+    }
+
+
+    template<class Storage, class Metric>
+    void precompute()
+    {
+        FLOAT_T max_dist = 0.0;
+        if (Storage::type == CVI_DISTANCE_UINT16) {
+            CVI_ASSERT(!stored_squared);
+            max_dist = Metric::bound(max_distance_bound(X), d);
+        }
+        Storage s(max_dist);
+        scale = s.scale;
+
+        std::vector<typename Storage::value_type>* _D =
+            new std::vector<typename Storage::value_type>(n*(n-1)/2);
+        D.reset(_D);
+        Dp = _D->data();
+
+        pairwise_distances<Metric>(X.data(), n, d, _D->data(),
+            __DistanceEncoder<Storage, Metric>(s, stored_squared));
+    }
+
+
+    /** Precomputes the full matrix, stored row by row as FLOAT_Ts;
+     *  the condensed matrix is generated block by block (see
+     *  pairwise_distances()) and each block is copied to the upper
+     *  and the lower triangle
+     */
+    template<class Metric>
+    void precompute_full()
+    {
+        DistanceStorageDouble s(0.0);
+        std::vector<FLOAT_T>* _D = new std::vector<FLOAT_T>(n*n, 0.0);
+        D.reset(_D);
+        Dp = _D->data();
+        FLOAT_T* F = _D->data();
+
+        size_t max_block = std::max((size_t)(n-1),
+            (size_t)CVI_DISTANCE_FULL_BLOCK_BYTES/sizeof(FLOAT_T));
+        std::vector<FLOAT_T> buf;
+        std::vector<size_t> offset;  // where the i-th row starts in buf
+        size_t r0 = 0;
+        while (r0+1 < n) {
+            size_t r1 = r0, size = 0;
+            offset.clear();
+            while (r1+1 < n && size+(n-r1-1) <= max_block) {
+                offset.push_back(size);
+                size += n-r1-1;  // number of pairs (r1, j) with j > r1
+                ++r1;
+            }
+
+            buf.resize(size);
+            pairwise_distances<Metric>(X.data(), n, d, buf.data(),
+                __DistanceEncoder<DistanceStorageDouble, Metric>(s, squared), r0, r1);
+
+            #ifdef _OPENMP
+            #pragma omp parallel for schedule(dynamic, 16) num_threads(cvi_get_num_threads())
+            #endif
+            for (size_t i=r0; i<r1; ++i) {
+                const FLOAT_T* b = buf.data()+offset[i-r0];
+                for (size_t j=i+1; j<n; ++j)
+                    F[i*n+j] = F[j*n+i] = b[j-i-1];
+            }
+
+            r0 = r1;
+        }
+    }
+
+
+    template<class Storage>
+    void precompute()
+    {
+        if (full) {
+            switch (metric) {
+                case CVI_METRIC_MANHATTAN:   precompute_full<MetricManhattan>(); break;
+                case CVI_METRIC_CHEBYSHEV:   precompute_full<MetricChebyshev>(); break;
+                case CVI_METRIC_COSINE:      precompute_full<MetricCosine>(); break;
+                case CVI_METRIC_MAHALANOBIS: precompute_full<MetricMahalanobis>(); break;
+                default:                     precompute_full<MetricEuclidean>();
+            }
+            return;
+        }
+
+        switch (metric) {
+            case CVI_METRIC_MANHATTAN:   precompute<Storage, MetricManhattan>(); break;
+            case CVI_METRIC_CHEBYSHEV:   precompute<Storage, MetricChebyshev>(); break;
+            case CVI_METRIC_COSINE:      precompute<Storage, MetricCosine>(); break;
+            case CVI_METRIC_MAHALANOBIS: precompute<Storage, MetricMahalanobis>(); break;
+            default:                     precompute<Storage, MetricEuclidean>();
+        }
+    }
+
+
+public:
+    /** Constructor
+     *
+     * @param _X dataset
+     * @param _precompute shall the distances be precomputed?
+     * @param _square squared Euclidean distances?
+     * @param _storage how to store the precomputed distances,
+     *        one of CVI_DISTANCE_DOUBLE, CVI_DISTANCE_FLOAT32,
+     *        CVI_DISTANCE_UINT16
+     * @param _metric one of CVI_METRIC_*; _X must have been transformed
+     *        by the corresponding policy's prepare()
+     * @param _full shall the full matrix be precomputed instead of the
+     *        condensed one? (only for CVI_DISTANCE_DOUBLE)
+     */
+    EuclideanDistance(const matrix_view<FLOAT_T>& _X, bool _precompute=false,
+            bool _square=false, int _storage=CVI_DISTANCE_DOUBLE,
+            int _metric=CVI_METRIC_EUCLIDEAN, bool _full=false)
+        : X(_X),
+          Dp(NULL),
+          storage(_storage),
+          scale(1.0),
+          precomputed(_precompute),
+          full(_precompute && _full),
+          squared(_square),
+          stored_squared(_square && _storage != CVI_DISTANCE_UINT16),
+          mode(_precompute?CVI_DISTANCE_MODE_PRECOMPUTED:CVI_DISTANCE_MODE_ON_THE_FLY),
+          metric(_metric),
+          n(_X.nrow()),
+          d(_X.ncol())
+    {
+        if (!_precompute) return;
+
+        CVI_ASSERT(!full || storage == CVI_DISTANCE_DOUBLE);
+        if (storage == CVI_DISTANCE_DOUBLE)
+            precompute<DistanceStorageDouble>();
+        else if (storage == CVI_DISTANCE_FLOAT32)
+            precompute<DistanceStorageFloat32>();
+        else if (storage == CVI_DISTANCE_UINT16)
+            precompute<DistanceStorageUInt16>();
+        else
+            CVI_ASSERT(false);
+    }
+
+
+    /** Uses already precomputed distances (stored as FLOAT_Ts)
+     *
+     * @param _X dataset
+     * @param _D condensed distance vector of size n*(n-1)/2,
+     *        see pairwise_distances_l2_squared(), or the full
+     *        matrix of size n*n (row by row)
+     * @param _square are the distances in _D squared?
+     * @param _metric one of CVI_METRIC_*
+     */
+    EuclideanDistance(const matrix_view<FLOAT_T>& _X,
+            const std::shared_ptr< const std::vector<FLOAT_T> >& _D,
+            bool _square, int _metric=CVI_METRIC_EUCLIDEAN)
+        : X(_X),
+          D(_D),
+          Dp(_D->data()),
+          storage(CVI_DISTANCE_DOUBLE),
+          scale(1.0),
+          precomputed(true),
+          full(_X.nrow() > 1 && _D->size() == _X.nrow()*_X.nrow()),
+          squared(_square),
+          stored_squared(_square),
+          mode(CVI_DISTANCE_MODE_PRECOMPUTED),
+          metric(_metric),
+          n(_X.nrow()),
+          d(_X.ncol())
+    {
+        CVI_ASSERT(full || _D->size() == n*(n-1)/2);
+    }
+
+
+    /** Caches the recently used rows of the distance matrix
+     *
+     * @param _X dataset
+     * @param _square squared Euclidean distances?
+     * @param block number of consecutive rows computed and cached together
+     * @param nslots number of blocks of rows that can be cached
+     * @param _metric one of CVI_METRIC_*
+     */
+    EuclideanDistance(const matrix_view<FLOAT_T>& _X, bool _square,
+            size_t block, size_t nslots, int _metric=CVI_METRIC_EUCLIDEAN)
+        : X(_X),
+          Dp(NULL),
+          storage(CVI_DISTANCE_DOUBLE),
+          scale(1.0),
+          precomputed(false),
+          full(false),
+          squared(_square),
+          stored_squared(_square),
+          mode(CVI_DISTANCE_MODE_ROW_CACHE),
+          metric(_metric),
+          cache(new __DistanceRowCache(_X.nrow(), block, nslots)),
+          n(_X.nrow()),
+          d(_X.ncol())
+    {
+        CVI_ASSERT(block >= 1 && nslots >= 1);
+    }
+
+
+    /** Uses already precomputed distances stored in an arbitrary
+     *  buffer (e.g., a memory-mapped file)
+     *
+     *  If the stored distances are squared and non-squared ones
+     *  are requested (or vice versa), they are converted on access.
+     *
+     * @param _X dataset
+     * @param _owner manages the lifetime of the buffer
+     * @param _Dp condensed distance vector of size n*(n-1)/2,
+     *        see pairwise_distances_l2_squared()
+     * @param _storage one of CVI_DISTANCE_*
+     * @param _scale for CVI_DISTANCE_UINT16, see DistanceStorageUInt16
+     * @param _stored_squared are the distances in _Dp squared?
+     * @param _square squared Euclidean distances requested?
+     * @param _mode CVI_DISTANCE_MODE_PRECOMPUTED or CVI_DISTANCE_MODE_MAPPED
+     */
+    EuclideanDistance(const matrix_view<FLOAT_T>& _X,
+            const std::shared_ptr<const void>& _owner, const void* _Dp,
+            int _storage, FLOAT_T _scale, bool _stored_squared, bool _square,
+            int _mode=CVI_DISTANCE_MODE_PRECOMPUTED)
+        : X(_X),
+          D(_owner),
+          Dp(_Dp),
+          storage(_storage),
+          scale(_scale),
+          precomputed(true),
+          full(false),
+          squared(_square),
+          stored_squared(_stored_squared),
+          mode(_mode),
+          metric(CVI_METRIC_EUCLIDEAN),
+          n(_X.nrow()),
+          d(_X.ncol())
+    {
+        CVI_ASSERT(storage == CVI_DISTANCE_DOUBLE ||
+            storage == CVI_DISTANCE_FLOAT32 || storage == CVI_DISTANCE_UINT16);
+    }
+
+
+    /** Are the distances precomputed? */
+    bool is_precomputed() const { return precomputed; }
+
+    /** Is the full n*n matrix stored (so that row() gives direct access
+     *  to the precomputed distances)? */
+    bool is_full() const { return full; }
+
+    /** Are these squared distances? */
+    bool is_squared() const { return squared; }
+
+    /** Storage type, one of CVI_DISTANCE_* */
+    int get_storage() const { return storage; }
+
+    /** How the distances are provided, one of CVI_DISTANCE_MODE_* */
+    int get_mode() const { return mode; }
+
+    /** Metric, one of CVI_METRIC_* */
+    int get_metric() const { return metric; }
+
+    /** Number of distances read from the row cache so far
+     *  (by this object and all its copies)
+     */
+    size_t get_cache_hits() const { return cache?cache->hits:0; }
+
+    /** Number of blocks of rows computed by the row cache so far
+     *  (by this object and all its copies)
+     */
+    size_t get_cache_misses() const { return cache?cache->misses:0; }
+
+    /** Number of rows that the row cache can hold (0 if not used) */
+    size_t get_cache_rows() const { return cache?cache->nslots*cache->block:0; }
+
+    /** Can operator() be called by many threads simultaneously? */
+    bool is_thread_safe() const { return !cache; }
+
+
+    /** Returns a copy that can be used by another thread:
+     *  the precomputed distances are shared, but in the row cache mode
+     *  the copy gets its own (empty) cache of the same size
+     */
+    EuclideanDistance clone() const
+    {
+        EuclideanDistance ret(*this);
+        if (cache)
+            ret.cache.reset(new __DistanceRowCache(n, cache->block, cache->nslots));
+        return ret;
+    }
+
+    /** Number of bytes used by the precomputed distances or the row cache
+     *  (0 if they are memory-mapped)
+     */
+    size_t get_bytes() const
+    {
+        if (cache)
+            return cache->buf.size()*sizeof(FLOAT_T);
+        else if (mode == CVI_DISTANCE_MODE_PRECOMPUTED) {
+            if (full) return n*n*sizeof(FLOAT_T);
+            else if (storage == CVI_DISTANCE_FLOAT32) return n*(n-1)/2*sizeof(float);
+            else if (storage == CVI_DISTANCE_UINT16) return n*(n-1)/2*sizeof(uint16_t);
+            else return n*(n-1)/2*sizeof(FLOAT_T);
+        }
+        else
+            return 0;
+    }
+
+
+    /** Returns a handle to the same precomputed distances that gives
+     *  the squared ones (if _square) or the non-squared ones,
+     *  converting them on access if they are stored otherwise;
+     *  no new buffer is allocated
+     *
+     * @param _square
+     * @return
+     */
+    EuclideanDistance as_squared(bool _square) const
+    {
+        CVI_ASSERT(precomputed);
+        EuclideanDistance ret(*this);
+        ret.squared = _square;
+        return ret;
+    }
+
+
+    const FLOAT_T operator()(size_t i, size_t j) const
+    {
+        if (i == j) return 0.0;
+        if (full) {
+            FLOAT_T ret = ((const FLOAT_T*)Dp)[i*n+j];
+            if (stored_squared == squared) return ret;
+            else if (squared) return ret*ret;
+            else return sqrt(ret);
+        }
+        else if (precomputed) {
+            if (i > j) std::swap(i, j);
+            size_t k = i*n - i*(i+1)/2 + (j-i-1);
+            //CVI_ASSERT(k >= 0 && k < n*(n-1)/2);
+            FLOAT_T ret;
+            switch (storage) {
+                case CVI_DISTANCE_FLOAT32:
+                    ret = (FLOAT_T)((const float*)Dp)[k]; break;
+                case CVI_DISTANCE_UINT16:
+                    ret = scale*(FLOAT_T)((const uint16_t*)Dp)[k]; break;
+                default:
+                    ret = ((const FLOAT_T*)Dp)[k];
+            }
+            if (stored_squared == squared) return ret;
+            else if (squared) return ret*ret;
+            else return sqrt(ret);
+        }
+        else if (cache) {
+            return get_cached(i, j);
+        }
+        else {
+            return compute(i, j);
+        }
+    }
+
+
+    /** Gives access to D(i, from), D(i, from+1), ..., D(i, n-1)
+     *
+     *  If the full matrix is stored (see is_full()) and needs no
+     *  conversion (see as_squared()), a pointer to the
+     *  i-th row of the underlying buffer is returned.  Otherwise,
+     *  these distances are written to buf (resized if needed) and
+     *  buf.data() is returned, which is invalidated by the next call
+     *  with the same buf.  In both cases, the u-th distance
+     *  is at position u of the returned array.
+     *
+     * @param i
+     * @param buf auxiliary buffer
+     * @param from the first column needed
+     * @return
+     */
+    const FLOAT_T* row(size_t i, std::vector<FLOAT_T>& buf, size_t from=0) const
+    {
+        if (full && stored_squared == squared)
+            return (const FLOAT_T*)Dp+i*n;
+
+        buf.resize(n);
+        if (cache) {
+            // all the distances come from the i-th row
+            __DistanceRowCache& c = *cache;
+            size_t b = i/c.block;
+            size_t s = c.find(b);
+            if (s == std::numeric_limits<size_t>::max()) {
+                get_cached(i, i);  // computes the block
+                s = c.find(b);
+            }
+            const FLOAT_T* r = c.buf.data()+(s*c.block+i%c.block)*n;
+            std::copy(r+from, r+n, buf.begin()+from);
+            c.hits += n-from;
+        }
+        else {
+            for (size_t u=from; u<n; ++u)
+                buf[u] = (*this)(i, u);
+        }
+        return buf.data();
+    }
+};
+
+
+#endif
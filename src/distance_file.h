@@ -0,0 +1,223 @@
+/*  Condensed distance matrices stored in (memory-mapped) files
+ *
+ *  Copyleft (C) 2020-2021, Marek Gagolewski <https://www.gagolewski.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License
+ *  Version 3, 19 November 2007, published by the Free Software Foundation.
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Affero General Public License Version 3 for more details.
+ *  You should have received a copy of the License along with this program.
+ *  If this is not the case, refer to <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DISTANCE_FILE_H
+#define __DISTANCE_FILE_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <stdint.h>
+#include "common.h"
+#include "matrix.h"
+#include "distance.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define CVI_DISTANCE_FILE_MMAP
+#endif
+
+
+
+/** Approximate size of the buffer used by write_distance_file()
+ *  to generate a block of rows of the condensed distance matrix
+ */
+#define CVI_DISTANCE_FILE_BLOCK_BYTES 67108864
+
+
+/** Header of a distance file (64 bytes);
+ *  followed by the condensed distance matrix,
+ *  see pairwise_distances_l2_squared()
+ */
+struct __DistanceFileHeader
+{
+    char magic[8];     ///< "CVIDIST"
+    uint64_t version;  ///< 1
+    uint64_t n;        ///< number of points
+    uint64_t storage;  ///< CVI_DISTANCE_DOUBLE, _FLOAT32 or _UINT16
+    uint64_t squared;  ///< are the distances squared?
+    double scale;      ///< see DistanceStorageUInt16
+    uint64_t reserved[2];
+};
+
+#define CVI_DISTANCE_FILE_MAGIC "CVIDIST"
+
+
+template<class Storage>
+void __write_distance_file(const matrix_view<FLOAT_T>& X, FILE* f, bool squared)
+{
+    size_t n = X.nrow(), d = X.ncol();
+
+    FLOAT_T max_dist = 0.0;
+    if (Storage::type == CVI_DISTANCE_UINT16) {
+        squared = false;  // see DistanceStorageUInt16
+        max_dist = max_distance_bound(X);
+    }
+    Storage s(max_dist);
+
+    __DistanceFileHeader h;
+    memset(&h, 0, sizeof(h));
+    strcpy(h.magic, CVI_DISTANCE_FILE_MAGIC);
+    h.version = 1;
+    h.n = n;
+    h.storage = Storage::type;
+    h.squared = squared;
+    h.scale = s.scale;
+    if (fwrite(&h, sizeof(h), 1, f) != 1)
+        throw std::runtime_error("CVI: cannot write to the distance file");
+
+    // generate the condensed matrix block by block:
+    // each block consists of consecutive rows, at most (about)
+    // CVI_DISTANCE_FILE_BLOCK_BYTES at a time
+    size_t max_block = std::max((size_t)(n-1),
+        (size_t)CVI_DISTANCE_FILE_BLOCK_BYTES/sizeof(typename Storage::value_type));
+    std::vector<typename Storage::value_type> buf;
+    size_t r0 = 0;
+    while (r0+1 < n) {
+        size_t r1 = r0, size = 0;
+        while (r1+1 < n && size+(n-r1-1) <= max_block) {
+            size += n-r1-1;  // number of pairs (r1, j) with j > r1
+            ++r1;
+        }
+
+        buf.resize(size);
+        pairwise_distances_l2_squared(X.data(), n, d, buf.data(),
+            __DistanceEncoder<Storage>(s, squared), r0, r1);
+
+        if (fwrite(buf.data(), sizeof(typename Storage::value_type), size, f) != size)
+            throw std::runtime_error("CVI: cannot write to the distance file");
+
+        r0 = r1;
+    }
+}
+
+
+/** Computes the condensed matrix of pairwise Euclidean distances
+ *  and writes it to a file, which can later be used by
+ *  map_distance_file().
+ *
+ *  The matrix is generated and written block by block, therefore
+ *  the memory use does not depend on the size of the output.
+ *
+ * @param X dataset
+ * @param fname output file name
+ * @param squared squared Euclidean distances? (ignored for
+ *        CVI_DISTANCE_UINT16, which always stores the non-squared ones)
+ * @param storage one of CVI_DISTANCE_DOUBLE, CVI_DISTANCE_FLOAT32,
+ *        CVI_DISTANCE_UINT16
+ */
+void write_distance_file(const matrix_view<FLOAT_T>& X, const std::string& fname,
+    bool squared=false, int storage=CVI_DISTANCE_DOUBLE)
+{
+    CVI_ASSERT(X.nrow() >= 2);
+
+    FILE* f = fopen(fname.c_str(), "wb");
+    if (!f)
+        throw std::runtime_error("CVI: cannot open the distance file for writing");
+
+    try {
+        if (storage == CVI_DISTANCE_DOUBLE)
+            __write_distance_file<DistanceStorageDouble>(X, f, squared);
+        else if (storage == CVI_DISTANCE_FLOAT32)
+            __write_distance_file<DistanceStorageFloat32>(X, f, squared);
+        else if (storage == CVI_DISTANCE_UINT16)
+            __write_distance_file<DistanceStorageUInt16>(X, f, squared);
+        else
+            CVI_ASSERT(false);
+    }
+    catch (...) {
+        fclose(f);
+        remove(fname.c_str());
+        throw;
+    }
+
+    if (fclose(f) != 0) {
+        remove(fname.c_str());
+        throw std::runtime_error("CVI: cannot write to the distance file");
+    }
+}
+
+
+/** Opens a file generated by write_distance_file() in the read-only mode
+ *  and maps it to memory, so that the distances can be read
+ *  through the page cache.
+ *
+ *  The mapping is released once the returned object and all its copies
+ *  are destroyed.
+ *
+ * @param X dataset (the same that was used to generate the file)
+ * @param fname file name
+ * @param squared squared Euclidean distances requested?
+ *        (they are converted on access if the file stores non-squared ones
+ *        or vice versa)
+ * @return
+ */
+EuclideanDistance map_distance_file(const matrix_view<FLOAT_T>& X,
+    const std::string& fname, bool squared)
+{
+#ifdef CVI_DISTANCE_FILE_MMAP
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("CVI: cannot open the distance file");
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(__DistanceFileHeader)) {
+        close(fd);
+        throw std::runtime_error("CVI: invalid distance file");
+    }
+
+    size_t len = (size_t)st.st_size;
+    void* base = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // the mapping stays valid
+    if (base == MAP_FAILED)
+        throw std::runtime_error("CVI: cannot map the distance file to memory");
+
+    std::shared_ptr<const void> owner(base,
+        [len](const void* p) { munmap(const_cast<void*>(p), len); });
+
+    const __DistanceFileHeader* h = (const __DistanceFileHeader*)base;
+    size_t n = X.nrow();
+    int storage = (int)h->storage;
+    if (memcmp(h->magic, CVI_DISTANCE_FILE_MAGIC, 8) != 0 || h->version != 1 ||
+            (storage != CVI_DISTANCE_DOUBLE && storage != CVI_DISTANCE_FLOAT32 &&
+                storage != CVI_DISTANCE_UINT16))
+        throw std::runtime_error("CVI: invalid distance file");
+    if (h->n != n)
+        throw std::runtime_error("CVI: the distance file was generated for a different dataset");
+
+    size_t size = 0;
+    if (storage == CVI_DISTANCE_FLOAT32) size = sizeof(float);
+    else if (storage == CVI_DISTANCE_UINT16) size = sizeof(uint16_t);
+    else size = sizeof(FLOAT_T);
+    if (len < sizeof(__DistanceFileHeader)+n*(n-1)/2*size)
+        throw std::runtime_error("CVI: the distance file is truncated");
+
+    return EuclideanDistance(X, owner,
+        (const char*)base+sizeof(__DistanceFileHeader),
+        storage, (FLOAT_T)h->scale, (bool)h->squared, squared,
+        CVI_DISTANCE_MODE_MAPPED);
+#else
+    throw std::runtime_error("CVI: memory-mapped files are not supported on this platform");
+#endif
+}
+
+
+#endif
@@ -17,9 +17,15 @@
 #ifndef __matrix_h
 #define __matrix_h
 
+#include <algorithm>
 #include "common.h"
 
 
+/** Side of a square tile processed at a time when converting
+ *  a column-major array to a matrix, see matrix::matrix()
+ */
+#define CVI_MATRIX_TRANSPOSE_BLOCK 64
+
 
 /**
  * Represents a matrix as a C-contiguous array,
@@ -68,13 +74,22 @@ public:
         : n(_nrow), d(_ncol), elems(_nrow*_ncol)
     {
         if (_c_order) {
-            for (size_t i; i<_nrow*_ncol; ++i)
+            for (size_t i=0; i<_nrow*_ncol; ++i)
                 elems[i] = (T)(_data[i]);
         }
         else {
-            for (size_t i=0; i<_nrow; i++) {
-                for (size_t j=0; j<_ncol; j++) {
-                    elems[_ncol*i + j] = (T)_data[i+_nrow*j];
+            // transpose tile by tile so that both the columns read
+            // and the rows written stay in cache
+            const size_t b = CVI_MATRIX_TRANSPOSE_BLOCK;
+            for (size_t i0=0; i0<_nrow; i0+=b) {
+                size_t i1 = std::min(i0+b, _nrow);
+                for (size_t j0=0; j0<_ncol; j0+=b) {
+                    size_t j1 = std::min(j0+b, _ncol);
+                    for (size_t i=i0; i<i1; i++) {
+                        for (size_t j=j0; j<j1; j++) {
+                            elems[_ncol*i + j] = (T)_data[i+_nrow*j];
+                        }
+                    }
                 }
             }
         }
@@ -144,4 +159,90 @@ public:
     }
 };
 
+
+
+/**
+ * A read-only view of a row-major matrix stored elsewhere
+ * (e.g., in a matrix object or in a buffer provided by the caller);
+ * copying a view does not copy the elements.
+ *
+ * The underlying array must outlive all the views of it.
+ */
+template <typename T> class matrix_view {
+private:
+    const T* elems;
+    size_t n, d;
+
+public:
+    /** Initialises a view of a C-contiguous array
+     *
+     * @param _data pointer to _nrow*_ncol elements (may be NULL if _ncol == 0)
+     * @param _nrow
+     * @param _ncol
+     */
+    matrix_view(const T* _data, size_t _nrow, size_t _ncol)
+        : elems(_data), n(_nrow), d(_ncol)
+    {
+        ;
+    }
+
+    /** Initialises a view of a given matrix
+     *
+     * @param m
+     */
+    matrix_view(const matrix<T>& m)
+        : elems(m.data()), n(m.nrow()), d(m.ncol())
+    {
+        ;
+    }
+
+
+    /** Read-only access to an element in the i-th row and the j-th column
+     *
+     * @param i
+     * @param j
+     * @return a reference to the indicated matrix element
+     */
+    const T& operator()(const size_t i, const size_t j) const {
+        return elems[d*i + j];
+    }
+
+
+    /** Returns a direct pointer to the underlying C-contiguous data array
+     *
+     * @return pointer
+     */
+    const T* data() const {
+        return elems;
+    }
+
+
+    /** Returns a direct pointer to the start of the i-th row
+     *
+     * @param i
+     * @return pointer
+     */
+    const T* row(const size_t i) const {
+        return elems+i*d;
+    }
+
+
+    /** Returns the number of rows
+     *
+     * @return
+     */
+    size_t nrow() const {
+        return n;
+    }
+
+
+    /** Returns the number of columns
+     *
+     * @return
+     */
+    size_t ncol() const {
+        return d;
+    }
+};
+
 #endif
@@ -23,6 +23,8 @@
 #include "cvi_calinski_harabasz.h"
 #include "cvi_davies_bouldin.h"
 #include "cvi_silhouette.h"
+#include "cvi_silhouette_simplified.h"
+#include "cvi_silhouette_sampled.h"
 #include "cvi_dunn.h"
 #include "cvi_wcss.h"
 #include "cvi_wcnn.h"
@@ -47,53 +49,221 @@ using namespace Rcpp;
 
 
 
+//' @title Shared Dataset Handle
+//'
+//' @description
+//' Creates an object that stores a dataset together with the auxiliary
+//' data structures computed on demand by \code{.CVI_create}:
+//' the pairwise distances (squared and non-squared),
+//' the nearest neighbours of each point and the column means.
+//'
+//' Pass it to \code{.CVI_create} instead of \code{X} whenever
+//' many CVI objects are to be created based on the same dataset
+//' (e.g., for different \code{K} or for different indices),
+//' so that the above are computed and stored only once.
+//'
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are,
+//'        without copying; centroid-based indices are then unavailable)
+//' @param distance_file name of a file generated by
+//'        \code{.CVI_distance_file} (based on the same \code{X})
+//'        or an empty string; if given, the pairwise distances
+//'        will be read from this file via a read-only memory map;
+//'        the indices must then request the file's \code{distance_storage}
+//'
+//' @return An external pointer of class \code{CVI_dataset}.
+//'
 //' @export
-// [[Rcpp::export(".CVI_create")]]
-SEXP _CVI_create(Rcpp::String type, NumericMatrix X, int K, bool allow_undo=true)
+// [[Rcpp::export(".CVI_dataset")]]
+SEXP _CVI_dataset(SEXP X, Rcpp::String distance_file="")
+{
+    DatasetPtr* data = new DatasetPtr(newDataset_fromR(X));
+    XPtr< DatasetPtr > retval = XPtr< DatasetPtr >(data, true);
+    retval.attr("class") = "CVI_dataset";
+
+    (*data)->set_distance_file(std::string(distance_file));
+
+    return retval;
+}
+
+
+//' @title Memory Used by the Distances of a Dataset
+//'
+//' @description
+//' Reports the number of bytes taken by the precomputed pairwise distances
+//' and the row caches held by a dataset handle (memory-mapped files
+//' excluded), see \code{.CVI_dataset} and \code{.CVI_distance_policy}.
+//' These are shared by all the CVI objects based on the dataset;
+//' in particular, the squared and the non-squared distances
+//' are served by the same buffer.
+//'
+//' @param X a dataset, see \code{.CVI_dataset}
+//'
+//' @return Returns a single number.
+//'
+//' @export
+// [[Rcpp::export(".CVI_distance_bytes")]]
+double _CVI_distance_bytes(SEXP X)
+{
+    if (TYPEOF(X) != EXTPTRSXP)
+        Rf_error("X is not a CVI_dataset object");
+    return (double)translateDataset_fromR(X)->get_distance_bytes();
+}
+
+
+//' @title Write Pairwise Distances to a File
+//'
+//' @description
+//' Computes the condensed matrix of the pairwise Euclidean distances
+//' and writes it to a binary file, block by block,
+//' so that the memory use does not depend on the size of the output.
+//'
+//' The file can then be used by \code{.CVI_dataset}, which
+//' maps it to memory in the read-only mode.
+//' This way, datasets too large to have their distances precomputed
+//' in RAM can benefit from the page cache.
+//' Memory-mapped files are not supported on Windows.
+//'
+//' @param X data matrix of size n*d
+//' @param filename output file name
+//' @param squared whether squared Euclidean distances should be stored
+//'        (ignored for \code{"uint16"}, which always stores the
+//'        non-squared ones so as not to lose the small distances)
+//' @param distance_storage \code{"double"}, \code{"float32"}
+//'        or \code{"uint16"}, see \code{.CVI_create}
+//'
+//' @return Returns \code{filename}.
+//'
+//' @export
+// [[Rcpp::export(".CVI_distance_file")]]
+Rcpp::String _CVI_distance_file(NumericMatrix X, Rcpp::String filename,
+    bool squared=false, Rcpp::String distance_storage="double")
+{
+    write_distance_file(translateMatrix_fromR(X), std::string(filename),
+        squared, translateDistanceStorage_fromR(distance_storage));
+    return filename;
+}
+
+
+//' @title Pairwise Distances
+//'
+//' @description
+//' Computes the condensed matrix of the pairwise Euclidean distances
+//' exactly as the CVI objects precompute them (see \code{.CVI_create}),
+//' i.e., with the cache-blocked kernel and the given storage type,
+//' and reads them back.  Mostly for testing purposes.
+//'
+//' @param X data matrix of size n*d
+//' @param squared whether squared Euclidean distances should be returned
+//' @param distance_storage \code{"double"}, \code{"float32"}
+//'        or \code{"uint16"}, see \code{.CVI_create}
+//'
+//' @return Returns a numeric vector of length n*(n-1)/2,
+//' with the distances ordered as in an object of class \code{dist}.
+//'
+//' @export
+// [[Rcpp::export(".CVI_pairwise_distances")]]
+NumericVector _CVI_pairwise_distances(NumericMatrix X, bool squared=false,
+    Rcpp::String distance_storage="double")
+{
+    matrix<FLOAT_T> _X = translateMatrix_fromR(X);
+    size_t n = _X.nrow();
+    EuclideanDistance D(_X, true/*precompute*/, squared,
+        translateDistanceStorage_fromR(distance_storage));
+
+    NumericVector res(n*(n-1)/2);
+    size_t k = 0;
+    for (size_t i=0; i+1<n; ++i) {
+        for (size_t j=i+1; j<n; ++j)
+            res[k++] = D(i, j);
+    }
+    return res;
+}
+
+
+/** Creates a CVI object of a given type which stores the labels
+ *  as Label, see __CVI_create()
+ */
+template<class Label>
+ClusterValidityIndex* __CVI_create_labelled(const char* _type,
+    const DatasetPtr& data, size_t K, bool allow_undo,
+    int metric, int distance_storage)
 {
     ClusterValidityIndex* cvi;
 
-    const char* _type = type.get_cstring();
+    std::string type = std::string(_type);
 
     if (type == "CalinskiHarabasz") {
-        cvi = new CalinskiHarabaszIndex(
-            matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-            K, allow_undo);
+        cvi = new CalinskiHarabaszIndex<Label>(
+            data,
+            K, allow_undo,
+            metric, distance_storage);
     }
     else if (type == "DaviesBouldin") {
-        cvi = new DaviesBouldinIndex(
-            matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-            K, allow_undo);
+        cvi = new DaviesBouldinIndex<Label>(
+            data,
+            K, allow_undo,
+            metric, distance_storage);
     }
     else if (type == "Silhouette") {
-        cvi = new SilhouetteIndex(
-            matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-            K, allow_undo, false);
+        cvi = new SilhouetteIndex<Label>(
+            data,
+            K, allow_undo, false,
+            metric, distance_storage);
     }
     else if (type == "SilhouetteW") {
-        cvi = new SilhouetteIndex(
-            matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-            K, allow_undo, true);
+        cvi = new SilhouetteIndex<Label>(
+            data,
+            K, allow_undo, true,
+            metric, distance_storage);
+    }
+    else if (type == "SimplifiedSilhouette") {
+        cvi = new SimplifiedSilhouetteIndex<Label>(
+            data,
+            K, allow_undo, false,
+            metric, distance_storage);
+    }
+    else if (type == "SimplifiedSilhouetteW") {
+        cvi = new SimplifiedSilhouetteIndex<Label>(
+            data,
+            K, allow_undo, true,
+            metric, distance_storage);
+    }
+    else if (strncmp(_type, "SilhouetteSampled_", 18) == 0 ||
+             strncmp(_type, "SilhouetteWSampled_", 19) == 0) {
+        // e.g., SilhouetteSampled_1000 (the sample size)
+        bool widths = (_type[10] == 'W');
+        int M = std::atoi(_type+(widths?19:18));
+        CVI_ASSERT(M>0);
+
+        cvi = new SampledSilhouetteIndex<Label>(
+            data,
+            K, allow_undo, widths, (size_t)M,
+            metric, distance_storage);
     }
     else if (type == "Dunn") {
-        cvi = new DunnIndex(
-            matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-            K, allow_undo);
+        cvi = new DunnIndex<Label>(
+            data,
+            K, allow_undo,
+            metric, distance_storage);
     }
     else if (type == "WCSS") {
-        cvi = new WCSSIndex(
-            matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-            K, allow_undo, false/*not weighted*/);
+        cvi = new WCSSIndex<Label>(
+            data,
+            K, allow_undo, false/*not weighted*/,
+            metric, distance_storage);
     }
     else if (type == "BallHall") {
-        cvi = new WCSSIndex(
-            matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-            K, allow_undo, true/*weighted*/);
+        cvi = new WCSSIndex<Label>(
+            data,
+            K, allow_undo, true/*weighted*/,
+            metric, distance_storage);
     }
     else if (type == "Gamma") {
-        cvi = new GammaIndex(
-            matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-            K, allow_undo);
+        cvi = new GammaIndex<Label>(
+            data,
+            K, allow_undo,
+            metric, distance_storage);
     }
     else if (strncmp(_type, "DuNN_", 5) == 0) { // DuNN_M_numerator_denominator
         // e.g., DuNN_25_Min_Max
@@ -115,9 +285,10 @@ SEXP _CVI_create(Rcpp::String type, NumericMatrix X, int K, bool allow_undo=true
         owa_numerator = DuNNOWA_get_OWA(owa_numerator_str);
         owa_denominator = DuNNOWA_get_OWA(owa_denominator_str);
 
-        cvi = new DuNNOWAIndex(
-            matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-            K, allow_undo, M, owa_numerator, owa_denominator);
+        cvi = new DuNNOWAIndex<Label>(
+            data,
+            K, allow_undo, M, owa_numerator, owa_denominator,
+            metric, distance_storage);
     }
     else if (strncmp(_type, "WCNN_", 5) == 0) { // WCNN_M
         int M = 0;
@@ -125,9 +296,10 @@ SEXP _CVI_create(Rcpp::String type, NumericMatrix X, int K, bool allow_undo=true
             M = std::atoi(_type+5);
         CVI_ASSERT(M>0);  // M = min(n-1, M) in the constructor
 
-        cvi = new WCNNIndex(
-            matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-            K, allow_undo, M);
+        cvi = new WCNNIndex<Label>(
+            data,
+            K, allow_undo, M,
+            metric, distance_storage);
     }
     else if (strncmp(_type, "GDunn_", 6) == 0) {
         std::string type_string = std::string(_type);
@@ -135,43 +307,43 @@ SEXP _CVI_create(Rcpp::String type, NumericMatrix X, int K, bool allow_undo=true
         std::string denominatorDeltaName = type_string.substr(9, 2);
         bool doesNumeratorNeedCentroids;
         bool doesDenominatorNeedCentroids;
-        LowercaseDeltaFactory* lowercaseDeltaFactory;
-        UppercaseDeltaFactory* uppercaseDeltaFactory;
+        LowercaseDeltaFactory<Label>* lowercaseDeltaFactory;
+        UppercaseDeltaFactory<Label>* uppercaseDeltaFactory;
 
         //Rcpp::Rcout << numeratorDeltaName << " " << denominatorDeltaName << std::endl;
-        //lowercaseDeltaFactory = LowercaseDeltaFactory::GetSpecializedFactory(numeratorDeltaName);
+        //lowercaseDeltaFactory = LowercaseDeltaFactory<Label>::GetSpecializedFactory(numeratorDeltaName);
 
         if (numeratorDeltaName == "d1") {
-            lowercaseDeltaFactory = new LowercaseDelta1Factory();
+            lowercaseDeltaFactory = new LowercaseDelta1Factory<Label>();
         }
         else if (numeratorDeltaName == "d2") {
-            lowercaseDeltaFactory = new LowercaseDelta2Factory();
+            lowercaseDeltaFactory = new LowercaseDelta2Factory<Label>();
         }
         else if (numeratorDeltaName == "d3") {
-            lowercaseDeltaFactory = new LowercaseDelta3Factory();
+            lowercaseDeltaFactory = new LowercaseDelta3Factory<Label>();
         }
         else if (numeratorDeltaName == "d4") {
-            lowercaseDeltaFactory = new LowercaseDelta4Factory();
+            lowercaseDeltaFactory = new LowercaseDelta4Factory<Label>();
         }
         else if (numeratorDeltaName == "d5") {
-            lowercaseDeltaFactory = new LowercaseDelta5Factory();
+            lowercaseDeltaFactory = new LowercaseDelta5Factory<Label>();
         }
         else if (numeratorDeltaName == "d6") {
-            lowercaseDeltaFactory = new LowercaseDelta6Factory();
+            lowercaseDeltaFactory = new LowercaseDelta6Factory<Label>();
         }
         else {
             Rf_error("invalid numeratorDeltaName (d?)");
         }
 
-        // uppercaseDeltaFactory = UppercaseDeltaFactory::GetSpecializedFactory(denominatorDeltaName);
+        // uppercaseDeltaFactory = UppercaseDeltaFactory<Label>::GetSpecializedFactory(denominatorDeltaName);
         if (denominatorDeltaName == "D1") {
-            uppercaseDeltaFactory = new UppercaseDelta1Factory();
+            uppercaseDeltaFactory = new UppercaseDelta1Factory<Label>();
         }
         else if (denominatorDeltaName == "D2") {
-            uppercaseDeltaFactory = new UppercaseDelta2Factory();
+            uppercaseDeltaFactory = new UppercaseDelta2Factory<Label>();
         }
         else if (denominatorDeltaName == "D3") {
-            uppercaseDeltaFactory = new UppercaseDelta3Factory();
+            uppercaseDeltaFactory = new UppercaseDelta3Factory<Label>();
         }
         else {
             Rf_error("invalid denominatorDeltaName (D?)");
@@ -179,20 +351,22 @@ SEXP _CVI_create(Rcpp::String type, NumericMatrix X, int K, bool allow_undo=true
 
         bool areCentroidsNeeded = lowercaseDeltaFactory->IsCentroidNeeded() || uppercaseDeltaFactory->IsCentroidNeeded();
         if (areCentroidsNeeded) {
-            cvi = new GeneralizedDunnIndexCentroidBased(
-                matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
+            cvi = new GeneralizedDunnIndexCentroidBased<Label>(
+                data,
                 K,
                 lowercaseDeltaFactory,
                 uppercaseDeltaFactory,
-                allow_undo);
+                allow_undo,
+                metric, distance_storage);
         }
         else {
-            cvi = new GeneralizedDunnIndex(
-                matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
+            cvi = new GeneralizedDunnIndex<Label>(
+                data,
                 K,
                 lowercaseDeltaFactory,
                 uppercaseDeltaFactory,
-                allow_undo);
+                allow_undo,
+                metric, distance_storage);
         }
         delete lowercaseDeltaFactory;
         delete uppercaseDeltaFactory;
@@ -202,29 +376,204 @@ SEXP _CVI_create(Rcpp::String type, NumericMatrix X, int K, bool allow_undo=true
     }
 //     } else if (type == "Sym") {
 //         cvi = new SymIndex(
-//             matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
+//             data,
 //             K, allow_undo);
 //     } else if (type == "CS") {
 //         cvi = new CSIndex(
-//             matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
+//             data,
 //             K, allow_undo);
 //     } else if (type == "COP") {
 //         cvi = new COPIndex(
-//             matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
+//             data,
 //             K, allow_undo);
 //     } else if (type == "DaviesBouldinStar") {
 //         cvi = new DaviesBouldinStarIndex(
-//             matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
+//             data,
 //             K, allow_undo);
 //     } else if (type == "ScoreFunction") {
 //         cvi = new ScoreFunctionIndex(
-//             matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
+//             data,
 //             K, allow_undo);
 //     } else if (type == "SymDB") {
 //         cvi = new SymDBIndex(
-//             matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
+//             data,
 //             K, allow_undo);
 
+
+    return cvi;
+}
+
+
+/** Creates a CVI object of a given type; see .CVI_create() for the list
+ *  of supported ones.
+ *
+ *  The labels are stored as the smallest unsigned integers that
+ *  can represent K distinct values: most clusterings (K <= 256) take
+ *  one byte per point, larger ones two and, finally, four.
+ *
+ * @param type
+ * @param data
+ * @param K number of clusters
+ * @param allow_undo
+ * @param metric one of CVI_METRIC_*, passed on to the dataset
+ *        (which is shared and hence never modified here)
+ * @param distance_storage one of CVI_DISTANCE_*, as above
+ * @return a newly allocated object, to be deleted by the caller
+ */
+ClusterValidityIndex* __CVI_create(const char* type,
+    const DatasetPtr& data, size_t K, bool allow_undo,
+    int metric=CVI_METRIC_EUCLIDEAN, int distance_storage=CVI_DISTANCE_DOUBLE)
+{
+    CVI_ASSERT(K >= 1);
+    if (K-1 <= std::numeric_limits<uint8_t>::max())
+        return __CVI_create_labelled<uint8_t>(type, data, K, allow_undo,
+            metric, distance_storage);
+    else if (K-1 <= std::numeric_limits<uint16_t>::max())
+        return __CVI_create_labelled<uint16_t>(type, data, K, allow_undo,
+            metric, distance_storage);
+    else
+        return __CVI_create_labelled<uint32_t>(type, data, K, allow_undo,
+            metric, distance_storage);
+}
+
+
+/** Computes the value of a CVI of a given type, see __CVI_create(),
+ *  for a given partition
+ *
+ * @param type
+ * @param data
+ * @param y vector of n integer labels in [1, K]
+ * @param K number of clusters
+ * @return
+ */
+double __CVI_compute(const char* type,
+    const DatasetPtr& data, const NumericVector& y, int K)
+{
+    CVI_ASSERT(K >= 1);
+    std::unique_ptr<ClusterValidityIndex> cvi(
+        __CVI_create(type, data, (size_t)K, false)
+    );
+    setLabels_fromR(cvi.get(), y);
+    return (double)cvi->compute();
+}
+
+
+/** Computes a CVI for each column of Y, see LabelledIndex::compute_many()
+ */
+template<class Label>
+NumericVector __CVI_compute_many_labelled(const LabelledIndex<Label>* index,
+    NumericMatrix Y)
+{
+    size_t m = Y.ncol();
+    std::vector< std::vector<Label> > Ls(m);
+    for (size_t c=0; c<m; ++c)
+        Ls[c] = translateLabels_fromR<Label>(Y.column(c));
+
+    std::vector<FLOAT_T> res(m);
+    index->compute_many(Ls, res);
+
+    NumericVector ret(m);
+    for (size_t c=0; c<m; ++c)
+        ret[c] = (double)res[c];
+    return ret;
+}
+
+
+/** Computes a CVI for each column of Y,
+ *  whatever type the CVI object stores the labels as
+ *
+ * @param cvi
+ * @param Y matrix with n rows whose columns give label vectors
+ *        with integer elements in [1, K]
+ * @return
+ */
+NumericVector __CVI_compute_many(const ClusterValidityIndex* cvi,
+    NumericMatrix Y)
+{
+    ClusterValidityIndex* _cvi = const_cast<ClusterValidityIndex*>(cvi);
+    switch (cvi->get_label_size()) {
+        case sizeof(uint8_t):
+            return __CVI_compute_many_labelled(as_labelled<uint8_t>(_cvi), Y);
+        case sizeof(uint16_t):
+            return __CVI_compute_many_labelled(as_labelled<uint16_t>(_cvi), Y);
+        default:
+            return __CVI_compute_many_labelled(as_labelled<uint32_t>(_cvi), Y);
+    }
+}
+
+
+/** Computes the values of a CVI of a given type, see __CVI_create(),
+ *  for each column of Y
+ *
+ * @param type
+ * @param data
+ * @param Y matrix with n rows whose columns give label vectors
+ *        with integer elements in [1, K]
+ * @param K number of clusters
+ * @return
+ */
+NumericVector __CVI_compute_many(const char* type,
+    const DatasetPtr& data, NumericMatrix Y, int K)
+{
+    CVI_ASSERT(K >= 1);
+    std::unique_ptr<ClusterValidityIndex> cvi(
+        __CVI_create(type, data, (size_t)K, false)
+    );
+    return __CVI_compute_many(cvi.get(), Y);
+}
+
+
+/** Returns the type string of a generalised Dunn index, see __CVI_create()
+ */
+std::string __CVI_GDunn_type(int lowercaseDelta, int uppercaseDelta)
+{
+    if (lowercaseDelta < 1 || lowercaseDelta > 6)
+        Rf_error("invalid lowercaseDelta");
+    if (uppercaseDelta < 1 || uppercaseDelta > 3)
+        Rf_error("invalid uppercaseDelta");
+
+    return "GDunn_d" + std::to_string(lowercaseDelta) +
+        "_D" + std::to_string(uppercaseDelta);
+}
+
+
+/** Returns the type string of an OWA-based Dunn-like index,
+ *  e.g., DuNN_25_Min_Max, see __CVI_create()
+ */
+std::string __CVI_DuNNOWA_type(int M, const Rcpp::String& owa_numerator,
+    const Rcpp::String& owa_denominator)
+{
+    CVI_ASSERT(M>0);    // M = min(n-1, M) in the constructor
+
+    // the OWA specifiers are validated on creation
+    return "DuNN_" + std::to_string(M) + "_" +
+        std::string(owa_numerator) + "_" + std::string(owa_denominator);
+}
+
+
+//' @export
+// [[Rcpp::export(".CVI_create")]]
+SEXP _CVI_create(Rcpp::String type, SEXP X, int K, bool allow_undo=true,
+    Rcpp::String distance_storage="double", Rcpp::String metric="euclidean")
+{
+    DatasetPtr data = translateDataset_fromR(X);
+
+    // how to store the precomputed pairwise distances (if needed):
+    // "double", "float32" (half the memory) or "uint16" (a quarter,
+    // quantised w.r.t. the largest distance); must match the distance
+    // file's storage type if one is mapped, see .CVI_dataset
+    int _distance_storage = translateDistanceStorage_fromR(distance_storage);
+
+    // w.r.t. which the pairwise distances and nearest neighbours
+    // are determined: "euclidean", "manhattan", "chebyshev", "cosine"
+    // or "mahalanobis"; centroid-based indices support only the first one
+    int _metric = translateMetric_fromR(metric);
+
+    // both are passed to the index rather than set on the dataset,
+    // which may be shared with other indices
+    ClusterValidityIndex* cvi = __CVI_create(type.get_cstring(),
+        data, (size_t)K, allow_undo, _metric, _distance_storage);
+
     XPtr< ClusterValidityIndex > retval =
         XPtr< ClusterValidityIndex >((ClusterValidityIndex*)cvi, true);
 
@@ -238,7 +587,7 @@ void _CVI_set_labels(SEXP cvi_ptr, NumericVector y)
 {
     XPtr< ClusterValidityIndex > cvi =
         Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
-    (*cvi).set_labels(translateLabels_fromR(y));
+    setLabels_fromR(&(*cvi), y);
 }
 
 
@@ -252,6 +601,133 @@ double _CVI_compute(SEXP cvi_ptr)
 }
 
 
+//' @title Compute a CVI for Many Partitions
+//'
+//' @description
+//' Determines the value of a cluster validity index for each column
+//' of \code{Y}, as if \code{.CVI_set_labels} and \code{.CVI_compute}
+//' were called for each of them, but in a single call.
+//' The columns are processed in parallel
+//' (see \code{.CVI_set_num_threads}), each thread using its own replica
+//' of the CVI object (see \code{.CVI_clone}).
+//' The state of the CVI object is not modified.
+//'
+//' @param cvi_ptr pointer, see \code{.CVI_create}
+//' @param Y matrix with n rows whose columns give label vectors
+//'          with integer elements in [1, K]
+//'
+//' @return Returns a numeric vector of length \code{ncol(Y)}.
+//'
+//' @export
+// [[Rcpp::export(".CVI_compute_many")]]
+NumericVector _CVI_compute_many(SEXP cvi_ptr, NumericMatrix Y)
+{
+    XPtr< ClusterValidityIndex > cvi =
+        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
+    return __CVI_compute_many(&(*cvi), Y);
+}
+
+
+/** Sets the labels of all the given CVI objects (of the same Label type)
+ *  and computes the indices; the centroids are determined only once
+ *  and shared by all the centroid-based ones, see .CVI_evaluate()
+ */
+template<class Label>
+NumericVector __CVI_evaluate_labelled(
+    const std::vector< std::unique_ptr<ClusterValidityIndex> >& cvis,
+    const NumericVector& y)
+{
+    std::vector<Label> _y = translateLabels_fromR<Label>(y);
+    const CentroidsBasedIndex<Label>* first = NULL; // determined the centroids
+    NumericVector ret(cvis.size());
+    for (size_t t=0; t<cvis.size(); ++t) {
+        CentroidsBasedIndex<Label>* c =
+            dynamic_cast< CentroidsBasedIndex<Label>* >(cvis[t].get());
+        if (c && first)
+            c->set_labels_and_centroids(_y, first->get_centroids());
+        else {
+            as_labelled<Label>(cvis[t].get())->set_labels(_y);
+            if (c) first = c;
+        }
+        ret[t] = (double)cvis[t]->compute();
+    }
+    return ret;
+}
+
+
+//' @title Compute Many CVIs for a Partition
+//'
+//' @description
+//' Determines the values of many cluster validity indices
+//' for the same partition in a single call.
+//' The auxiliary data structures are built only once and shared
+//' by all the indices: the pairwise distances (subject to
+//' \code{.CVI_distance_policy}), the nearest neighbours
+//' (determined for the largest M needed) and the cluster centroids.
+//'
+//' @param types character vector of index types, see \code{.CVI_create}
+//' @param X data matrix of size n*d, an object of class \code{dist}
+//'        or a dataset, see \code{.CVI_dataset}
+//' @param y vector of n integer labels in [1, K]
+//' @param K number of clusters
+//' @param distance_storage see \code{.CVI_create}
+//' @param metric see \code{.CVI_create}
+//'
+//' @return Returns a numeric vector of the same length as \code{types},
+//' named after them.
+//'
+//' @export
+// [[Rcpp::export(".CVI_evaluate")]]
+NumericVector _CVI_evaluate(CharacterVector types, SEXP X, NumericVector y,
+    int K, Rcpp::String distance_storage="double",
+    Rcpp::String metric="euclidean")
+{
+    DatasetPtr data = translateDataset_fromR(X);
+    int _distance_storage = translateDistanceStorage_fromR(distance_storage);
+    int _metric = translateMetric_fromR(metric);
+
+    // build the shared data structures in an order that lets the dataset
+    // derive the others from them: the nearest neighbours for
+    // the largest M (WCNN_M, DuNN_M_*) give those for all smaller Ms;
+    // the squared and the non-squared distances share one buffer anyway
+    // (see Dataset::get_distance()), but if the squared ones (Dunn, GDunn_*)
+    // are stored, the Euclidean distances are their exact square roots
+    size_t m = types.size(), max_M = 0;
+    bool squared = false;
+    for (size_t t=0; t<m; ++t) {
+        std::string type(types[t]);
+        const char* _type = type.c_str();
+        if (strncmp(_type, "WCNN_", 5) == 0 || strncmp(_type, "DuNN_", 5) == 0)
+            max_M = std::max(max_M, (size_t)std::max(0, std::atoi(_type+5)));
+        else if (strcmp(_type, "Dunn") == 0 || strncmp(_type, "GDunn_", 6) == 0)
+            squared = true;
+    }
+    if (max_M > 0 && data->get_n() > 1)
+        data->get_nn(std::min(max_M, data->get_n()-1), _metric);
+    if (squared)
+        data->get_distance(true, _metric, _distance_storage);
+
+    std::vector< std::unique_ptr<ClusterValidityIndex> > cvis(m);
+    for (size_t t=0; t<m; ++t)
+        cvis[t].reset(__CVI_create(std::string(types[t]).c_str(),
+            data, (size_t)K, false, _metric, _distance_storage));
+
+    NumericVector ret;
+    if (m > 0) {
+        switch (cvis[0]->get_label_size()) {
+            case sizeof(uint8_t):
+                ret = __CVI_evaluate_labelled<uint8_t>(cvis, y); break;
+            case sizeof(uint16_t):
+                ret = __CVI_evaluate_labelled<uint16_t>(cvis, y); break;
+            default:
+                ret = __CVI_evaluate_labelled<uint32_t>(cvis, y);
+        }
+    }
+    ret.names() = types;
+    return ret;
+}
+
+
 
 //' @export
 // [[Rcpp::export(".CVI_undo")]]
@@ -263,6 +739,65 @@ void _CVI_undo(SEXP cvi_ptr)
 }
 
 
+
+//' @title Start a Transaction on a CVI Object
+//'
+//' @description
+//' All the subsequent calls to \code{.CVI_modify} can be cancelled
+//' altogether by calling \code{.CVI_rollback} or accepted
+//' by \code{.CVI_commit}.  Within a transaction, \code{.CVI_undo}
+//' can be called repeatedly.  Transactions can be nested.
+//'
+//' @param cvi_ptr pointer, see \code{.CVI_create}
+//'
+//' @export
+// [[Rcpp::export(".CVI_begin")]]
+void _CVI_begin(SEXP cvi_ptr)
+{
+    XPtr< ClusterValidityIndex > cvi =
+        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
+    (*cvi).begin();
+}
+
+
+
+//' @title Accept the Modifications Made in a Transaction
+//'
+//' @description
+//' Ends the transaction started by the most recent call
+//' to \code{.CVI_begin}.
+//'
+//' @param cvi_ptr pointer, see \code{.CVI_create}
+//'
+//' @export
+// [[Rcpp::export(".CVI_commit")]]
+void _CVI_commit(SEXP cvi_ptr)
+{
+    XPtr< ClusterValidityIndex > cvi =
+        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
+    (*cvi).commit();
+}
+
+
+
+//' @title Cancel the Modifications Made in a Transaction
+//'
+//' @description
+//' Restores the state of the object as of the most recent call
+//' to \code{.CVI_begin} and ends the transaction.
+//'
+//' @param cvi_ptr pointer, see \code{.CVI_create}
+//'
+//' @export
+// [[Rcpp::export(".CVI_rollback")]]
+void _CVI_rollback(SEXP cvi_ptr)
+{
+    XPtr< ClusterValidityIndex > cvi =
+        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
+    (*cvi).rollback();
+}
+
+
 //' @export
 // [[Rcpp::export(".CVI_modify")]]
 void _CVI_modify(SEXP cvi_ptr, int i, int j)
@@ -274,6 +809,440 @@ void _CVI_modify(SEXP cvi_ptr, int i, int j)
 
 
 
+//' @title Exchange the Labels of Two Points
+//'
+//' @description
+//' Updates a CVI object as if the labels of the i-th and the k-th point
+//' were swapped.  The cluster sizes do not change.
+//' \code{.CVI_undo} cancels the whole swap.
+//'
+//' @param cvi_ptr pointer, see \code{.CVI_create}
+//' @param i,k indexes of two points from different clusters (1-based)
+//'
+//' @export
+// [[Rcpp::export(".CVI_swap")]]
+void _CVI_swap(SEXP cvi_ptr, int i, int k)
+{ // uses 1-based indexing
+    XPtr< ClusterValidityIndex > cvi =
+        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
+    (*cvi).swap(i-1, k-1);
+}
+
+
+//' @title Relabel Many Points at Once
+//'
+//' @description
+//' Updates a CVI object as if \code{L[idx[t]]} was set to \code{labels[t]}
+//' for all \code{t}.  The cost depends on the number of points moved,
+//' not on the number of all pairs of points.
+//' \code{.CVI_undo} cancels the whole operation.
+//'
+//' @param cvi_ptr pointer, see \code{.CVI_create}
+//' @param idx indexes of distinct points (1-based)
+//' @param labels new labels (1-based), of the same length as \code{idx};
+//'     no cluster can become empty
+//'
+//' @export
+// [[Rcpp::export(".CVI_modify_many")]]
+void _CVI_modify_many(SEXP cvi_ptr, NumericVector idx, NumericVector labels)
+{ // uses 1-based indexing
+    XPtr< ClusterValidityIndex > cvi =
+        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
+    size_t m = idx.size();
+    std::vector<size_t> _idx(m);
+    for (size_t t=0; t<m; ++t) {
+        CVI_ASSERT(idx[t] >= 1);
+        _idx[t] = (size_t)idx[t]-1;
+    }
+    switch ((*cvi).get_label_size()) {
+        case sizeof(uint8_t):
+            as_labelled<uint8_t>(&(*cvi))->modify_many(_idx,
+                translateLabels_fromR<uint8_t>(labels));
+            break;
+        case sizeof(uint16_t):
+            as_labelled<uint16_t>(&(*cvi))->modify_many(_idx,
+                translateLabels_fromR<uint16_t>(labels));
+            break;
+        default:
+            as_labelled<uint32_t>(&(*cvi))->modify_many(_idx,
+                translateLabels_fromR<uint32_t>(labels));
+    }
+}
+
+
+//' @title Replicate a CVI Object
+//'
+//' @description
+//' Creates a copy of a CVI object with the same current state
+//' (labels and the auxiliary data depending on them),
+//' which can be modified independently of the original one.
+//' The immutable data structures (e.g., the pairwise distances
+//' or the nearest neighbours) are shared by both objects.
+//'
+//' @param cvi_ptr pointer, see \code{.CVI_create}
+//'
+//' @return Returns a pointer to the new object.
+//'
+//' @export
+// [[Rcpp::export(".CVI_clone")]]
+SEXP _CVI_clone(SEXP cvi_ptr)
+{
+    XPtr< ClusterValidityIndex > cvi =
+        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
+    return XPtr< ClusterValidityIndex >((*cvi).clone(), true);
+}
+
+
+/** See _CVI_confint()
+ */
+template<class Label>
+bool __CVI_confint_labelled(ClusterValidityIndex* cvi,
+    FLOAT_T& lower, FLOAT_T& upper)
+{
+    SampledSilhouetteIndex<Label>* s =
+        dynamic_cast< SampledSilhouetteIndex<Label>* >(cvi);
+    if (!s) return false;
+    s->get_confidence_interval(lower, upper);
+    return true;
+}
+
+
+//' @title Confidence Interval for an Estimated CVI
+//'
+//' @description
+//' Returns the 95\% confidence interval for the value of an index
+//' estimated by means of sampling (\code{SilhouetteSampled_M} and
+//' \code{SilhouetteWSampled_M}, where \code{M} is the sample size,
+//' see \code{.CVI_create}) determined by the most recent call
+//' to \code{.CVI_compute}.
+//'
+//' @param cvi_ptr pointer, see \code{.CVI_create}
+//'
+//' @return Returns a numeric vector with two elements,
+//' the lower and the upper bound.
+//'
+//' @export
+// [[Rcpp::export(".CVI_confint")]]
+NumericVector _CVI_confint(SEXP cvi_ptr)
+{
+    XPtr< ClusterValidityIndex > cvi =
+        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
+
+    FLOAT_T lower, upper;
+    bool ok;
+    switch ((*cvi).get_label_size()) {
+        case sizeof(uint8_t):
+            ok = __CVI_confint_labelled<uint8_t>(&(*cvi), lower, upper);
+            break;
+        case sizeof(uint16_t):
+            ok = __CVI_confint_labelled<uint16_t>(&(*cvi), lower, upper);
+            break;
+        default:
+            ok = __CVI_confint_labelled<uint32_t>(&(*cvi), lower, upper);
+    }
+    if (!ok)
+        Rf_error("the index is not estimated by sampling");
+
+    NumericVector ret(2);
+    ret[0] = std::isnan(lower)?NA_REAL:(double)lower;
+    ret[1] = std::isnan(upper)?NA_REAL:(double)upper;
+    return ret;
+}
+
+
+/** See _CVI_num_rescans()
+ */
+template<class Label>
+bool __CVI_num_rescans_labelled(ClusterValidityIndex* cvi, size_t& num_rescans)
+{
+    DunnIndex<Label>* s = dynamic_cast< DunnIndex<Label>* >(cvi);
+    if (!s) return false;
+    num_rescans = s->get_num_rescans();
+    return true;
+}
+
+
+//' @title Number of Rescans of the Distance Matrix
+//'
+//' @description
+//' Dunn's index keeps track of a few farthest pairs of points
+//' in each cluster, so that moving a point only requires a scan
+//' of its distances to the members of its new cluster.
+//' Only when all the stored pairs of some cluster
+//' are invalidated, the distances between the members
+//' of the cluster concerned are rescanned.
+//' (The smallest distance between the clusters is determined based on
+//' the minimum spanning tree of the dataset, which needs no rescans.)
+//'
+//' @param cvi_ptr pointer, see \code{.CVI_create}
+//'
+//' @return Returns the number of such rescans performed so far
+//' by \code{.CVI_modify}, \code{.CVI_swap}, \code{.CVI_modify_many},
+//' and the functions scoring the moves.
+//'
+//' @export
+// [[Rcpp::export(".CVI_num_rescans")]]
+double _CVI_num_rescans(SEXP cvi_ptr)
+{
+    XPtr< ClusterValidityIndex > cvi =
+        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
+
+    size_t num_rescans;
+    bool ok;
+    switch ((*cvi).get_label_size()) {
+        case sizeof(uint8_t):
+            ok = __CVI_num_rescans_labelled<uint8_t>(&(*cvi), num_rescans);
+            break;
+        case sizeof(uint16_t):
+            ok = __CVI_num_rescans_labelled<uint16_t>(&(*cvi), num_rescans);
+            break;
+        default:
+            ok = __CVI_num_rescans_labelled<uint32_t>(&(*cvi), num_rescans);
+    }
+    if (!ok)
+        Rf_error("the index does not count the rescans");
+
+    return (double)num_rescans;
+}
+
+
+//' @title Scores of All the Possible Moves of a Single Point
+//'
+//' @description
+//' Determines the values of a cluster validity index that would be
+//' obtained by moving the i-th point to each other cluster.
+//' The state of the CVI object is not modified.
+//'
+//' @param cvi_ptr pointer, see \code{.CVI_create}
+//' @param i index of the point, in 1..n
+//'
+//' @return Returns a numeric vector of length K; the j-th element
+//' gives the index value after assigning the i-th point to the j-th cluster.
+//' Moves that are not allowed (to the point's current cluster
+//' or from a singleton) are marked as missing values.
+//'
+//' @export
+// [[Rcpp::export(".CVI_score_point_moves")]]
+NumericVector _CVI_score_point_moves(SEXP cvi_ptr, int i)
+{ // uses 1-based indexing
+    XPtr< ClusterValidityIndex > cvi =
+        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
+    size_t K = (*cvi).get_K();
+    if (i < 1 || (size_t)i > (*cvi).get_n())
+        Rf_error("i out of range");
+
+    std::vector<FLOAT_T> res(K);
+    (*cvi).score_point_moves(i-1, res.data());
+
+    NumericVector ret(K);
+    for (size_t j=0; j<K; ++j) {
+        if (std::isnan(res[j])) ret[j] = NA_REAL;
+        else ret[j] = (double)res[j];
+    }
+    return ret;
+}
+
+
+//' @title Scores of All the Possible Moves
+//'
+//' @description
+//' Determines the values of a cluster validity index that would be
+//' obtained by moving each point to each other cluster.
+//' The state of the CVI object is not modified.
+//'
+//' @param cvi_ptr pointer, see \code{.CVI_create}
+//'
+//' @return Returns a numeric matrix with n rows and K columns;
+//' the element in the i-th row and the j-th column gives the index value
+//' after assigning the i-th point to the j-th cluster.
+//' Moves that are not allowed (to the point's current cluster
+//' or from a singleton) are marked as missing values.
+//'
+//' @export
+// [[Rcpp::export(".CVI_score_all_moves")]]
+NumericMatrix _CVI_score_all_moves(SEXP cvi_ptr)
+{
+    XPtr< ClusterValidityIndex > cvi =
+        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
+    size_t n = (*cvi).get_n();
+    size_t K = (*cvi).get_K();
+
+    matrix<FLOAT_T> res(n, K);
+    (*cvi).score_all_moves(res);
+
+    NumericMatrix ret(n, K);
+    for (size_t i=0; i<n; ++i) {
+        for (size_t j=0; j<K; ++j) {
+            if (std::isnan(res(i, j))) ret(i, j) = NA_REAL;
+            else ret(i, j) = (double)res(i, j);
+        }
+    }
+    return ret;
+}
+
+
+
+//' @title Set the Number of Threads
+//'
+//' @description
+//' Sets the number of threads used when constructing the auxiliary
+//' data structures (pairwise distances, nearest neighbours, etc.)
+//' in \code{.CVI_create}, \code{.CVI_evaluate} and \code{.CVI_set_labels},
+//' including sorting the pairwise distances for the Gamma index,
+//' as well as when scoring many partitions or moves at once
+//' in \code{.CVI_compute_many}, \code{.CVI_score_all_moves}
+//' and \code{.CVI_score_point_moves}.
+//' The results do not depend on this setting.
+//'
+//' By default, the value of \code{OMP_NUM_THREADS} is used.
+//' If the package was compiled without OpenMP support,
+//' only 1 thread is available.
+//'
+//' @param num_threads positive integer or 0
+//'        (to leave the current setting unchanged)
+//'
+//' @return Returns the previous setting.
+//'
+//' @export
+// [[Rcpp::export(".CVI_set_num_threads")]]
+int _CVI_set_num_threads(int num_threads=0)
+{
+    if (num_threads == 0)
+        return cvi_get_num_threads();
+    else if (num_threads < 0)
+        Rf_error("num_threads must be a positive integer");
+
+    return cvi_set_num_threads(num_threads);
+}
+
+
+//' @title Memory Budget for Pairwise Distances
+//'
+//' @description
+//' Controls how the indices that rely on pairwise distances
+//' (Silhouette, Dunn, generalised Dunn) obtain them
+//' for each dataset (see \code{.CVI_dataset}).
+//' The full condensed distance matrix is precomputed if it fits
+//' in the memory budget (given the memory already used
+//' by the other distance buffers of the same dataset).
+//' If \code{full_matrix} is \code{TRUE} and twice as much memory
+//' is available, the whole square matrix is stored instead,
+//' so that each of its rows is contiguous, which speeds up
+//' the incremental updates (doubles only, see \code{distance_storage}
+//' in \code{.CVI_create}).
+//' With the default budget (enough for the condensed matrix
+//' for n=10000), this is the case for n up to about 7000.
+//' The same buffer serves both the squared and the non-squared
+//' distances, so the square matrix leaves no index without them.
+//' Otherwise, if \code{d > access_cost} and at least 16 blocks of
+//' \code{row_block} full rows of the distance matrix fit in the budget,
+//' the recently used rows are cached.
+//' Otherwise, the distances are computed on the fly.
+//'
+//' The settings apply to the CVI objects created afterwards;
+//' see \code{.CVI_distance_mode} for the mode actually chosen.
+//' Negative argument values leave the corresponding settings unchanged.
+//'
+//' @param max_bytes memory budget, in bytes, per dataset
+//' @param access_cost estimated cost of fetching a cached distance
+//'        relative to the cost of processing one coordinate
+//'        when computing it
+//' @param row_block number of consecutive rows computed and cached together
+//' @param full_matrix 1 (\code{TRUE}) to allow storing the full square
+//'        matrix, 0 (\code{FALSE}) to always store the condensed one
+//'
+//' @return Returns a list with the current settings.
+//'
+//' @export
+// [[Rcpp::export(".CVI_distance_policy")]]
+List _CVI_distance_policy(double max_bytes=-1, double access_cost=-1,
+    double row_block=-1, double full_matrix=-1)
+{
+    DistancePolicy& policy = cvi_distance_policy();
+    if (max_bytes >= 0) policy.max_bytes = (size_t)max_bytes;
+    if (access_cost >= 0) policy.access_cost = (FLOAT_T)access_cost;
+    if (row_block >= 0) {
+        if (row_block < 1) Rf_error("row_block must be at least 1");
+        policy.row_block = (size_t)row_block;
+    }
+    if (full_matrix >= 0) policy.full_matrix = (full_matrix != 0);
+
+    return Rcpp::List::create(
+        _["max_bytes"] = (double)policy.max_bytes,
+        _["access_cost"] = (double)policy.access_cost,
+        _["row_block"] = (double)policy.row_block,
+        _["full_matrix"] = (bool)policy.full_matrix
+    );
+}
+
+
+//' @title Distance Mode of a CVI Object
+//'
+//' @description
+//' Reports how the pairwise distances are provided to a CVI object
+//' created with \code{.CVI_create}, see \code{.CVI_distance_policy}.
+//'
+//' @param cvi_ptr pointer to a CVI object
+//'
+//' @return Returns one of \code{"none"} (the index does not rely on
+//' pairwise distances), \code{"on_the_fly"}, \code{"precomputed"}
+//' (the condensed matrix), \code{"precomputed_full"} (the square matrix),
+//' \code{"row_cache"}, or \code{"memory_mapped"}.
+//'
+//' @export
+// [[Rcpp::export(".CVI_distance_mode")]]
+std::string _CVI_distance_mode(SEXP cvi_ptr)
+{
+    XPtr< ClusterValidityIndex > cvi =
+        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
+    const EuclideanDistance* D = (*cvi).get_distance();
+    if (!D) return "none";
+
+    switch (D->get_mode()) {
+        case CVI_DISTANCE_MODE_ON_THE_FLY: return "on_the_fly";
+        case CVI_DISTANCE_MODE_PRECOMPUTED:
+            return D->is_full()?"precomputed_full":"precomputed";
+        case CVI_DISTANCE_MODE_ROW_CACHE: return "row_cache";
+        case CVI_DISTANCE_MODE_MAPPED: return "memory_mapped";
+        default: return "none";
+    }
+}
+
+
+//' @title Row Cache Statistics of a CVI Object
+//'
+//' @description
+//' If a CVI object created with \code{.CVI_create} caches the recently
+//' used rows of the distance matrix (see \code{.CVI_distance_mode}),
+//' reports how effective the cache has been so far.
+//' The cache is shared by all the objects based on the same dataset
+//' (see \code{.CVI_dataset}) that request the same kind of distances.
+//'
+//' @param cvi_ptr pointer to a CVI object
+//'
+//' @return Returns a list with the following components:
+//' \code{hits} (the number of distances read from the cache),
+//' \code{misses} (the number of blocks of rows computed),
+//' \code{rows} (the capacity of the cache, in rows; 0 if the cache
+//' is not used).
+//'
+//' @export
+// [[Rcpp::export(".CVI_distance_cache_stats")]]
+List _CVI_distance_cache_stats(SEXP cvi_ptr)
+{
+    XPtr< ClusterValidityIndex > cvi =
+        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
+    const EuclideanDistance* D = (*cvi).get_distance();
+
+    return Rcpp::List::create(
+        _["hits"] = (double)(D?D->get_cache_hits():0),
+        _["misses"] = (double)(D?D->get_cache_misses():0),
+        _["rows"] = (double)(D?D->get_cache_rows():0)
+    );
+}
+
+
+
 
 
 
@@ -301,12 +1270,29 @@ void _CVI_modify(SEXP cvi_ptr, int i, int j)
 // [[Rcpp::export]]
 double CVI_CalinskiHarabasz(NumericMatrix X, NumericVector y, int K)
 {
-    CalinskiHarabaszIndex ind(
-        matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-        (uint8_t)K
-    );
-    ind.set_labels(translateLabels_fromR(y));
-    return (double)ind.compute();
+    return __CVI_compute("CalinskiHarabasz", translateDataset_fromR(X), y, K);
+}
+
+
+//' @title The Calinski-Harabasz Index for Many Partitions
+//'
+//' @description
+//' Computes \code{CVI_CalinskiHarabasz} for each column of \code{Y};
+//' the columns are processed in parallel, see \code{.CVI_compute_many}.
+//'
+//' @param X data matrix of size n*d
+//' @param Y matrix with n rows whose columns give label vectors
+//'          with integer elements in [1, K]
+//' @param K number of clusters
+//'
+//' @return Returns a numeric vector of length \code{ncol(Y)}.
+//'
+//' @export
+// [[Rcpp::export]]
+NumericVector CVI_CalinskiHarabasz_many(NumericMatrix X, NumericMatrix Y, int K)
+{
+    return __CVI_compute_many("CalinskiHarabasz",
+        translateDataset_fromR(X), Y, K);
 }
 
 
@@ -328,12 +1314,29 @@ double CVI_CalinskiHarabasz(NumericMatrix X, NumericVector y, int K)
 // [[Rcpp::export]]
 double CVI_WCSS(NumericMatrix X, NumericVector y, int K)
 {
-    WCSSIndex ind(
-        matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-        (uint8_t)K, false, false/*not weighted*/
-    );
-    ind.set_labels(translateLabels_fromR(y));
-    return (double)ind.compute();
+    return __CVI_compute("WCSS", translateDataset_fromR(X), y, K);
+}
+
+
+//' @title Negated Within-Cluster Sum of Squares for Many Partitions
+//'
+//' @description
+//' Computes \code{CVI_WCSS} for each column of \code{Y};
+//' the columns are processed in parallel, see \code{.CVI_compute_many}.
+//'
+//' @param X data matrix of size n*d
+//' @param Y matrix with n rows whose columns give label vectors
+//'          with integer elements in [1, K]
+//' @param K number of clusters
+//'
+//' @return Returns a numeric vector of length \code{ncol(Y)}.
+//'
+//' @export
+// [[Rcpp::export]]
+NumericVector CVI_WCSS_many(NumericMatrix X, NumericMatrix Y, int K)
+{
+    return __CVI_compute_many("WCSS",
+        translateDataset_fromR(X), Y, K);
 }
 
 
@@ -354,12 +1357,29 @@ double CVI_WCSS(NumericMatrix X, NumericVector y, int K)
 // [[Rcpp::export]]
 double CVI_BallHall(NumericMatrix X, NumericVector y, int K)
 {
-    WCSSIndex ind(
-        matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-        (uint8_t)K, false, true/*weighted*/
-    );
-    ind.set_labels(translateLabels_fromR(y));
-    return (double)ind.compute();
+    return __CVI_compute("BallHall", translateDataset_fromR(X), y, K);
+}
+
+
+//' @title Negated Ball-Hall Index for Many Partitions
+//'
+//' @description
+//' Computes \code{CVI_BallHall} for each column of \code{Y};
+//' the columns are processed in parallel, see \code{.CVI_compute_many}.
+//'
+//' @param X data matrix of size n*d
+//' @param Y matrix with n rows whose columns give label vectors
+//'          with integer elements in [1, K]
+//' @param K number of clusters
+//'
+//' @return Returns a numeric vector of length \code{ncol(Y)}.
+//'
+//' @export
+// [[Rcpp::export]]
+NumericVector CVI_BallHall_many(NumericMatrix X, NumericMatrix Y, int K)
+{
+    return __CVI_compute_many("BallHall",
+        translateDataset_fromR(X), Y, K);
 }
 
 
@@ -381,7 +1401,8 @@ double CVI_BallHall(NumericMatrix X, NumericVector y, int K)
 //' pp. 31-38.
 //'
 //'
-//' @param X data matrix of size n*d
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are)
 //' @param y vector of n integer labels in [1, K], where `y[i]`
 //'          is the cluster id of the i-th point, `X[i,]`
 //' @param K number of clusters, `max(y)`
@@ -389,14 +1410,32 @@ double CVI_BallHall(NumericMatrix X, NumericVector y, int K)
 //' @return The computed index.
 //' @export
 // [[Rcpp::export]]
-double CVI_Gamma(NumericMatrix X, NumericVector y, int K)
+double CVI_Gamma(SEXP X, NumericVector y, int K)
 {
-    GammaIndex ind(
-        matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-        (uint8_t)K
-    );
-    ind.set_labels(translateLabels_fromR(y));
-    return (double)ind.compute();
+    return __CVI_compute("Gamma", translateDataset_fromR(X), y, K);
+}
+
+
+//' @title The Baker-Hubert Gamma Coefficient for Many Partitions
+//'
+//' @description
+//' Computes \code{CVI_Gamma} for each column of \code{Y};
+//' the columns are processed in parallel, see \code{.CVI_compute_many}.
+//'
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are)
+//' @param Y matrix with n rows whose columns give label vectors
+//'          with integer elements in [1, K]
+//' @param K number of clusters
+//'
+//' @return Returns a numeric vector of length \code{ncol(Y)}.
+//'
+//' @export
+// [[Rcpp::export]]
+NumericVector CVI_Gamma_many(SEXP X, NumericMatrix Y, int K)
+{
+    return __CVI_compute_many("Gamma",
+        translateDataset_fromR(X), Y, K);
 }
 
 
@@ -423,12 +1462,29 @@ double CVI_Gamma(NumericMatrix X, NumericVector y, int K)
 // [[Rcpp::export]]
 double CVI_DaviesBouldin(NumericMatrix X, NumericVector y, int K)
 {
-    DaviesBouldinIndex ind(
-        matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-        (uint8_t)K
-    );
-    ind.set_labels(translateLabels_fromR(y));
-    return (double)ind.compute();
+    return __CVI_compute("DaviesBouldin", translateDataset_fromR(X), y, K);
+}
+
+
+//' @title The Negated Davies-Bouldin Cluster Validity Index for Many Partitions
+//'
+//' @description
+//' Computes \code{CVI_DaviesBouldin} for each column of \code{Y};
+//' the columns are processed in parallel, see \code{.CVI_compute_many}.
+//'
+//' @param X data matrix of size n*d
+//' @param Y matrix with n rows whose columns give label vectors
+//'          with integer elements in [1, K]
+//' @param K number of clusters
+//'
+//' @return Returns a numeric vector of length \code{ncol(Y)}.
+//'
+//' @export
+// [[Rcpp::export]]
+NumericVector CVI_DaviesBouldin_many(NumericMatrix X, NumericMatrix Y, int K)
+{
+    return __CVI_compute_many("DaviesBouldin",
+        translateDataset_fromR(X), Y, K);
 }
 
 
@@ -444,7 +1500,8 @@ double CVI_DaviesBouldin(NumericMatrix X, NumericVector y, int K)
 //' Validation of Cluster Analysis, Computational and Applied Mathematics 20,
 //' 1987, pp. 53-65, doi:10.1016/0377-0427(87)90125-7.
 //'
-//' @param X data matrix of size n*d
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are)
 //' @param y vector of n integer labels in [1, K], where `y[i]`
 //'          is the cluster id of the i-th point, `X[i,]`
 //' @param K number of clusters, `max(y)`
@@ -453,14 +1510,32 @@ double CVI_DaviesBouldin(NumericMatrix X, NumericVector y, int K)
 //'
 //' @export
 // [[Rcpp::export]]
-double CVI_Silhouette(NumericMatrix X, NumericVector y, int K)
+double CVI_Silhouette(SEXP X, NumericVector y, int K)
 {
-    SilhouetteIndex ind(
-        matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-        (uint8_t)K, false, false
-    );
-    ind.set_labels(translateLabels_fromR(y));
-    return (double)ind.compute();
+    return __CVI_compute("Silhouette", translateDataset_fromR(X), y, K);
+}
+
+
+//' @title The Silhouette Coefficient for Many Partitions
+//'
+//' @description
+//' Computes \code{CVI_Silhouette} for each column of \code{Y};
+//' the columns are processed in parallel, see \code{.CVI_compute_many}.
+//'
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are)
+//' @param Y matrix with n rows whose columns give label vectors
+//'          with integer elements in [1, K]
+//' @param K number of clusters
+//'
+//' @return Returns a numeric vector of length \code{ncol(Y)}.
+//'
+//' @export
+// [[Rcpp::export]]
+NumericVector CVI_Silhouette_many(SEXP X, NumericMatrix Y, int K)
+{
+    return __CVI_compute_many("Silhouette",
+        translateDataset_fromR(X), Y, K);
 }
 
 
@@ -473,7 +1548,8 @@ double CVI_Silhouette(NumericMatrix X, NumericVector y, int K)
 //' Validation of Cluster Analysis, Computational and Applied Mathematics 20,
 //' 1987, pp. 53-65, doi:10.1016/0377-0427(87)90125-7.
 //'
-//' @param X data matrix of size n*d
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are)
 //' @param y vector of n integer labels in [1, K], where `y[i]`
 //'          is the cluster id of the i-th point, `X[i,]`
 //' @param K number of clusters, `max(y)`
@@ -482,14 +1558,32 @@ double CVI_Silhouette(NumericMatrix X, NumericVector y, int K)
 //'
 //' @export
 // [[Rcpp::export]]
-double CVI_SilhouetteW(NumericMatrix X, NumericVector y, int K)
+double CVI_SilhouetteW(SEXP X, NumericVector y, int K)
 {
-    SilhouetteIndex ind(
-        matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-        (uint8_t)K, false, true
-    );
-    ind.set_labels(translateLabels_fromR(y));
-    return (double)ind.compute();
+    return __CVI_compute("SilhouetteW", translateDataset_fromR(X), y, K);
+}
+
+
+//' @title The Mean of the Cluster Average Silhouette Widths for Many Partitions
+//'
+//' @description
+//' Computes \code{CVI_SilhouetteW} for each column of \code{Y};
+//' the columns are processed in parallel, see \code{.CVI_compute_many}.
+//'
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are)
+//' @param Y matrix with n rows whose columns give label vectors
+//'          with integer elements in [1, K]
+//' @param K number of clusters
+//'
+//' @return Returns a numeric vector of length \code{ncol(Y)}.
+//'
+//' @export
+// [[Rcpp::export]]
+NumericVector CVI_SilhouetteW_many(SEXP X, NumericMatrix Y, int K)
+{
+    return __CVI_compute_many("SilhouetteW",
+        translateDataset_fromR(X), Y, K);
 }
 
 
@@ -504,7 +1598,8 @@ double CVI_SilhouetteW(NumericMatrix X, NumericVector y, int K)
 //' Compact Well-Separated Clusters, Journal of Cybernetics 3(3), 1973,
 //' pp. 32-57, doi:10.1080/01969727308546046.
 //'
-//' @param X data matrix of size n*d
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are)
 //' @param y vector of n integer labels in [1, K], where `y[i]`
 //'          is the cluster id of the i-th point, `X[i,]`
 //' @param K number of clusters, `max(y)`
@@ -513,14 +1608,32 @@ double CVI_SilhouetteW(NumericMatrix X, NumericVector y, int K)
 //'
 //' @export
 // [[Rcpp::export]]
-double CVI_Dunn(NumericMatrix X, NumericVector y, int K)
+double CVI_Dunn(SEXP X, NumericVector y, int K)
 {
-    DunnIndex ind(
-        matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-        (uint8_t)K
-    );
-    ind.set_labels(translateLabels_fromR(y));
-    return (double)ind.compute();
+    return __CVI_compute("Dunn", translateDataset_fromR(X), y, K);
+}
+
+
+//' @title Dunn's Index for Many Partitions
+//'
+//' @description
+//' Computes \code{CVI_Dunn} for each column of \code{Y};
+//' the columns are processed in parallel, see \code{.CVI_compute_many}.
+//'
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are)
+//' @param Y matrix with n rows whose columns give label vectors
+//'          with integer elements in [1, K]
+//' @param K number of clusters
+//'
+//' @return Returns a numeric vector of length \code{ncol(Y)}.
+//'
+//' @export
+// [[Rcpp::export]]
+NumericVector CVI_Dunn_many(SEXP X, NumericMatrix Y, int K)
+{
+    return __CVI_compute_many("Dunn",
+        translateDataset_fromR(X), Y, K);
 }
 
 
@@ -531,7 +1644,8 @@ double CVI_Dunn(NumericMatrix X, NumericVector y, int K)
 //' @references
 //' TODO: update
 //'
-//' @param X data matrix of size n*d
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are)
 //' @param y vector of n integer labels in [1, K], where `y[i]`
 //'          is the cluster id of the i-th point, `X[i,]`
 //' @param K number of clusters, `max(y)`
@@ -540,74 +1654,37 @@ double CVI_Dunn(NumericMatrix X, NumericVector y, int K)
 //'
 //' @export
 // [[Rcpp::export]]
-double CVI_GDunn(NumericMatrix X, NumericVector y, int K, int lowercaseDelta, int uppercaseDelta)
+double CVI_GDunn(SEXP X, NumericVector y, int K, int lowercaseDelta, int uppercaseDelta)
 {
-    LowercaseDeltaFactory* lowercaseDeltaFactory;
-    UppercaseDeltaFactory* uppercaseDeltaFactory;
-
-    if (lowercaseDelta == 1) {
-        lowercaseDeltaFactory = new LowercaseDelta1Factory();
-    }
-    else if (lowercaseDelta == 2) {
-        lowercaseDeltaFactory = new LowercaseDelta2Factory();
-    }
-    else if (lowercaseDelta == 3) {
-        lowercaseDeltaFactory = new LowercaseDelta3Factory();
-    }
-    else if (lowercaseDelta == 4) {
-        lowercaseDeltaFactory = new LowercaseDelta4Factory();
-    }
-    else if (lowercaseDelta == 5) {
-        lowercaseDeltaFactory = new LowercaseDelta5Factory();
-    }
-    else if (lowercaseDelta == 6) {
-        lowercaseDeltaFactory = new LowercaseDelta6Factory();
-    }
-    else {
-        Rf_error("invalid lowercaseDelta");
-    }
-
-    if (uppercaseDelta == 1) {
-        uppercaseDeltaFactory = new UppercaseDelta1Factory();
-    }
-    else if (uppercaseDelta == 2) {
-        uppercaseDeltaFactory = new UppercaseDelta2Factory();
-    }
-    else if (uppercaseDelta == 3) {
-        uppercaseDeltaFactory = new UppercaseDelta3Factory();
-    }
-    else {
-        Rf_error("invalid uppercaseDelta");
-    }
-
-    bool areCentroidsNeeded = lowercaseDeltaFactory->IsCentroidNeeded() || uppercaseDeltaFactory->IsCentroidNeeded();
-    if (areCentroidsNeeded) {
-        GeneralizedDunnIndexCentroidBased ind(
-        matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-        K,
-        lowercaseDeltaFactory,
-        uppercaseDeltaFactory
-        );
-
-        delete lowercaseDeltaFactory;
-        delete uppercaseDeltaFactory;
-
-        ind.set_labels(translateLabels_fromR(y));
-        return (double)ind.compute();
-    } else {
-        GeneralizedDunnIndex ind(
-        matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-        (uint8_t)K,
-        lowercaseDeltaFactory,
-        uppercaseDeltaFactory
-        );
+    return __CVI_compute(
+        __CVI_GDunn_type(lowercaseDelta, uppercaseDelta).c_str(),
+        translateDataset_fromR(X), y, K);
+}
 
-        delete lowercaseDeltaFactory;
-        delete uppercaseDeltaFactory;
 
-        ind.set_labels(translateLabels_fromR(y));
-        return (double)ind.compute();
-    }
+//' @title Generalised Dunn's Index for Many Partitions
+//'
+//' @description
+//' Computes \code{CVI_GDunn} for each column of \code{Y};
+//' the columns are processed in parallel, see \code{.CVI_compute_many}.
+//'
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are)
+//' @param Y matrix with n rows whose columns give label vectors
+//'          with integer elements in [1, K]
+//' @param K number of clusters
+//' @param lowercaseDelta see \code{CVI_GDunn}
+//' @param uppercaseDelta see \code{CVI_GDunn}
+//'
+//' @return Returns a numeric vector of length \code{ncol(Y)}.
+//'
+//' @export
+// [[Rcpp::export]]
+NumericVector CVI_GDunn_many(SEXP X, NumericMatrix Y, int K, int lowercaseDelta, int uppercaseDelta)
+{
+    return __CVI_compute_many(
+        __CVI_GDunn_type(lowercaseDelta, uppercaseDelta).c_str(),
+        translateDataset_fromR(X), Y, K);
 }
 
 
@@ -615,7 +1692,8 @@ double CVI_GDunn(NumericMatrix X, NumericVector y, int K, int lowercaseDelta, in
 //'
 //' TODO: update this docstring
 //'
-//' @param X data matrix of size n*d
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are)
 //' @param y vector of n integer labels in [1, K], where `y[i]`
 //'          is the cluster id of the i-th point, `X[i,]`
 //' @param K number of clusters, `max(y)`
@@ -625,17 +1703,38 @@ double CVI_GDunn(NumericMatrix X, NumericVector y, int K, int lowercaseDelta, in
 //'
 //' @export
 // [[Rcpp::export]]
-double CVI_WCNN(NumericMatrix X, NumericVector y, int K, int M=10)
+double CVI_WCNN(SEXP X, NumericVector y, int K, int M=10)
 {
     CVI_ASSERT(M>0);  // M = min(n-1, M) in the constructor
 
-    WCNNIndex ind(
-        matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-        (uint8_t)K, false, M
-    );
+    return __CVI_compute(("WCNN_" + std::to_string(M)).c_str(),
+        translateDataset_fromR(X), y, K);
+}
+
+
+//' @title Within-Cluster Nearest-Neighbours for Many Partitions
+//'
+//' @description
+//' Computes \code{CVI_WCNN} for each column of \code{Y};
+//' the columns are processed in parallel, see \code{.CVI_compute_many}.
+//'
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are)
+//' @param Y matrix with n rows whose columns give label vectors
+//'          with integer elements in [1, K]
+//' @param K number of clusters
+//' @param M number of nearest neighbours
+//'
+//' @return Returns a numeric vector of length \code{ncol(Y)}.
+//'
+//' @export
+// [[Rcpp::export]]
+NumericVector CVI_WCNN_many(SEXP X, NumericMatrix Y, int K, int M=10)
+{
+    CVI_ASSERT(M>0);  // M = min(n-1, M) in the constructor
 
-    ind.set_labels(translateLabels_fromR(y));
-    return (double)ind.compute();
+    return __CVI_compute_many(("WCNN_" + std::to_string(M)).c_str(),
+        translateDataset_fromR(X), Y, K);
 }
 
 
@@ -644,7 +1743,8 @@ double CVI_WCNN(NumericMatrix X, NumericVector y, int K, int M=10)
 //'
 //' TODO: update this docstring
 //'
-//' @param X data matrix of size n*d
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are)
 //' @param y vector of n integer labels in [1, K], where `y[i]`
 //'          is the cluster id of the i-th point, `X[i,]`
 //' @param K number of clusters, `max(y)`
@@ -654,22 +1754,42 @@ double CVI_WCNN(NumericMatrix X, NumericVector y, int K, int M=10)
 //'
 //' @export
 // [[Rcpp::export]]
-double CVI_DuNNOWA(NumericMatrix X, NumericVector y, int K, int M=10,
+double CVI_DuNNOWA(SEXP X, NumericVector y, int K, int M=10,
                 Rcpp::String owa_numerator="Min",
                 Rcpp::String owa_denominator="Max")
 {
-    CVI_ASSERT(M>0);    // M = min(n-1, M) in the constructor
-
-    int _owa_numerator = DuNNOWA_get_OWA(std::string(owa_numerator));
-    int _owa_denominator = DuNNOWA_get_OWA(std::string(owa_denominator));
+    return __CVI_compute(
+        __CVI_DuNNOWA_type(M, owa_numerator, owa_denominator).c_str(),
+        translateDataset_fromR(X), y, K);
+}
 
-    DuNNOWAIndex ind(
-        matrix<FLOAT_T>(REAL(SEXP(X)), X.nrow(), X.ncol(), false),
-        (uint8_t)K, false, M, _owa_numerator, _owa_denominator
-    );
 
-    ind.set_labels(translateLabels_fromR(y));
-    return (double)ind.compute();
+//' @title OWA-based Dunn-like Indices Based on Near Neighbours for Many Partitions
+//'
+//' @description
+//' Computes \code{CVI_DuNNOWA} for each column of \code{Y};
+//' the columns are processed in parallel, see \code{.CVI_compute_many}.
+//'
+//' @param X data matrix of size n*d or an object of class \code{dist}
+//'        (pairwise distances between n objects, used as they are)
+//' @param Y matrix with n rows whose columns give label vectors
+//'          with integer elements in [1, K]
+//' @param K number of clusters
+//' @param M number of nearest neighbours
+//' @param owa_numerator see \code{CVI_DuNNOWA}
+//' @param owa_denominator see \code{CVI_DuNNOWA}
+//'
+//' @return Returns a numeric vector of length \code{ncol(Y)}.
+//'
+//' @export
+// [[Rcpp::export]]
+NumericVector CVI_DuNNOWA_many(SEXP X, NumericMatrix Y, int K, int M=10,
+                Rcpp::String owa_numerator="Min",
+                Rcpp::String owa_denominator="Max")
+{
+    return __CVI_compute_many(
+        __CVI_DuNNOWA_type(M, owa_numerator, owa_denominator).c_str(),
+        translateDataset_fromR(X), Y, K);
 }
 
 
@@ -28,17 +28,19 @@
 
 /** Converts a 1-based label vector to a 0-based vector of small integers.
  *
- * @param x numeric vector with integer elements in [1, 256].
+ * @param x numeric vector with integer elements in [1, max(Label)+1],
+ *      e.g., [1, 256] for uint8_t.
  * @return
  */
-std::vector<uint8_t> translateLabels_fromR(const Rcpp::NumericVector& x)
+template<class Label>
+std::vector<Label> translateLabels_fromR(const Rcpp::NumericVector& x)
 {
     size_t n = x.size();
-    std::vector<uint8_t> ret(n);
+    std::vector<Label> ret(n);
     for (size_t i=0; i<n; ++i) {
-        int xi = (int)x[i];
-        CVI_ASSERT(xi >= 1 && xi <= 256)
-        ret[i] = (uint8_t)(xi-1); // 1-based -> 0-based
+        double xi = x[i];
+        CVI_ASSERT(xi >= 1 && xi-1 <= (double)std::numeric_limits<Label>::max())
+        ret[i] = (Label)(xi-1); // 1-based -> 0-based
     }
     return ret;
 }
@@ -49,7 +51,8 @@ std::vector<uint8_t> translateLabels_fromR(const Rcpp::NumericVector& x)
  * @param x
  * @return
  */
-Rcpp::NumericVector translateLabels_toR(const std::vector<uint8_t>& x)
+template<class Label>
+Rcpp::NumericVector translateLabels_toR(const std::vector<Label>& x)
 {
     size_t n = x.size();
     Rcpp::NumericVector ret(n);
@@ -59,6 +62,27 @@ Rcpp::NumericVector translateLabels_toR(const std::vector<uint8_t>& x)
 }
 
 
+/** Assigns a 1-based label vector to a CVI object,
+ * whatever type it stores the labels as.
+ *
+ * @param cvi
+ * @param y numeric vector with integer elements in [1, K].
+ */
+void setLabels_fromR(ClusterValidityIndex* cvi, const Rcpp::NumericVector& y)
+{
+    switch (cvi->get_label_size()) {
+        case sizeof(uint8_t):
+            as_labelled<uint8_t>(cvi)->set_labels(translateLabels_fromR<uint8_t>(y));
+            break;
+        case sizeof(uint16_t):
+            as_labelled<uint16_t>(cvi)->set_labels(translateLabels_fromR<uint16_t>(y));
+            break;
+        default:
+            as_labelled<uint32_t>(cvi)->set_labels(translateLabels_fromR<uint32_t>(y));
+    }
+}
+
+
 /** Convert Rcpp's numeric matrix object (column-major) to our
  * internal type (row-major).
  *
@@ -80,4 +104,105 @@ matrix<FLOAT_T> translateMatrix_fromR(const Rcpp::NumericMatrix& X)
 }
 
 
+/** Converts the name of a distance storage type
+ * to one of CVI_DISTANCE_*, see EuclideanDistance.
+ *
+ * @param storage "double", "float32" or "uint16"
+ * @return
+ */
+int translateDistanceStorage_fromR(const Rcpp::String& storage)
+{
+    if (storage == "double")
+        return CVI_DISTANCE_DOUBLE;
+    else if (storage == "float32")
+        return CVI_DISTANCE_FLOAT32;
+    else if (storage == "uint16")
+        return CVI_DISTANCE_UINT16;
+    else {
+        Rf_error("invalid distance_storage");
+        return -1; // whatever
+    }
+}
+
+
+/** Translates a metric name to one of CVI_METRIC_*
+ *
+ * @param metric "euclidean", "manhattan", "chebyshev", "cosine"
+ *        or "mahalanobis"
+ * @return
+ */
+int translateMetric_fromR(const Rcpp::String& metric)
+{
+    if (metric == "euclidean")
+        return CVI_METRIC_EUCLIDEAN;
+    else if (metric == "manhattan")
+        return CVI_METRIC_MANHATTAN;
+    else if (metric == "chebyshev")
+        return CVI_METRIC_CHEBYSHEV;
+    else if (metric == "cosine")
+        return CVI_METRIC_COSINE;
+    else if (metric == "mahalanobis")
+        return CVI_METRIC_MAHALANOBIS;
+    else {
+        Rf_error("invalid metric");
+        return -1; // whatever
+    }
+}
+
+
+/** Creates a new dataset handle wrapping a given numeric matrix
+ * or a dist object.
+ *
+ * A dist object is not copied: the dataset refers to
+ * the underlying buffer (and keeps the R object alive).
+ *
+ * @param X a numeric matrix or an object of class dist
+ * @return
+ */
+DatasetPtr newDataset_fromR(SEXP X)
+{
+    if (Rf_inherits(X, "dist")) {
+        Rcpp::NumericVector D(X);  // no copy if X is already of type double
+        size_t n = (size_t)Rf_asInteger(Rf_getAttrib(X, Rf_install("Size")));
+        if (n < 2 || (size_t)D.size() != n*(n-1)/2)
+            Rf_error("invalid dist object");
+
+        // R's dist objects use the same layout as pairwise_distances()
+        std::shared_ptr<const void> owner(D.begin(), [D](const void*) { });
+        return DatasetPtr(new Dataset(n, owner, D.begin()));
+    }
+
+    Rcpp::NumericMatrix Xr(X);  // no copy if X is already of type double
+    if (Xr.ncol() == 1 || Xr.nrow() == 1) {
+        // the column-major layout is the row-major one: no need to copy
+        std::shared_ptr<const void> owner(Xr.begin(), [Xr](const void*) { });
+        return DatasetPtr(new Dataset(
+            matrix_view<FLOAT_T>(Xr.begin(), Xr.nrow(), Xr.ncol()), owner));
+    }
+
+    // a single transposed copy, shared by all the objects using the dataset
+    return DatasetPtr(new Dataset(translateMatrix_fromR(Xr)));
+}
+
+
+/** Gets a dataset handle: either the one created by .CVI_dataset()
+ * or a new one, wrapping a given numeric matrix or a dist object.
+ *
+ * @param X an external pointer of class CVI_dataset, a numeric matrix,
+ *        or an object of class dist
+ * @return
+ */
+DatasetPtr translateDataset_fromR(SEXP X)
+{
+    if (TYPEOF(X) == EXTPTRSXP) {
+        if (!Rf_inherits(X, "CVI_dataset"))
+            Rf_error("X is neither a numeric matrix nor a CVI_dataset object");
+        Rcpp::XPtr< DatasetPtr > data = Rcpp::as< Rcpp::XPtr< DatasetPtr > >(X);
+        return *data;
+    }
+
+    return newDataset_fromR(X);
+}
+
+
 #endif
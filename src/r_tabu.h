@@ -24,57 +24,47 @@ using namespace Rcpp;
 
 
 
-//' (Tabu-like) (stochastic) hill climbing
-//'
-//' @param cvi_ptr pointer, see _CVI_create()
-//' @param y0 initial label vector
-//' @param allow_revisit should a `tabu` list be maintained?
-//' @param max_iter_with_no_improvement how many iterations
-//'        where there are no improvement in the fitness function
-//'        before we give up?
-//' @param max_iter maximal number of iterations
-//' @param max_samples if <= 0, then an exhaustive search of all the
-//'        neighbouring points is conveyed; otherwise, choose
-//'        next candidates at random
-//' @param verbose print additional info on the console?
-//'
-//' @return see optim()
-//' @export
-// [[Rcpp::export(".CVI_improve")]]
-List _CVI_improve(
-    SEXP cvi_ptr,
+/** See _CVI_improve()
+ */
+template<class Label>
+List __CVI_improve(
+    LabelledIndex<Label>* index,
     NumericVector y0,
-    bool allow_revisit = false,
-    int max_iter_with_no_improvement = 250,
-    int max_iter = 10000,
-    int max_samples = -1,
-    bool verbose = false)
+    bool allow_revisit,
+    int max_iter_with_no_improvement,
+    int max_iter,
+    int max_samples,
+    bool verbose,
+    bool swaps)
 {
-    XPtr< ClusterValidityIndex > cvi =
-        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
-    ClusterValidityIndex* index = &(*cvi);
     size_t K = index->get_K();
     size_t n = index->get_n();
 
-    std::vector<uint8_t> y = translateLabels_fromR(y0);
+    std::vector<Label> y = translateLabels_fromR<Label>(y0);
     index->set_labels(y);
 
     RNGScope rngScope;
 
 
-    std::unordered_set< std::vector<uint8_t>, Hash > tabuList;
+    std::unordered_set< std::vector<Label>, Hash > tabuList;
 
 
     FLOAT_T best_f = index->compute();
-    std::vector<uint8_t> best_y = y;
+    std::vector<Label> best_y = y;
     if (!allow_revisit)
         tabuList.insert(y);
 
+    size_t num_neighbours = swaps?(n*n):(n*K);  // including the invalid ones
+    size_t num_samples = num_neighbours;
     bool random_search = true;
-    if (max_samples <= 0 || max_samples >= (int)(n*K)) {
+    if (max_samples <= 0 || (size_t)max_samples >= num_neighbours)
         random_search = false;
-        max_samples = (int)n*K;
-    }
+    else
+        num_samples = (size_t)max_samples;
+
+    // in the exhaustive search, all the moves of the i-th point
+    // are scored at once, see score_point_moves()
+    std::vector<FLOAT_T> point_scores(K);
 
     // bool ifChange;
     int t = 0;
@@ -83,49 +73,98 @@ List _CVI_improve(
         ++k;
         Rcpp::checkUserInterrupt();
         size_t  cur_best_i = 0;
-        uint8_t cur_best_j = 0;
+        Label   cur_best_j = 0;
+        size_t  cur_best_k = 0;  // if swaps
         FLOAT_T cur_best_f = -INFTY;
 
         // generate neighbours
-        for (int s=0; s<max_samples; s++) {
-            size_t i;
-            uint8_t j;
-            if (!random_search) {
-                i = (size_t) (s/K);
-                j = (uint8_t)(s%K);
+        for (size_t s=0; s<num_samples; s++) {
+            size_t i1, i2 = 0;
+            Label j = 0;
+            if (swaps) {
+                if (!random_search) {
+                    i1 = s/n;
+                    i2 = s%n;
+                    if (i2 <= i1) continue;  // each pair once
+                }
+                else {
+                    i1 = (size_t)R::runif(0, n);
+                    i2 = (size_t)R::runif(0, n);
+                }
+
+                if (y[i1] == y[i2]) continue;
             }
             else {
-                i = (size_t) R::runif(0, n);
-                j = (uint8_t)R::runif(0, K);
-            }
+                if (!random_search) {
+                    i1 = (size_t) (s/K);
+                    j = (Label)(s%K);
+                    if (j == 0 && index->get_count(y[i1]) > 1)
+                        index->score_point_moves(i1, point_scores.data());
+                }
+                else {
+                    i1 = (size_t) R::runif(0, n);
+                    j = (Label)R::runif(0, K);
+                }
 
-            if (y[i] == j) continue;
-            if (index->get_count(y[i]) <= 1) continue;
+                if (y[i1] == j) continue;
+                if (index->get_count(y[i1]) <= 1) continue;
+            }
 
             if (!allow_revisit) {
-                ssize_t tmp = y[i];
-                y[i] = j;
-                bool is_tabu = (tabuList.find(y) != tabuList.end());
-                y[i] = tmp;
+                bool is_tabu;
+                if (swaps) {
+                    std::swap(y[i1], y[i2]);
+                    is_tabu = (tabuList.find(y) != tabuList.end());
+                    std::swap(y[i1], y[i2]);
+                }
+                else {
+                    ssize_t tmp = y[i1];
+                    y[i1] = j;
+                    is_tabu = (tabuList.find(y) != tabuList.end());
+                    y[i1] = tmp;
+                }
                 if (is_tabu) {
                     ++t;
                     continue;
                 }
             }
 
-            index->modify(i, j);
-            FLOAT_T res = index->compute();
-            index->undo();
+            FLOAT_T res;
+            if (swaps) {
+                index->swap(i1, i2);
+                res = index->compute();
+                index->undo();
+            }
+            else if (!random_search)
+                res = point_scores[j];
+            else {
+                // the index's state is not modified
+                res = index->score_move(i1, j);
+            }
 
             if (res > cur_best_f){
                 cur_best_f = res;
-                cur_best_i = i;
+                cur_best_i = i1;
                 cur_best_j = j;
+                cur_best_k = i2;
             }
         }
 
-        y[cur_best_i] = cur_best_j;
-        index->modify(cur_best_i, cur_best_j);
+        if (IS_MINUS_INFTY(cur_best_f)) {
+            // no admissible neighbour has been found
+            if (!random_search) break;  // can't improve at all
+            max_iter_with_no_improvement--;  // try another sample
+            continue;
+        }
+
+        if (swaps) {
+            std::swap(y[cur_best_i], y[cur_best_k]);
+            index->swap(cur_best_i, cur_best_k);
+        }
+        else {
+            y[cur_best_i] = cur_best_j;
+            index->modify(cur_best_i, cur_best_j);
+        }
 
         if (!allow_revisit)
             tabuList.insert(y);
@@ -157,45 +196,78 @@ List _CVI_improve(
 }
 
 
-
-
-
-
-//' Tabu-like hill climbing from multiple initial points
-//'
-//' an exhaustive search of all the neighbouring points is conveyed
+//' (Tabu-like) (stochastic) hill climbing
 //'
 //' @param cvi_ptr pointer, see _CVI_create()
-//' @param Y0 set of initial label vectors
+//' @param y0 initial label vector
+//' @param allow_revisit should a `tabu` list be maintained?
 //' @param max_iter_with_no_improvement how many iterations
 //'        where there are no improvement in the fitness function
 //'        before we give up?
 //' @param max_iter maximal number of iterations
+//' @param max_samples if <= 0, then an exhaustive search of all the
+//'        neighbouring points is conveyed; otherwise, choose
+//'        next candidates at random
 //' @param verbose print additional info on the console?
+//' @param swaps if TRUE, the neighbours are generated by exchanging
+//'        the labels of two points from different clusters (the cluster
+//'        sizes do not change); otherwise, by moving a single point
+//'        to another cluster
 //'
 //' @return see optim()
 //' @export
-// [[Rcpp::export(".CVI_improve_turbo")]]
-List _CVI_improve_turbo(
+// [[Rcpp::export(".CVI_improve")]]
+List _CVI_improve(
     SEXP cvi_ptr,
-    NumericMatrix Y0,
+    NumericVector y0,
+    bool allow_revisit = false,
     int max_iter_with_no_improvement = 250,
     int max_iter = 10000,
-    bool verbose = false)
+    int max_samples = -1,
+    bool verbose = false,
+    bool swaps = false)
 {
     XPtr< ClusterValidityIndex > cvi =
         Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
-    ClusterValidityIndex* index = &(*cvi);
+    switch ((*cvi).get_label_size()) {
+        case sizeof(uint8_t):
+            return __CVI_improve(as_labelled<uint8_t>(&(*cvi)), y0, allow_revisit,
+                max_iter_with_no_improvement, max_iter, max_samples, verbose, swaps);
+        case sizeof(uint16_t):
+            return __CVI_improve(as_labelled<uint16_t>(&(*cvi)), y0, allow_revisit,
+                max_iter_with_no_improvement, max_iter, max_samples, verbose, swaps);
+        default:
+            return __CVI_improve(as_labelled<uint32_t>(&(*cvi)), y0, allow_revisit,
+                max_iter_with_no_improvement, max_iter, max_samples, verbose, swaps);
+    }
+}
+
+
+
+
+
+
+/** See _CVI_improve_turbo()
+ */
+template<class Label>
+List __CVI_improve_turbo(
+    LabelledIndex<Label>* index,
+    NumericMatrix Y0,
+    int max_iter_with_no_improvement,
+    int max_iter,
+    bool verbose)
+{
     size_t K = index->get_K();
     size_t n = index->get_n();
     size_t max_samples = (int)n*K;
-    std::unordered_set< std::vector<uint8_t>, Hash > tabuList;
+    matrix<FLOAT_T> scores(n, K);
+    std::unordered_set< std::vector<Label>, Hash > tabuList;
     FLOAT_T best_f = -INFTY;
-    std::vector<uint8_t> best_y;
+    std::vector<Label> best_y;
 
     int t = 0; // tabu hits
     for (int c=0; c<Y0.ncol(); ++c) {
-        std::vector<uint8_t> y = translateLabels_fromR(Y0.column(c));
+        std::vector<Label> y = translateLabels_fromR<Label>(Y0.column(c));
 
         bool is_tabu = (tabuList.find(y) != tabuList.end());
         if (is_tabu) {
@@ -204,7 +276,25 @@ List _CVI_improve_turbo(
         }
 
 
-        index->set_labels(y);
+        if (c > 0) {
+            // a restart close to the current partition can be
+            // applied via modify_many(), which only touches the moved points
+            std::vector<size_t> idx;
+            std::vector<Label> labels;
+            for (size_t i=0; i<n; ++i) {
+                if (index->get_label(i) != y[i]) {
+                    idx.push_back(i);
+                    labels.push_back(y[i]);
+                }
+            }
+            if (4*idx.size() <= n)
+                index->modify_many(idx, labels);
+            else
+                index->set_labels(y);
+        }
+        else
+            index->set_labels(y);
+
         FLOAT_T cur_f = index->compute();
         if (cur_f > best_f) {
             best_f = cur_f;
@@ -225,15 +315,17 @@ List _CVI_improve_turbo(
             ++k;
             Rcpp::checkUserInterrupt();
             size_t  cur_best_i = 0;
-            uint8_t cur_best_j = 0;
+            Label   cur_best_j = 0;
             FLOAT_T cur_best_f = -INFTY;
 
-            // generate neighbours
+            // evaluate all the neighbours at once
+            index->score_all_moves(scores);
+
             for (size_t s=0; s<max_samples; s++) {
                 size_t i;
-                uint8_t j;
+                Label j;
                 i = (size_t) (s/K);
-                j = (uint8_t)(s%K);
+                j = (Label)(s%K);
 
                 if (y[i] == j) continue;
                 if (index->get_count(y[i]) <= 1) continue;
@@ -247,9 +339,7 @@ List _CVI_improve_turbo(
                     continue;
                 }
 
-                index->modify(i, j);
-                FLOAT_T res = index->compute();
-                index->undo();
+                FLOAT_T res = scores(i, j);
 
                 if (res > cur_best_f) {
                     cur_best_f = res;
@@ -309,4 +399,42 @@ List _CVI_improve_turbo(
 }
 
 
+//' Tabu-like hill climbing from multiple initial points
+//'
+//' an exhaustive search of all the neighbouring points is conveyed
+//'
+//' @param cvi_ptr pointer, see _CVI_create()
+//' @param Y0 set of initial label vectors
+//' @param max_iter_with_no_improvement how many iterations
+//'        where there are no improvement in the fitness function
+//'        before we give up?
+//' @param max_iter maximal number of iterations
+//' @param verbose print additional info on the console?
+//'
+//' @return see optim()
+//' @export
+// [[Rcpp::export(".CVI_improve_turbo")]]
+List _CVI_improve_turbo(
+    SEXP cvi_ptr,
+    NumericMatrix Y0,
+    int max_iter_with_no_improvement = 250,
+    int max_iter = 10000,
+    bool verbose = false)
+{
+    XPtr< ClusterValidityIndex > cvi =
+        Rcpp::as< XPtr< ClusterValidityIndex > > (cvi_ptr);
+    switch ((*cvi).get_label_size()) {
+        case sizeof(uint8_t):
+            return __CVI_improve_turbo(as_labelled<uint8_t>(&(*cvi)), Y0,
+                max_iter_with_no_improvement, max_iter, verbose);
+        case sizeof(uint16_t):
+            return __CVI_improve_turbo(as_labelled<uint16_t>(&(*cvi)), Y0,
+                max_iter_with_no_improvement, max_iter, verbose);
+        default:
+            return __CVI_improve_turbo(as_labelled<uint32_t>(&(*cvi)), Y0,
+                max_iter_with_no_improvement, max_iter, verbose);
+    }
+}
+
+
 #endif